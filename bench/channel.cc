@@ -0,0 +1,82 @@
+#include "../include/channel.hpp"
+#include "../include/sync_wait.hpp"
+#include "../include/task.hpp"
+#include "../include/threadpool.hpp"
+#include "../include/when_all.hpp"
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <vector>
+
+namespace {
+constexpr long messages{1 << 16};
+
+cocos::Task<> produce(cocos::Channel<long> &ch, long n) {
+  for (long i{0}; i < n; ++i) {
+    co_await ch.send(i);
+  }
+}
+cocos::Task<long> consume(cocos::Channel<long> &ch) {
+  long sum{0};
+  while (auto v{co_await ch.recv()}) {
+    sum += *v;
+  }
+  co_return sum;
+}
+cocos::Task<> produce_all(cocos::Channel<long> &ch, int producers) {
+  std::vector<cocos::Task<>> tasks;
+  for (int i{0}; i < producers; ++i) {
+    tasks.push_back(produce(ch, messages / producers));
+  }
+  co_await cocos::when_all(std::move(tasks));
+  ch.close();
+}
+cocos::Task<std::vector<long>> consume_all(cocos::Channel<long> &ch,
+                                           int consumers) {
+  std::vector<cocos::Task<long>> tasks;
+  for (int i{0}; i < consumers; ++i) {
+    tasks.push_back(consume(ch));
+  }
+  co_return co_await cocos::when_all(std::move(tasks));
+}
+cocos::Task<long> pipe(std::size_t capacity, int producers, int consumers) {
+  cocos::Channel<long> ch{capacity};
+  auto [sums, _] = co_await cocos::when_all(consume_all(ch, consumers),
+                                            produce_all(ch, producers));
+  long total{0};
+  for (auto sum : sums) {
+    total += sum;
+  }
+  co_return total;
+}
+} // namespace
+
+/**
+ * @brief One producer and one consumer on a single-threaded loop, with the
+ * channel capacity as the argument.
+ */
+static void BM_Channel_SPSC_EventLoop(benchmark::State &state) {
+  auto capacity{static_cast<std::size_t>(state.range(0))};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cocos::sync_wait(pipe(capacity, 1, 1)));
+  }
+  state.SetItemsProcessed(state.iterations() * messages);
+}
+BENCHMARK(BM_Channel_SPSC_EventLoop)->Arg(2)->Arg(64)->Arg(1024);
+
+/**
+ * @brief Four producers and four consumers through a channel of 256 values,
+ * on a pool with as many workers as the argument.
+ */
+static void BM_Channel_MPMC_ThreadPool(benchmark::State &state) {
+  cocos::ThreadPoolLoop pool{static_cast<std::size_t>(state.range(0))};
+  pool.start();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cocos::sync_wait(pool, pipe(256, 4, 4)));
+  }
+  pool.stop();
+  state.SetItemsProcessed(state.iterations() * messages);
+}
+BENCHMARK(BM_Channel_MPMC_ThreadPool)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
@@ -0,0 +1,67 @@
+#include "../include/eventloop.hpp"
+#include "../include/task.hpp"
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <vector>
+
+namespace {
+constexpr long turns{1 << 20};
+
+cocos::Task<> spin(long rounds) {
+  for (long i{0}; i < rounds; ++i) {
+    co_await cocos::reschedule();
+  }
+}
+cocos::Task<> spin_deadline(long rounds) {
+  auto deadline{std::chrono::steady_clock::now()};
+  for (long i{0}; i < rounds; ++i) {
+    deadline += std::chrono::microseconds{1};
+    co_await cocos::reschedule(cocos::Priority::normal, deadline);
+  }
+}
+} // namespace
+
+/**
+ * @brief The cost of one turn of the loop: a coroutine put back on the ready
+ * queue, taken off it and resumed. The argument is how many coroutines take
+ * turns, i.e. the depth of the ready queue.
+ */
+static void BM_EventLoop_Reschedule(benchmark::State &state) {
+  auto tasks{state.range(0)};
+  auto &loop{cocos::EventLoop::get_loop()};
+  for (auto _ : state) {
+    std::vector<cocos::Task<>> spinning;
+    for (long i{0}; i < tasks; ++i) {
+      loop.add_task(spinning.emplace_back(spin(turns / tasks)));
+    }
+    loop.run();
+  }
+  state.SetItemsProcessed(state.iterations() * turns);
+}
+BENCHMARK(BM_EventLoop_Reschedule)
+    ->Arg(1)
+    ->Arg(64)
+    ->Arg(4096)
+    ->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief The same turns through the deadline heap of the ready queue, each
+ * coroutine rescheduled with a deadline, round-robin by deadline.
+ */
+static void BM_EventLoop_RescheduleDeadline(benchmark::State &state) {
+  auto tasks{state.range(0)};
+  auto &loop{cocos::EventLoop::get_loop()};
+  for (auto _ : state) {
+    std::vector<cocos::Task<>> spinning;
+    for (long i{0}; i < tasks; ++i) {
+      loop.add_task(spinning.emplace_back(spin_deadline(turns / tasks)));
+    }
+    loop.run();
+  }
+  state.SetItemsProcessed(state.iterations() * turns);
+}
+BENCHMARK(BM_EventLoop_RescheduleDeadline)
+    ->Arg(1)
+    ->Arg(64)
+    ->Arg(4096)
+    ->Unit(benchmark::kMillisecond);
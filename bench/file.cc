@@ -0,0 +1,121 @@
+#include "../include/eventloop.hpp"
+#include "../include/file.hpp"
+#include "../include/task.hpp"
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+constexpr std::size_t file_size{64 << 20};
+constexpr std::size_t chunk_size{1 << 20};
+
+/**
+ * @brief A temporary log-like file of `file_size` bytes, written once and
+ * removed at exit. It is read from the page cache, so that the benchmarks
+ * measure the overhead of the streaming rather than a disk.
+ */
+const std::string &log_file() {
+  static struct File {
+    std::string path{"/tmp/cocos_bench_XXXXXX"};
+    File() {
+      auto fd{::mkstemp(this->path.data())};
+      if (fd < 0) {
+        std::abort();
+      }
+      std::string text;
+      for (std::size_t i{0}; text.size() < file_size; ++i) {
+        text += "2024-01-01T00:00:00Z INFO request " + std::to_string(i) +
+                " served in " + std::to_string(i % 997) + "us\n";
+      }
+      text.resize(file_size);
+      if (::write(fd, text.data(), text.size()) !=
+          static_cast<ssize_t>(text.size())) {
+        std::abort();
+      }
+      ::close(fd);
+    }
+    ~File() { ::unlink(this->path.c_str()); }
+  } file;
+  return file.path;
+}
+cocos::Task<> consume_chunks(std::size_t depth, std::size_t &bytes) {
+  auto source{cocos::chunks(log_file(), chunk_size, depth)};
+  while (auto chunk{co_await source.next()}) {
+    benchmark::DoNotOptimize(chunk->data());
+    bytes += chunk->size();
+  }
+}
+cocos::Task<> consume_lines(std::size_t &bytes) {
+  auto source{cocos::lines(log_file(), chunk_size)};
+  while (auto line{co_await source.next()}) {
+    benchmark::DoNotOptimize(line->data());
+    bytes += line->size() + 1;
+  }
+}
+} // namespace
+
+/**
+ * @brief The baseline: read the file on the calling thread with pread(), into
+ * one reused buffer.
+ */
+static void BM_File_PreadBlocking(benchmark::State &state) {
+  cocos::detail::FileDescriptor file{
+      cocos::detail::open_file(log_file().c_str())};
+  std::vector<std::byte> buf(chunk_size);
+  std::size_t bytes{0};
+  for (auto _ : state) {
+    for (std::uint64_t offset{0};; offset += chunk_size) {
+      auto n{cocos::detail::read_at(file.fd, offset, buf)};
+      benchmark::DoNotOptimize(buf.data());
+      bytes += n;
+      if (n < chunk_size) {
+        break;
+      }
+    }
+  }
+  state.SetBytesProcessed(static_cast<std::int64_t>(bytes));
+}
+BENCHMARK(BM_File_PreadBlocking)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Stream the file with chunks() of 1MiB. The argument is the count of
+ * reads kept in flight.
+ */
+static void BM_File_Chunks(benchmark::State &state) {
+  auto depth{static_cast<std::size_t>(state.range(0))};
+  auto &loop{cocos::EventLoop::get_loop()};
+  std::size_t bytes{0};
+  for (auto _ : state) {
+    auto task{consume_chunks(depth, bytes)};
+    loop.add_task(task);
+    loop.run();
+  }
+  state.SetBytesProcessed(static_cast<std::int64_t>(bytes));
+}
+BENCHMARK(BM_File_Chunks)
+    ->ArgName("depth")
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/**
+ * @brief Stream the lines of the file with lines(), of about 50 bytes each.
+ */
+static void BM_File_Lines(benchmark::State &state) {
+  auto &loop{cocos::EventLoop::get_loop()};
+  std::size_t bytes{0};
+  for (auto _ : state) {
+    auto task{consume_lines(bytes)};
+    loop.add_task(task);
+    loop.run();
+  }
+  state.SetBytesProcessed(static_cast<std::int64_t>(bytes));
+}
+BENCHMARK(BM_File_Lines)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,133 @@
+#include "../include/generator.hpp"
+#include "../include/task.hpp"
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+
+/**
+ * @brief Count the global allocations of the benchmarking thread, to report
+ * the allocations per pipeline.
+ */
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC pairs the inlined malloc of operator new with the free of operator
+// delete, and warns about the replaced functions below.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+namespace {
+thread_local std::size_t global_allocations{0};
+} // namespace
+
+void *operator new(std::size_t size) {
+  ++global_allocations;
+  if (auto p{std::malloc(size == 0 ? 1 : size)}) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+cocos::Generator<int> range_int(int start, int end) {
+  for (int num{start}; num < end; ++num) {
+    co_yield num;
+  }
+}
+template <typename Alloc>
+cocos::Generator<int> range_int(std::allocator_arg_t, const Alloc &, int start,
+                                int end) {
+  for (int num{start}; num < end; ++num) {
+    co_yield num;
+  }
+}
+
+cocos::Task<> pstr(int num) {
+  benchmark::DoNotOptimize(num);
+  co_return;
+}
+cocos::Task<> throws() {
+  co_await pstr(1);
+  throw std::runtime_error("This is an exception.");
+}
+cocos::Task<> just() {
+  co_await pstr(2);
+  co_return;
+}
+template <typename Alloc>
+cocos::Task<> just(std::allocator_arg_t, const Alloc &) {
+  co_await pstr(2);
+  co_return;
+}
+
+void report(benchmark::State &state, std::size_t allocations) {
+  state.counters["allocs_per_pipeline"] =
+      benchmark::Counter(static_cast<double>(allocations) /
+                         static_cast<double>(state.iterations()));
+}
+} // namespace
+
+/**
+ * @brief The range_int(...).filter(...).map(...).take(3) pipeline of
+ * example/gen2.cc.
+ */
+static void BM_Frames_Gen2Pipeline(benchmark::State &state) {
+  auto before{global_allocations};
+  for (auto _ : state) {
+    auto g{range_int(0, 10)
+               .filter([](int i) { return i % 2 == 0; })
+               .map([](int i) { return i * i; })
+               .take(3)};
+    while (g.move_next()) {
+      benchmark::DoNotOptimize(g.current_value());
+    }
+  }
+  report(state, global_allocations - before);
+}
+BENCHMARK(BM_Frames_Gen2Pipeline);
+
+/**
+ * @brief The then/catching/finally chains of example/task3.cc, without the
+ * sleeps.
+ */
+static void BM_Frames_Task3Pipeline(benchmark::State &state) {
+  auto before{global_allocations};
+  for (auto _ : state) {
+    auto t1{throws()
+                .then([]() { benchmark::ClobberMemory(); })
+                .catching([](auto &&) { benchmark::ClobberMemory(); })
+                .finally([]() { benchmark::ClobberMemory(); })};
+    auto t2{just()
+                .then([]() { benchmark::ClobberMemory(); })
+                .catching([](auto &&) { benchmark::ClobberMemory(); })
+                .finally([]() { benchmark::ClobberMemory(); })};
+    t1.wait();
+    t2.wait();
+  }
+  report(state, global_allocations - before);
+}
+BENCHMARK(BM_Frames_Task3Pipeline);
+
+/**
+ * @brief The source frames supplied from an arena through
+ * `std::allocator_arg`.
+ */
+static void BM_Frames_ArenaSource(benchmark::State &state) {
+  std::array<std::byte, 4096> buffer;
+  auto before{global_allocations};
+  for (auto _ : state) {
+    std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size()};
+    std::pmr::polymorphic_allocator<std::byte> alloc{&arena};
+    auto g{range_int(std::allocator_arg, alloc, 0, 10)};
+    while (g.move_next()) {
+      benchmark::DoNotOptimize(g.current_value());
+    }
+    auto t{just(std::allocator_arg, alloc)};
+    t.wait();
+  }
+  report(state, global_allocations - before);
+}
+BENCHMARK(BM_Frames_ArenaSource);
@@ -0,0 +1,288 @@
+#include "../include/chunked_generator.hpp"
+#include "../include/generator.hpp"
+#include "../include/pipeline.hpp"
+#include <algorithm>
+#include <array>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <functional>
+#include <ranges>
+#include <span>
+
+namespace {
+constexpr int elements{1 << 20};
+constexpr long sum_elements{100'000'000};
+
+cocos::Generator<int> range_int(int start, int end) {
+  for (int num{start}; num < end; ++num) {
+    co_yield num;
+  }
+}
+cocos::Generator<long> iota(long n) {
+  for (long i{0}; i < n; ++i) {
+    co_yield i;
+  }
+}
+cocos::ChunkedGenerator<long> chunked_iota(long n) {
+  for (long i{0}; i < n; ++i) {
+    co_yield i;
+  }
+}
+cocos::ChunkedGenerator<long> batched_iota(long n) {
+  std::array<long, 256> batch;
+  for (long i{0}; i < n; i += batch.size()) {
+    auto size{std::min<long>(batch.size(), n - i)};
+    for (long j{0}; j < size; ++j) {
+      batch[j] = i + j;
+    }
+    co_yield std::span<const long>{batch.data(),
+                                   static_cast<std::size_t>(size)};
+  }
+}
+/**
+ * @brief In-order walk of the perfect binary tree of `depth` levels stored as
+ * an array, where node `i` has the children `2i + 1` and `2i + 2`, delegating
+ * to the subtrees by a loop over them.
+ */
+cocos::Generator<int> walk_loop(int node, int depth) {
+  if (depth == 0) {
+    co_return;
+  }
+  auto left{walk_loop(2 * node + 1, depth - 1)};
+  while (left.move_next()) {
+    co_yield left.current_value();
+  }
+  co_yield node;
+  auto right{walk_loop(2 * node + 2, depth - 1)};
+  while (right.move_next()) {
+    co_yield right.current_value();
+  }
+}
+/**
+ * @brief The same walk, delegating by `elements_of`.
+ */
+cocos::Generator<int> walk_nested(int node, int depth) {
+  if (depth == 0) {
+    co_return;
+  }
+  co_yield cocos::elements_of(walk_nested(2 * node + 1, depth - 1));
+  co_yield node;
+  co_yield cocos::elements_of(walk_nested(2 * node + 2, depth - 1));
+}
+bool even(int i) { return i % 2 == 0; }
+long square(int i) { return static_cast<long>(i) * i; }
+long add(long acc, long val) { return acc + val; }
+} // namespace
+
+/**
+ * @brief filter, map, take_while and fold chained as Generator adaptors, one
+ * coroutine per adaptor.
+ */
+static void BM_Generator_Chained(benchmark::State &state) {
+  for (auto _ : state) {
+    auto sum{range_int(0, elements)
+                 .filter(even)
+                 .map(square)
+                 .take_while([](long v) { return v >= 0; })
+                 .fold(0L, add)};
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+BENCHMARK(BM_Generator_Chained);
+
+/**
+ * @brief The same pipeline fused onto the source coroutine.
+ */
+static void BM_Generator_Fused(benchmark::State &state) {
+  for (auto _ : state) {
+    auto sum{(range_int(0, elements) | cocos::pipe::filter(even) |
+              cocos::pipe::map(square) |
+              cocos::pipe::take_while([](long v) { return v >= 0; }))
+                 .fold(0L, add)};
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+BENCHMARK(BM_Generator_Fused);
+
+/**
+ * @brief The fused pipeline turned back into a Generator, one coroutine for
+ * the stages on top of the source.
+ */
+static void BM_Generator_FusedGenerator(benchmark::State &state) {
+  for (auto _ : state) {
+    auto sum{(range_int(0, elements) | cocos::pipe::filter(even) |
+              cocos::pipe::map(square) |
+              cocos::pipe::take_while([](long v) { return v >= 0; }))
+                 .generator()
+                 .fold(0L, add)};
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+BENCHMARK(BM_Generator_FusedGenerator);
+
+/**
+ * @brief Sum 10^8 integers yielded one resume at a time.
+ */
+static void BM_Generator_Sum(benchmark::State &state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(iota(sum_elements).fold(0L, std::plus<>{}));
+  }
+  state.SetItemsProcessed(state.iterations() * sum_elements);
+}
+BENCHMARK(BM_Generator_Sum)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Sum 10^8 integers yielded one by one into chunks of 256.
+ */
+static void BM_ChunkedGenerator_Sum(benchmark::State &state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        chunked_iota(sum_elements).fold(0L, std::plus<>{}));
+  }
+  state.SetItemsProcessed(state.iterations() * sum_elements);
+}
+BENCHMARK(BM_ChunkedGenerator_Sum)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Sum 10^8 integers yielded as batches of 256.
+ */
+static void BM_ChunkedGenerator_BatchSum(benchmark::State &state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        batched_iota(sum_elements).fold(0L, std::plus<>{}));
+  }
+  state.SetItemsProcessed(state.iterations() * sum_elements);
+}
+BENCHMARK(BM_ChunkedGenerator_BatchSum)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Square and sum 10^8 integers yielded as batches of 256, mapping a
+ * chunk at a time.
+ */
+static void BM_ChunkedGenerator_MapSum(benchmark::State &state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(batched_iota(sum_elements)
+                                 .map([](long i) { return i * i; })
+                                 .fold(0L, std::plus<>{}));
+  }
+  state.SetItemsProcessed(state.iterations() * sum_elements);
+}
+BENCHMARK(BM_ChunkedGenerator_MapSum)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Walk a tree of depth `range(0)`, each element passing up through
+ * every generator above it.
+ */
+static void BM_Generator_TreeLoop(benchmark::State &state) {
+  auto depth{static_cast<int>(state.range(0))};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(walk_loop(0, depth).fold(0L, add));
+  }
+  state.SetItemsProcessed(state.iterations() * ((1L << depth) - 1));
+}
+BENCHMARK(BM_Generator_TreeLoop)->Arg(4)->Arg(12)->Arg(20);
+
+/**
+ * @brief The same walk, each element resumed directly from the generator
+ * which yields it.
+ */
+static void BM_Generator_TreeNested(benchmark::State &state) {
+  auto depth{static_cast<int>(state.range(0))};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(walk_nested(0, depth).fold(0L, add));
+  }
+  state.SetItemsProcessed(state.iterations() * ((1L << depth) - 1));
+}
+BENCHMARK(BM_Generator_TreeNested)->Arg(4)->Arg(12)->Arg(20);
+
+/**
+ * @brief Filter, square and sum by hand, with move_next().
+ */
+static void BM_Generator_HandLoop(benchmark::State &state) {
+  for (auto _ : state) {
+    auto gen{range_int(0, elements)};
+    long sum{0};
+    while (gen.move_next()) {
+      if (even(gen.current_value())) {
+        sum += square(gen.current_value());
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+BENCHMARK(BM_Generator_HandLoop);
+
+/**
+ * @brief The same loop over the generator as a range.
+ */
+static void BM_Generator_RangeFor(benchmark::State &state) {
+  for (auto _ : state) {
+    long sum{0};
+    for (auto i : range_int(0, elements)) {
+      if (even(i)) {
+        sum += square(i);
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+BENCHMARK(BM_Generator_RangeFor);
+
+/**
+ * @brief The same loop through std::views and a std::ranges algorithm. The
+ * functions are wrapped in lambdas, so that the views do not call them
+ * through pointers.
+ */
+static void BM_Generator_RangesViews(benchmark::State &state) {
+  for (auto _ : state) {
+    long sum{0};
+    std::ranges::for_each(
+        range_int(0, elements) |
+            std::views::filter([](int i) { return even(i); }) |
+            std::views::transform([](int i) { return square(i); }),
+        [&](long v) { sum += v; });
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+BENCHMARK(BM_Generator_RangesViews);
+
+/**
+ * @brief Sum 2^20 integers through one adaptor, the source alone as `none`,
+ * so that the difference is the per-element cost of the adaptor.
+ */
+template <typename Adapt>
+static void BM_Generator_Adaptor(benchmark::State &state, Adapt adapt) {
+  for (auto _ : state) {
+    auto gen{adapt(iota(elements))};
+    long sum{0};
+    while (gen.move_next()) {
+      sum += gen.current_value();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+BENCHMARK_CAPTURE(BM_Generator_Adaptor, none,
+                  [](cocos::Generator<long> g) { return g; });
+BENCHMARK_CAPTURE(BM_Generator_Adaptor, map, [](cocos::Generator<long> g) {
+  return g.map([](long i) { return i * 3; });
+});
+BENCHMARK_CAPTURE(BM_Generator_Adaptor, filter, [](cocos::Generator<long> g) {
+  return g.filter([](long i) { return i >= 0; });
+});
+BENCHMARK_CAPTURE(BM_Generator_Adaptor, take, [](cocos::Generator<long> g) {
+  return g.take(elements);
+});
+BENCHMARK_CAPTURE(BM_Generator_Adaptor, take_while,
+                  [](cocos::Generator<long> g) {
+                    return g.take_while([](long i) { return i >= 0; });
+                  });
+BENCHMARK_CAPTURE(BM_Generator_Adaptor, scan, [](cocos::Generator<long> g) {
+  return g.scan(0L, add);
+});
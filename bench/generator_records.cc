@@ -0,0 +1,140 @@
+#include "../include/generator.hpp"
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+std::size_t allocations{0};
+std::size_t copies{0};
+
+/**
+ * @brief A record with a payload on the heap, counting its copies.
+ */
+struct Record {
+  long id;
+  std::string payload;
+
+  Record(long id, std::size_t size) : id{id}, payload(size, 'x') {}
+  Record(const Record &other) : id{other.id}, payload{other.payload} {
+    ++copies;
+  }
+  Record(Record &&) noexcept = default;
+  Record &operator=(const Record &) = default;
+  Record &operator=(Record &&) noexcept = default;
+};
+
+constexpr std::size_t records{1024};
+constexpr std::size_t payload_size{1024};
+
+const std::vector<Record> &table() {
+  static const std::vector<Record> table{[] {
+    std::vector<Record> table;
+    for (std::size_t i{0}; i < records; ++i) {
+      table.emplace_back(i, payload_size);
+    }
+    return table;
+  }()};
+  return table;
+}
+
+cocos::Generator<Record> scan_copy(const std::vector<Record> &table) {
+  for (auto &record : table) {
+    co_yield record;
+  }
+}
+cocos::Generator<const Record &> scan_ref(const std::vector<Record> &table) {
+  for (auto &record : table) {
+    co_yield record;
+  }
+}
+/**
+ * @brief Parse records into one buffer in the frame, reusing its capacity.
+ */
+cocos::Generator<const Record &> parse_in_frame(std::size_t n) {
+  Record record{0, payload_size};
+  for (std::size_t i{0}; i < n; ++i) {
+    record.id = i;
+    record.payload.assign(payload_size, 'y');
+    co_yield record;
+  }
+}
+/**
+ * @brief Parse each record into a fresh temporary.
+ */
+cocos::Generator<Record> parse_temporary(std::size_t n) {
+  for (std::size_t i{0}; i < n; ++i) {
+    co_yield Record{static_cast<long>(i), payload_size};
+  }
+}
+
+template <typename G> void consume(benchmark::State &state, G (*make)()) {
+  table();
+  allocations = 0;
+  copies = 0;
+  for (auto _ : state) {
+    auto gen{make()};
+    while (gen.move_next()) {
+      benchmark::DoNotOptimize(gen.current_value().payload.data());
+    }
+  }
+  auto elements{static_cast<double>(state.iterations() * records)};
+  state.counters["allocs_per_record"] = allocations / elements;
+  state.counters["copies_per_record"] = copies / elements;
+  state.SetItemsProcessed(state.iterations() * records);
+}
+} // namespace
+
+// Out of line, so that GCC does not pair the inlined malloc and free with
+// new and delete.
+[[gnu::noinline]] void *operator new(std::size_t size) {
+  ++allocations;
+  if (auto p{std::malloc(size == 0 ? 1 : size)}) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+[[gnu::noinline]] void operator delete(void *p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+/**
+ * @brief Records yielded from a table into a Generator<Record>, each copied
+ * into the frame.
+ */
+static void BM_Generator_RecordCopy(benchmark::State &state) {
+  consume<cocos::Generator<Record>>(state, [] { return scan_copy(table()); });
+}
+BENCHMARK(BM_Generator_RecordCopy);
+
+/**
+ * @brief The same records yielded by reference.
+ */
+static void BM_Generator_RecordRef(benchmark::State &state) {
+  consume<cocos::Generator<const Record &>>(state,
+                                            [] { return scan_ref(table()); });
+}
+BENCHMARK(BM_Generator_RecordRef);
+
+/**
+ * @brief Records parsed into a buffer living in the frame, yielded by
+ * reference.
+ */
+static void BM_Generator_RecordInFrame(benchmark::State &state) {
+  consume<cocos::Generator<const Record &>>(
+      state, [] { return parse_in_frame(records); });
+}
+BENCHMARK(BM_Generator_RecordInFrame);
+
+/**
+ * @brief Records parsed into temporaries, referred to where they are
+ * constructed rather than moved into the promise.
+ */
+static void BM_Generator_RecordTemporary(benchmark::State &state) {
+  consume<cocos::Generator<Record>>(state,
+                                    [] { return parse_temporary(records); });
+}
+BENCHMARK(BM_Generator_RecordTemporary);
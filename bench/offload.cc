@@ -0,0 +1,83 @@
+#include "../include/eventloop.hpp"
+#include "../include/offload.hpp"
+#include "../include/task.hpp"
+#include "../include/when_all.hpp"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cstddef>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+constexpr int concurrent_calls{1000};
+constexpr useconds_t call_us{200};
+
+/**
+ * @brief A blocking call, as a `stat` on a slow disk would be.
+ */
+int blocking_call(int i) {
+  ::usleep(call_us);
+  return i;
+}
+cocos::Task<int> call_inline(int i) { co_return blocking_call(i); }
+cocos::Task<int> call_offloaded(int i) {
+  co_return co_await cocos::offload([i] { return blocking_call(i); });
+}
+/**
+ * @brief Reschedule itself until `done`, recording how long each turn waited
+ * to be resumed.
+ */
+cocos::Task<> ticker(const bool &done, std::vector<cocos::Duration> &delays) {
+  while (!done) {
+    auto scheduled{std::chrono::steady_clock::now()};
+    co_await cocos::reschedule();
+    delays.push_back(std::chrono::steady_clock::now() - scheduled);
+  }
+}
+cocos::Task<> calls(bool offloaded, bool &done) {
+  std::vector<cocos::Task<int>> tasks;
+  for (int i{0}; i < concurrent_calls; ++i) {
+    tasks.push_back(offloaded ? call_offloaded(i) : call_inline(i));
+  }
+  benchmark::DoNotOptimize(co_await cocos::when_all(std::move(tasks)));
+  done = true;
+}
+double percentile_us(std::vector<cocos::Duration> &samples, double p) {
+  auto n{static_cast<std::size_t>(p * static_cast<double>(samples.size()))};
+  auto it{samples.begin() +
+          static_cast<std::ptrdiff_t>(std::min(n, samples.size() - 1))};
+  std::ranges::nth_element(samples, it);
+  return std::chrono::duration<double, std::micro>{*it}.count();
+}
+} // namespace
+
+/**
+ * @brief How long the loop takes to get back to a ready coroutine while 1000
+ * calls blocking for 200us each are in flight. The argument is whether the
+ * calls are offloaded to the default BlockingPool, or made on the loop.
+ * Reports the 50th and 99th percentiles of the delay in microseconds.
+ */
+static void BM_Offload_SchedulingDelay(benchmark::State &state) {
+  auto offloaded{state.range(0) != 0};
+  auto &loop{cocos::EventLoop::get_loop()};
+  std::vector<cocos::Duration> delays;
+  for (auto _ : state) {
+    bool done{false};
+    auto tick{ticker(done, delays)};
+    auto work{calls(offloaded, done)};
+    loop.add_task(tick);
+    loop.add_task(work);
+    loop.run();
+  }
+  state.counters["p50_us"] = percentile_us(delays, 0.5);
+  state.counters["p99_us"] = percentile_us(delays, 0.99);
+  state.SetItemsProcessed(state.iterations() * concurrent_calls);
+}
+BENCHMARK(BM_Offload_SchedulingDelay)
+    ->ArgName("offloaded")
+    ->Arg(0)
+    ->Arg(1)
+    ->Iterations(5)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,62 @@
+#include "../include/generator.hpp"
+#include "../include/par_map.hpp"
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace {
+constexpr int records{1 << 12};
+
+cocos::Generator<int> range_int(int start, int end) {
+  for (int num{start}; num < end; ++num) {
+    co_yield num;
+  }
+}
+/**
+ * @brief An expensive per-record transform, about 20us of arithmetic.
+ */
+std::uint64_t transform(int record) {
+  auto x{static_cast<std::uint64_t>(record) + 1};
+  for (int i{0}; i < 20'000; ++i) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+  }
+  return x;
+}
+std::uint64_t add(std::uint64_t acc, std::uint64_t val) { return acc + val; }
+} // namespace
+
+/**
+ * @brief The transform on the consuming thread, with Generator::map.
+ */
+static void BM_Map_Sequential(benchmark::State &state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        range_int(0, records).map(transform).fold(std::uint64_t{0}, add));
+  }
+  state.SetItemsProcessed(state.iterations() * records);
+}
+BENCHMARK(BM_Map_Sequential)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * @brief The transform on a pool, with as many workers as the first argument,
+ * a window of 64 records, and in order if the second argument is 1.
+ */
+static void BM_ParMap(benchmark::State &state) {
+  auto n_workers{static_cast<std::size_t>(state.range(0))};
+  auto order{state.range(1) ? cocos::ParMapOrder::ordered
+                            : cocos::ParMapOrder::unordered};
+  cocos::ThreadPoolLoop pool{n_workers};
+  pool.start();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        cocos::par_map(range_int(0, records), transform, pool, 64, order)
+            .fold(std::uint64_t{0}, add));
+  }
+  pool.stop();
+  state.SetItemsProcessed(state.iterations() * records);
+}
+BENCHMARK(BM_ParMap)
+    ->ArgNames({"workers", "ordered"})
+    ->ArgsProduct({benchmark::CreateRange(1, 16, 2), {1, 0}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
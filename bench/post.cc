@@ -0,0 +1,127 @@
+#include "../include/eventloop.hpp"
+#include "../include/task.hpp"
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <coroutine>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr int round_trips{1000};
+constexpr int posts_per_producer{10000};
+
+/**
+ * @brief A loop driven by a thread of its own, kept alive by a guard until
+ * the object is destroyed.
+ */
+class LoopThread {
+  std::atomic<cocos::EventLoop *> loop{nullptr};
+  std::optional<cocos::EventLoop::WorkGuard> guard;
+  std::thread thread;
+
+public:
+  LoopThread()
+      : thread{[this] {
+          auto &loop{cocos::EventLoop::get_loop()};
+          this->guard.emplace(loop);
+          this->loop.store(&loop, std::memory_order_release);
+          loop.run();
+        }} {
+    while (!this->loop.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+  ~LoopThread() {
+    auto release{[](LoopThread &self) -> cocos::Task<> {
+      self.guard.reset();
+      co_return;
+    }(*this)};
+    this->get().post(release);
+    this->thread.join();
+  }
+  cocos::EventLoop &get() { return *this->loop.load(); }
+};
+
+cocos::Task<> ping_pong(cocos::EventLoop &away, cocos::EventLoop &home) {
+  for (int i{0}; i < round_trips; ++i) {
+    co_await cocos::resume_on(away);
+    co_await cocos::resume_on(home);
+  }
+}
+/**
+ * @brief Hands out the handle of the awaiting coroutine, without suspending.
+ */
+struct GetHandle {
+  std::coroutine_handle<> *out;
+  bool await_ready() const noexcept { return false; }
+  bool await_suspend(std::coroutine_handle<> hdl) const noexcept {
+    *this->out = hdl;
+    return false;
+  }
+  void await_resume() const noexcept {}
+};
+/**
+ * @brief Counts its resumes, suspending after each.
+ */
+cocos::Task<> count_resumes(long &count, std::coroutine_handle<> &self) {
+  co_await GetHandle{&self};
+  while (true) {
+    ++count;
+    co_await std::suspend_always{};
+  }
+}
+} // namespace
+
+/**
+ * @brief Round trips of a coroutine between the loop of this thread and the
+ * loop of another, each hop a post waking a loop blocked in epoll_wait.
+ */
+static void BM_Post_PingPong(benchmark::State &state) {
+  LoopThread away;
+  auto &home{cocos::EventLoop::get_loop()};
+  for (auto _ : state) {
+    cocos::EventLoop::WorkGuard guard{home};
+    auto task{ping_pong(away.get(), home)};
+    home.add_task(task);
+    home.run_until([&] { return task.done(); });
+  }
+  state.SetItemsProcessed(state.iterations() * round_trips);
+}
+BENCHMARK(BM_Post_PingPong)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * @brief Posts from the given count of producer threads into one loop, which
+ * takes them in batches off the lock-free stack.
+ */
+static void BM_Post_Producers(benchmark::State &state) {
+  auto producers{static_cast<int>(state.range(0))};
+  auto &loop{cocos::EventLoop::get_loop()};
+  long count{0};
+  std::coroutine_handle<> handle;
+  auto counter{count_resumes(count, handle)};
+  loop.add_task(counter);
+  loop.run_until([&] { return count == 1; });
+  for (auto _ : state) {
+    count = 0;
+    long total{static_cast<long>(producers) * posts_per_producer};
+    cocos::EventLoop::WorkGuard guard{loop};
+    std::vector<std::jthread> threads;
+    for (int p{0}; p < producers; ++p) {
+      threads.emplace_back([&] {
+        for (int i{0}; i < posts_per_producer; ++i) {
+          loop.post(handle);
+        }
+      });
+    }
+    loop.run_until([&] { return count == total; });
+  }
+  state.SetItemsProcessed(state.iterations() * producers *
+                          posts_per_producer);
+}
+BENCHMARK(BM_Post_Producers)
+    ->ArgName("producers")
+    ->Arg(1)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
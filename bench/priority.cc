@@ -0,0 +1,90 @@
+#include "../include/eventloop.hpp"
+#include "../include/sleep.hpp"
+#include "../include/task.hpp"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+namespace {
+constexpr int bulk_tasks{1000};
+constexpr int bulk_rounds{100};
+/**
+ * @brief One probe per round of the flood, over the first half of them.
+ */
+constexpr int probes_per_run{bulk_rounds / 2};
+
+/**
+ * @brief About half a microsecond of work.
+ */
+void work() {
+  for (int i{0}; i < 200; ++i) {
+    benchmark::DoNotOptimize(i);
+  }
+}
+cocos::Task<> bulk() {
+  for (int i{0}; i < bulk_rounds; ++i) {
+    work();
+    co_await cocos::reschedule(cocos::Priority::low);
+  }
+}
+cocos::Task<cocos::Duration> probe(cocos::TimePoint scheduled) {
+  co_return cocos::now() - scheduled;
+}
+/**
+ * @brief Schedule a probe on each turn among the flood, as a request handler
+ * woken in the middle of bulk work would be.
+ */
+cocos::Task<> inject(cocos::Priority priority,
+                     std::deque<cocos::Task<cocos::Duration>> &probes) {
+  auto &loop{cocos::EventLoop::get_loop()};
+  for (int i{0}; i < probes_per_run; ++i) {
+    co_await cocos::reschedule(cocos::Priority::low);
+    loop.add_task(probes.emplace_back(probe(cocos::now())), priority);
+  }
+}
+double percentile_us(std::vector<cocos::Duration> &samples, double p) {
+  auto n{static_cast<std::size_t>(p * static_cast<double>(samples.size()))};
+  auto it{samples.begin() +
+          static_cast<std::ptrdiff_t>(std::min(n, samples.size() - 1))};
+  std::ranges::nth_element(samples, it);
+  return std::chrono::duration<double, std::micro>{*it}.count();
+}
+} // namespace
+
+/**
+ * @brief How long a probe waits in the ready queue of a loop flooded by 1000
+ * low priority tasks, which reschedule themselves 100 times each. The argument
+ * is the priority of the probes: with `low` they queue behind the flood, as
+ * with a plain FIFO. Reports the 50th, 99th and 99.9th percentiles of the
+ * wait in microseconds.
+ */
+static void BM_Priority_ProbeLatency(benchmark::State &state) {
+  auto priority{static_cast<cocos::Priority>(state.range(0))};
+  auto &loop{cocos::EventLoop::get_loop()};
+  std::vector<cocos::Duration> waits;
+  for (auto _ : state) {
+    std::vector<cocos::Task<>> flood;
+    for (int i{0}; i < bulk_tasks; ++i) {
+      loop.add_task(flood.emplace_back(bulk()), cocos::Priority::low);
+    }
+    std::deque<cocos::Task<cocos::Duration>> probes;
+    auto injector{inject(priority, probes)};
+    loop.add_task(injector, cocos::Priority::low);
+    loop.run();
+    for (auto &p : probes) {
+      waits.push_back(p.wait());
+    }
+  }
+  state.counters["p50_us"] = percentile_us(waits, 0.5);
+  state.counters["p99_us"] = percentile_us(waits, 0.99);
+  state.counters["p999_us"] = percentile_us(waits, 0.999);
+}
+BENCHMARK(BM_Priority_ProbeLatency)
+    ->ArgName("priority")
+    ->Arg(static_cast<int>(cocos::Priority::low))
+    ->Arg(static_cast<int>(cocos::Priority::high))
+    ->Iterations(10)
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,110 @@
+#include "../include/chunked_generator.hpp"
+#include "../include/generator.hpp"
+#include "../include/simd.hpp"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace {
+constexpr std::size_t elements{1 << 24};
+constexpr std::size_t batch{1 << 12};
+
+template <typename T> const std::vector<T> &data() {
+  static const std::vector<T> values{[] {
+    std::vector<T> v(elements);
+    for (std::size_t i{0}; i < v.size(); ++i) {
+      v[i] = static_cast<T>(i % 1000);
+    }
+    return v;
+  }()};
+  return values;
+}
+template <typename T> cocos::Generator<T> stream(const std::vector<T> &v) {
+  for (auto &val : v) {
+    co_yield val;
+  }
+}
+template <typename T>
+cocos::ChunkedGenerator<T> chunked_stream(const std::vector<T> &v) {
+  for (std::size_t i{0}; i < v.size(); i += batch) {
+    co_yield std::span<const T>{v}.subspan(i, std::min(batch, v.size() - i));
+  }
+}
+} // namespace
+
+/**
+ * @brief Sum a stream with Generator::fold, an element per resume.
+ */
+template <typename T> static void BM_Sum_Generator(benchmark::State &state) {
+  auto &v{data<T>()};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(stream(v).fold(T{}, std::plus<>{}));
+  }
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+BENCHMARK(BM_Sum_Generator<int>);
+BENCHMARK(BM_Sum_Generator<float>);
+
+/**
+ * @brief Sum a stream of chunks with ChunkedGenerator::fold, a scalar loop.
+ */
+template <typename T> static void BM_Sum_Chunked(benchmark::State &state) {
+  auto &v{data<T>()};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(chunked_stream(v).fold(T{}, std::plus<>{}));
+  }
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+BENCHMARK(BM_Sum_Chunked<int>);
+BENCHMARK(BM_Sum_Chunked<float>);
+
+/**
+ * @brief Sum a stream of chunks with the dispatched kernel.
+ */
+template <typename T> static void BM_Sum_Simd(benchmark::State &state) {
+  auto &v{data<T>()};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cocos::simd::sum(chunked_stream(v)));
+  }
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+BENCHMARK(BM_Sum_Simd<int>);
+BENCHMARK(BM_Sum_Simd<float>);
+
+template <typename T> static void BM_Max_Simd(benchmark::State &state) {
+  auto &v{data<T>()};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cocos::simd::max(chunked_stream(v)));
+  }
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+BENCHMARK(BM_Max_Simd<int>);
+BENCHMARK(BM_Max_Simd<float>);
+
+template <typename T> static void BM_Dot_Simd(benchmark::State &state) {
+  auto &v{data<T>()};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        cocos::simd::dot(chunked_stream(v), chunked_stream(v)));
+  }
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+BENCHMARK(BM_Dot_Simd<int>);
+BENCHMARK(BM_Dot_Simd<float>);
+
+/**
+ * @brief Map a stream of chunks through the dispatched transform, then sum.
+ */
+template <typename T> static void BM_MapSum_Simd(benchmark::State &state) {
+  auto &v{data<T>()};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cocos::simd::sum(cocos::simd::map(
+        chunked_stream(v), [](T x) { return x * 3 + 1; })));
+  }
+  state.SetItemsProcessed(state.iterations() * elements);
+}
+BENCHMARK(BM_MapSum_Simd<int>);
+BENCHMARK(BM_MapSum_Simd<float>);
@@ -0,0 +1,51 @@
+#include "../include/eventloop.hpp"
+#include "../include/sleep.hpp"
+#include "../include/sync_wait.hpp"
+#include "../include/task.hpp"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace {
+cocos::Task<cocos::Duration> oversleep(cocos::Duration duration) {
+  auto deadline{cocos::now() + duration};
+  co_await cocos::sleep_until(deadline);
+  co_return cocos::now() - deadline;
+}
+double percentile_us(std::vector<cocos::Duration> &samples, double p) {
+  auto n{static_cast<std::size_t>(p * static_cast<double>(samples.size()))};
+  auto it{samples.begin() +
+          static_cast<std::ptrdiff_t>(std::min(n, samples.size() - 1))};
+  std::ranges::nth_element(samples, it);
+  return std::chrono::duration<double, std::micro>{*it}.count();
+}
+} // namespace
+
+/**
+ * @brief How late a sleep wakes up on the thread's loop, with the sleep and
+ * the spin threshold in microseconds as the arguments. Reports the 50th, 99th
+ * and 99.9th percentiles of the lateness in microseconds.
+ */
+static void BM_Sleep_Lateness(benchmark::State &state) {
+  cocos::Duration duration{std::chrono::microseconds{state.range(0)}};
+  auto &loop{cocos::EventLoop::get_loop()};
+  auto threshold{loop.get_spin_threshold()};
+  loop.set_spin_threshold(std::chrono::microseconds{state.range(1)});
+  std::vector<cocos::Duration> lateness;
+  lateness.reserve(static_cast<std::size_t>(state.max_iterations));
+  for (auto _ : state) {
+    lateness.push_back(cocos::sync_wait(oversleep(duration)));
+  }
+  loop.set_spin_threshold(threshold);
+  state.counters["p50_us"] = percentile_us(lateness, 0.5);
+  state.counters["p99_us"] = percentile_us(lateness, 0.99);
+  state.counters["p999_us"] = percentile_us(lateness, 0.999);
+}
+BENCHMARK(BM_Sleep_Lateness)
+    ->ArgNames({"sleep_us", "spin_us"})
+    ->ArgsProduct({{100, 1'000, 10'000}, {0, 50}})
+    ->Iterations(1000)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
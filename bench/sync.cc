@@ -0,0 +1,83 @@
+#include "../include/eventloop.hpp"
+#include "../include/sync.hpp"
+#include "../include/sync_wait.hpp"
+#include "../include/task.hpp"
+#include "../include/threadpool.hpp"
+#include "../include/when_all.hpp"
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <vector>
+
+namespace {
+constexpr long locks{1 << 16};
+
+cocos::Task<> increment(cocos::AsyncMutex &mutex, long &counter, long n) {
+  for (long i{0}; i < n; ++i) {
+    auto guard{co_await mutex.scoped_lock()};
+    ++counter;
+  }
+}
+cocos::Task<long> contend(int coroutines) {
+  cocos::AsyncMutex mutex;
+  long counter{0};
+  std::vector<cocos::Task<>> tasks;
+  for (int i{0}; i < coroutines; ++i) {
+    tasks.push_back(increment(mutex, counter, locks / coroutines));
+  }
+  co_await cocos::when_all(std::move(tasks));
+  co_return counter;
+}
+
+/**
+ * @brief Holds the mutex across a reschedule, so that every other coroutine
+ * queues on it, and hands it over by `unlock()` or by `async_unlock()`.
+ */
+cocos::Task<> hand_over(cocos::AsyncMutex &mutex, long n, bool transfer) {
+  for (long i{0}; i < n; ++i) {
+    co_await mutex.lock();
+    co_await cocos::reschedule();
+    if (transfer) {
+      co_await mutex.async_unlock();
+    } else {
+      mutex.unlock();
+    }
+  }
+}
+} // namespace
+
+/**
+ * @brief Eight coroutines taking turns on one mutex, on a pool with as many
+ * workers as the argument.
+ */
+static void BM_AsyncMutex_ThreadPool(benchmark::State &state) {
+  cocos::ThreadPoolLoop pool{static_cast<std::size_t>(state.range(0))};
+  pool.start();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cocos::sync_wait(pool, contend(8)));
+  }
+  pool.stop();
+  state.SetItemsProcessed(state.iterations() * locks);
+}
+BENCHMARK(BM_AsyncMutex_ThreadPool)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+
+/**
+ * @brief Eight coroutines queued on one mutex on a single loop, handed over
+ * through a post by `unlock()` (0), or by symmetric transfer (1).
+ */
+static void BM_AsyncMutex_Handoff(benchmark::State &state) {
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::AsyncMutex mutex;
+  for (auto _ : state) {
+    std::vector<cocos::Task<>> tasks;
+    for (int i{0}; i < 8; ++i) {
+      tasks.push_back(hand_over(mutex, locks / 8, state.range(0) != 0));
+      loop.add_task(tasks.back());
+    }
+    loop.run();
+  }
+  state.SetItemsProcessed(state.iterations() * locks);
+}
+BENCHMARK(BM_AsyncMutex_Handoff)->Arg(0)->Arg(1);
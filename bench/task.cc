@@ -0,0 +1,86 @@
+#include "../include/eventloop.hpp"
+#include "../include/task.hpp"
+#include "../include/when_all.hpp"
+#include <benchmark/benchmark.h>
+#include <vector>
+
+namespace {
+constexpr int awaits_per_run{1000};
+
+cocos::Task<int> trivial() { co_return 1; }
+
+cocos::Task<long> await_trivial(int n) {
+  long sum{0};
+  for (int i{0}; i < n; ++i) {
+    sum += co_await trivial();
+  }
+  co_return sum;
+}
+} // namespace
+
+/**
+ * @brief The cost of one `co_await` of a Task<int> that completes at once,
+ * including the frame of the awaited task.
+ */
+static void BM_CoAwait_TrivialTask(benchmark::State &state) {
+  auto &loop{cocos::EventLoop::get_loop()};
+  for (auto _ : state) {
+    auto t{await_trivial(awaits_per_run)};
+    loop.add_task(t);
+    loop.run();
+    benchmark::DoNotOptimize(t.wait());
+  }
+  state.SetItemsProcessed(state.iterations() * awaits_per_run);
+}
+BENCHMARK(BM_CoAwait_TrivialTask);
+
+namespace {
+cocos::Task<long> nested(int depth) {
+  if (depth == 0) {
+    co_return 0;
+  }
+  co_return 1 + co_await nested(depth - 1);
+}
+} // namespace
+
+/**
+ * @brief A chain of co_awaits as deep as the argument, driven without a loop.
+ */
+static void BM_CoAwait_DeepChain(benchmark::State &state) {
+  auto depth{static_cast<int>(state.range(0))};
+  for (auto _ : state) {
+    auto t{nested(depth)};
+    benchmark::DoNotOptimize(t.wait());
+  }
+  state.SetItemsProcessed(state.iterations() * depth);
+}
+BENCHMARK(BM_CoAwait_DeepChain)->Arg(16)->Arg(1 << 16);
+
+namespace {
+cocos::Task<long> fan_out(int n) {
+  std::vector<cocos::Task<int>> children;
+  children.reserve(static_cast<std::size_t>(n));
+  for (int i{0}; i < n; ++i) {
+    children.push_back(trivial());
+  }
+  long sum{0};
+  for (auto v : co_await cocos::when_all(std::move(children))) {
+    sum += v;
+  }
+  co_return sum;
+}
+} // namespace
+
+/**
+ * @brief Fan out to as many trivial tasks as the argument and join them with
+ * one when_all.
+ */
+static void BM_WhenAll_FanOut(benchmark::State &state) {
+  auto n{static_cast<int>(state.range(0))};
+  for (auto _ : state) {
+    auto t{fan_out(n)};
+    benchmark::DoNotOptimize(t.wait());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_WhenAll_FanOut)->Arg(16)->Arg(1024);
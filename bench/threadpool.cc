@@ -0,0 +1,66 @@
+#include "../include/eventloop.hpp"
+#include "../include/task.hpp"
+#include "../include/threadpool.hpp"
+#include <benchmark/benchmark.h>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr int fan_out{1024};
+constexpr int work_per_task{20000};
+
+cocos::Task<long> crunch(int seed) {
+  long acc{seed};
+  for (int i{0}; i < work_per_task; ++i) {
+    acc = acc * 6364136223846793005L + 1442695040888963407L;
+    benchmark::DoNotOptimize(acc);
+  }
+  co_return acc;
+}
+/**
+ * @brief Spawn the children onto the loop of whichever thread runs the root,
+ * so that a pool has to spread them by stealing.
+ */
+cocos::Task<> spawn(std::vector<cocos::Task<long>> &children) {
+  for (auto &child : children) {
+    cocos::EventLoop::get_loop().add_task(child);
+  }
+  co_return;
+}
+std::vector<cocos::Task<long>> make_children() {
+  std::vector<cocos::Task<long>> children;
+  children.reserve(fan_out);
+  for (int i{0}; i < fan_out; ++i) {
+    children.push_back(crunch(i));
+  }
+  return children;
+}
+} // namespace
+
+static void BM_FanOut_EventLoop(benchmark::State &state) {
+  for (auto _ : state) {
+    auto children{make_children()};
+    auto root{spawn(children)};
+    auto &loop{cocos::EventLoop::get_loop()};
+    loop.add_task(root);
+    loop.run();
+  }
+  state.SetItemsProcessed(state.iterations() * fan_out);
+}
+BENCHMARK(BM_FanOut_EventLoop)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_FanOut_ThreadPool(benchmark::State &state) {
+  for (auto _ : state) {
+    cocos::ThreadPoolLoop pool{static_cast<std::size_t>(state.range(0))};
+    auto children{make_children()};
+    auto root{spawn(children)};
+    pool.add_task(root);
+    pool.run();
+  }
+  state.SetItemsProcessed(state.iterations() * fan_out);
+}
+BENCHMARK(BM_FanOut_ThreadPool)
+    ->RangeMultiplier(2)
+    ->Range(1, std::max(1u, std::thread::hardware_concurrency()))
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,135 @@
+#include "../include/timer_wheel.hpp"
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <coroutine>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+constexpr std::size_t sleepers{1'000'000};
+constexpr auto horizon{std::chrono::seconds{10}};
+constexpr auto step{std::chrono::milliseconds{1}};
+
+/**
+ * @brief The entry of the binary heap EventLoop used before the timer wheel.
+ */
+struct HeapDelay {
+  std::coroutine_handle<> sleeping_coro;
+  Clock::time_point awake_time;
+  bool operator<(const HeapDelay &other) const {
+    return awake_time > other.awake_time;
+  }
+};
+
+std::vector<Clock::time_point> make_deadlines(Clock::time_point origin) {
+  std::mt19937_64 rng{42};
+  std::uniform_int_distribution<Clock::rep> dist{
+      0, std::chrono::duration_cast<Clock::duration>(horizon).count()};
+  std::vector<Clock::time_point> deadlines(sleepers);
+  for (auto &d : deadlines) {
+    d = origin + Clock::duration{dist(rng)};
+  }
+  return deadlines;
+}
+} // namespace
+
+/**
+ * @brief Insert every sleeper, then expire them in 1ms loop iterations.
+ */
+static void BM_Heap_InsertExpire(benchmark::State &state) {
+  auto origin{Clock::now()};
+  auto deadlines{make_deadlines(origin)};
+  for (auto _ : state) {
+    std::priority_queue<HeapDelay> heap;
+    for (auto d : deadlines) {
+      heap.push({std::noop_coroutine(), d});
+    }
+    std::size_t fired{0};
+    for (auto now{origin}; !heap.empty(); now += step) {
+      while (!heap.empty() && heap.top().awake_time <= now) {
+        heap.pop();
+        ++fired;
+      }
+    }
+    benchmark::DoNotOptimize(fired);
+  }
+  state.SetItemsProcessed(state.iterations() * sleepers);
+}
+BENCHMARK(BM_Heap_InsertExpire)->Unit(benchmark::kMillisecond);
+
+static void BM_Wheel_InsertExpire(benchmark::State &state) {
+  auto origin{Clock::now()};
+  auto deadlines{make_deadlines(origin)};
+  std::vector<cocos::TimerNode> nodes(sleepers);
+  for (auto _ : state) {
+    cocos::TimerWheel wheel{std::chrono::milliseconds{1}, origin};
+    for (std::size_t i{0}; i < sleepers; ++i) {
+      nodes[i].awake_time = deadlines[i];
+      wheel.insert(nodes[i]);
+    }
+    std::size_t fired{0};
+    for (auto now{origin}; !wheel.empty(); now += step) {
+      fired += wheel.expire(now, [](cocos::TimerNode &) {});
+    }
+    benchmark::DoNotOptimize(fired);
+  }
+  state.SetItemsProcessed(state.iterations() * sleepers);
+}
+BENCHMARK(BM_Wheel_InsertExpire)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Most timeouts are cancelled before they fire. The heap cannot remove
+ * an entry, so cancelled ones are skipped lazily when they reach the top.
+ */
+static void BM_Heap_InsertCancel(benchmark::State &state) {
+  auto origin{Clock::now()};
+  auto deadlines{make_deadlines(origin)};
+  std::vector<char> cancelled(sleepers);
+  for (auto _ : state) {
+    std::priority_queue<std::pair<HeapDelay, std::size_t>> heap;
+    for (std::size_t i{0}; i < sleepers; ++i) {
+      heap.push({{std::noop_coroutine(), deadlines[i]}, i});
+      cancelled[i] = 0;
+    }
+    for (std::size_t i{0}; i < sleepers; ++i) {
+      cancelled[i] = i % 10 != 0;
+    }
+    std::size_t fired{0};
+    for (auto now{origin}; !heap.empty(); now += step) {
+      while (!heap.empty() && heap.top().first.awake_time <= now) {
+        fired += !cancelled[heap.top().second];
+        heap.pop();
+      }
+    }
+    benchmark::DoNotOptimize(fired);
+  }
+  state.SetItemsProcessed(state.iterations() * sleepers);
+}
+BENCHMARK(BM_Heap_InsertCancel)->Unit(benchmark::kMillisecond);
+
+static void BM_Wheel_InsertCancel(benchmark::State &state) {
+  auto origin{Clock::now()};
+  auto deadlines{make_deadlines(origin)};
+  std::vector<cocos::TimerNode> nodes(sleepers);
+  for (auto _ : state) {
+    cocos::TimerWheel wheel{std::chrono::milliseconds{1}, origin};
+    for (std::size_t i{0}; i < sleepers; ++i) {
+      nodes[i].awake_time = deadlines[i];
+      wheel.insert(nodes[i]);
+    }
+    for (std::size_t i{0}; i < sleepers; ++i) {
+      if (i % 10 != 0) {
+        wheel.cancel(nodes[i]);
+      }
+    }
+    std::size_t fired{0};
+    for (auto now{origin}; !wheel.empty(); now += step) {
+      fired += wheel.expire(now, [](cocos::TimerNode &) {});
+    }
+    benchmark::DoNotOptimize(fired);
+  }
+  state.SetItemsProcessed(state.iterations() * sleepers);
+}
+BENCHMARK(BM_Wheel_InsertCancel)->Unit(benchmark::kMillisecond);
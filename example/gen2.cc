@@ -1,4 +1,5 @@
 #include "../include/generator.hpp"
+#include "../include/pipeline.hpp"
 #include <iostream>
 
 cocos::Generator<int> range_int(int start, int end) {
@@ -24,4 +25,8 @@ int main() {
       .filter([](int i) { return i % 2 == 0; })
       .scan(0, [](int acc, int i) { return acc + i; })
       .for_each([](int &i) { std::cout << i << "\n"; });
+  // The same as the first chain, fused into one loop over range_int.
+  (range_int(0, 10) | cocos::pipe::filter([](int i) { return i % 2 == 0; }) |
+   cocos::pipe::map([](int i) { return i * i; }) | cocos::pipe::take(3))
+      .for_each([](int i) { std::cout << i << std::endl; });
 }
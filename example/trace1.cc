@@ -0,0 +1,60 @@
+#define COCOS_TRACING 1
+#include "../include/sleep.hpp"
+#include "../include/task.hpp"
+#include "../include/trace.hpp"
+#include <fstream>
+#include <iostream>
+
+using namespace std::chrono_literals;
+
+cocos::Task<> tick(int n) {
+  for (int i{0}; i < n; ++i) {
+    co_await cocos::sleep_for(1ms);
+  }
+}
+
+long sink{0};
+
+/**
+ * @brief Hogs the loop for a few milliseconds, which shows in the trace.
+ */
+cocos::Task<> hog() {
+  unsigned long acc{1};
+  for (long i{0}; i < 10'000'000; ++i) {
+    acc = acc * 6364136223846793005UL + 1442695040888963407UL;
+  }
+  sink = static_cast<long>(acc);
+  co_return;
+}
+
+int main() {
+  auto &recorder{cocos::TraceRecorder::get()};
+  recorder.start();
+  auto &loop{cocos::EventLoop::get_loop()};
+  auto t1{tick(10)};
+  auto t2{tick(5)};
+  auto t3{hog()};
+  loop.add_task(t1);
+  loop.add_task(t2);
+  loop.add_task(t3);
+  loop.run();
+  recorder.stop();
+
+  auto &stats{loop.get_stats()};
+  auto us{[](auto d) { return d.count() / 1000.0; }};
+  std::cout << "resumes: " << stats.resumes
+            << ", timer fires: " << stats.timer_fires
+            << ", ready high water: " << stats.ready_high_water << "\n"
+            << "resume time p50/p99/max (us): "
+            << us(stats.resume_time.percentile(0.5)) << " / "
+            << us(stats.resume_time.percentile(0.99)) << " / "
+            << us(stats.resume_time.max()) << "\n"
+            << "timer lateness p50/p99/max (us): "
+            << us(stats.timer_lateness.percentile(0.5)) << " / "
+            << us(stats.timer_lateness.percentile(0.99)) << " / "
+            << us(stats.timer_lateness.max()) << "\n";
+
+  // Load it in https://ui.perfetto.dev or chrome://tracing.
+  std::ofstream out{"trace.json"};
+  recorder.write_json(out);
+}
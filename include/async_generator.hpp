@@ -0,0 +1,265 @@
+#ifndef COCOS_ASYNC_GENERATOR
+#define COCOS_ASYNC_GENERATOR
+#include "cancellation.hpp"
+#include "coroutine_concepts.hpp"
+#include "frame_allocator.hpp"
+#include "task.hpp"
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+
+namespace cocos {
+template <typename T> class AsyncGenerator;
+
+/**
+ * @brief The producer side of an AsyncGenerator. Yielded values are queued in
+ * the promise; the producer is parked when the queue is full, or hands over
+ * to a waiting consumer directly (symmetric transfer).
+ */
+template <typename T> struct AsyncGeneratorPromise : PooledPromise {
+  std::deque<T> buffer;
+  /**
+   * @brief How many values the producer may queue ahead of the consumer, none
+   * unless prefetching.
+   */
+  std::size_t capacity{0};
+  /**
+   * @brief Whether the producer is suspended at a yield or at its start, so
+   * that the consumer may resume it, rather than waiting for something else.
+   */
+  bool parked{true};
+  bool finished{false};
+  std::coroutine_handle<> consumer{};
+  std::exception_ptr error{};
+  std::stop_token stop_token{};
+
+  struct YieldAwaiter {
+    AsyncGeneratorPromise *promise;
+    /**
+     * @brief Go on producing while nobody waits and there is room.
+     */
+    bool await_ready() const noexcept {
+      return !this->promise->consumer &&
+             this->promise->buffer.size() < this->promise->capacity;
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept {
+      this->promise->parked = true;
+      if (auto consumer{std::exchange(this->promise->consumer, {})}) {
+        return consumer;
+      }
+      return std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<AsyncGeneratorPromise> hdl) noexcept {
+      auto &promise{hdl.promise()};
+      promise.finished = true;
+      if (auto consumer{std::exchange(promise.consumer, {})}) {
+        return consumer;
+      }
+      return std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  AsyncGenerator<T> get_return_object() {
+    return AsyncGenerator<T>{
+        std::coroutine_handle<AsyncGeneratorPromise>::from_promise(*this)};
+  }
+  void unhandled_exception() { this->error = std::current_exception(); }
+  void return_void() const noexcept {}
+  template <typename U> YieldAwaiter yield_value(U &&val) {
+    this->buffer.emplace_back(std::forward<U>(val));
+    return {this};
+  }
+  /**
+   * @brief The producer may await anything a Task may, with the stop token of
+   * its consumer.
+   */
+  template <concepts::Awaiter A> A await_transform(A &&a) const noexcept {
+    if constexpr (concepts::Stoppable<A>) {
+      a.set_stop_token(this->stop_token);
+    }
+    return std::forward<A>(a);
+  }
+  StopTokenAwaiter await_transform(GetStopToken) const noexcept {
+    return {this->stop_token};
+  }
+  template <typename U> TaskAwaiter<U> await_transform(Task<U> &t) noexcept {
+    return this->await_transform(std::move(t));
+  }
+  template <typename U> TaskAwaiter<U> await_transform(Task<U> &&t) noexcept {
+    TaskAwaiter<U> awaiter{std::move(t)};
+    awaiter.set_stop_token(this->stop_token);
+    return awaiter;
+  }
+};
+
+/**
+ * @brief A lazily evaluating generator whose body may `co_await`, e.g. sleeps,
+ * I/O and tasks. It is consumed from a coroutine, by `co_await gen.next()`.
+ *
+ * By default the producer runs only while the consumer waits for a value.
+ * With `prefetch(k)`, it is resumed again as soon as the consumer takes a
+ * value, and runs ahead until `k` values are queued, so that its waits
+ * overlap with the work of the consumer. The producer and the consumer must
+ * run on the same thread.
+ *
+ * @tparam T The type to be generated.
+ */
+template <typename T> class AsyncGenerator {
+public:
+  using promise_type = AsyncGeneratorPromise<T>;
+  using Self = AsyncGenerator;
+
+private:
+  using THandle = std::coroutine_handle<promise_type>;
+
+public:
+  class NextAwaiter {
+    THandle producer;
+
+  public:
+    explicit NextAwaiter(THandle producer) noexcept : producer{producer} {}
+    bool await_ready() const noexcept {
+      auto &promise{this->producer.promise()};
+      return !promise.buffer.empty() || promise.finished;
+    }
+    /**
+     * @brief Resume a parked producer directly, or wait for the one which is
+     * waiting for something else to yield.
+     */
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<> hdl) noexcept {
+      auto &promise{this->producer.promise()};
+      promise.consumer = hdl;
+      if (std::exchange(promise.parked, false)) {
+        return this->producer;
+      }
+      return std::noop_coroutine();
+    }
+    /**
+     * @brief A consumer which is cancellable makes its producer cancellable
+     * through the same token, unless it was given one of its own.
+     */
+    void set_stop_token(const std::stop_token &token) noexcept {
+      auto &own{this->producer.promise().stop_token};
+      if (!own.stop_possible()) {
+        own = token;
+      }
+    }
+    /**
+     * @return std::optional<T> The next value, nullopt once the generator is
+     * exhausted.
+     * @throw What the producer threw, after the values yielded before.
+     */
+    std::optional<T> await_resume() {
+      auto &promise{this->producer.promise()};
+      if (promise.buffer.empty()) {
+        if (promise.error) {
+          std::rethrow_exception(std::exchange(promise.error, {}));
+        }
+        return std::nullopt;
+      }
+      std::optional<T> val{std::move(promise.buffer.front())};
+      promise.buffer.pop_front();
+      if (promise.capacity != 0 && !promise.finished &&
+          std::exchange(promise.parked, false)) {
+        // Refill in the background: the producer runs until it is full, or
+        // suspends on something else.
+        this->producer.resume();
+      }
+      return val;
+    }
+  };
+
+  constexpr AsyncGenerator() : co_handle{} {}
+  explicit AsyncGenerator(THandle handle) : co_handle{handle} {}
+  AsyncGenerator(const Self &) = delete;
+  AsyncGenerator(Self &&other)
+      : co_handle{std::exchange(other.co_handle, {})} {}
+  auto operator=(const Self &) = delete;
+  Self &operator=(Self &&other) {
+    Self tmp{std::move(other)};
+    this->swap(tmp);
+    return *this;
+  }
+  /**
+   * @brief Destroy the producer. It must not be running, nor be queued on a
+   * loop, but may be suspended on a timer or a descriptor.
+   */
+  ~AsyncGenerator() {
+    if (this->co_handle) {
+      this->co_handle.destroy();
+    }
+  }
+  void swap(Self &other) { std::swap(this->co_handle, other.co_handle); }
+  bool has_coroutine() const noexcept { return this->co_handle; }
+
+  /**
+   * @brief `co_await gen.next()` produces the next value, or nullopt once the
+   * generator is exhausted.
+   */
+  NextAwaiter next() { return NextAwaiter{this->co_handle}; }
+  /**
+   * @brief Let the producer run up to `count` values ahead of the consumer,
+   * none being the default.
+   */
+  Self prefetch(std::size_t count) && {
+    this->co_handle.promise().capacity = count;
+    return std::move(*this);
+  }
+  /**
+   * @brief Mapping each element into another value using `f`.
+   */
+  template <typename F> AsyncGenerator<std::invoke_result_t<F, T &>> map(F f) {
+    using U = std::invoke_result_t<F, T &>;
+    return [](Self g, F f) -> AsyncGenerator<U> {
+      while (auto val{co_await g.next()}) {
+        co_yield f(*val);
+      }
+    }(std::move(*this), std::move(f));
+  }
+  /**
+   * @brief Passing on the elements where `f(elem)` is `true`.
+   */
+  template <typename F> Self filter(F f) {
+    return [](Self g, F f) -> Self {
+      while (auto val{co_await g.next()}) {
+        if (f(*val)) {
+          co_yield std::move(*val);
+        }
+      }
+    }(std::move(*this), std::move(f));
+  }
+  /**
+   * @brief Passing on the first `n` elements. The source is not pulled again
+   * after the last of them.
+   */
+  Self take(std::size_t n) {
+    return [](Self g, std::size_t n) -> Self {
+      for (; n != 0; --n) {
+        auto val{co_await g.next()};
+        if (!val) {
+          break;
+        }
+        co_yield std::move(*val);
+      }
+    }(std::move(*this), n);
+  }
+
+private:
+  THandle co_handle;
+};
+} // namespace cocos
+#endif // COCOS_ASYNC_GENERATOR
@@ -0,0 +1,115 @@
+#ifndef COCOS_CANCELLATION
+#define COCOS_CANCELLATION
+#include "eventloop.hpp"
+#include "reactor.hpp"
+#include "timer_wheel.hpp"
+#include <coroutine>
+#include <cstddef>
+#include <new>
+#include <stop_token>
+#include <system_error>
+#include <utility>
+
+namespace cocos {
+/**
+ * @brief Thrown into a coroutine whose wait was cancelled through its stop
+ * token.
+ */
+class Cancelled : public std::system_error {
+public:
+  Cancelled()
+      : std::system_error{std::make_error_code(std::errc::operation_canceled)} {
+  }
+};
+
+/**
+ * @brief `co_await get_stop_token()` in a task produces the stop token the
+ * task was started with, without suspending.
+ */
+struct GetStopToken {};
+inline GetStopToken get_stop_token() noexcept { return {}; }
+
+struct StopTokenAwaiter {
+  std::stop_token token;
+  bool await_ready() const noexcept { return true; }
+  void await_suspend(std::coroutine_handle<>) const noexcept {}
+  std::stop_token await_resume() noexcept { return std::move(this->token); }
+};
+
+namespace detail {
+/**
+ * @brief Room for a `std::stop_callback` in an awaiter, which must stay
+ * movable until it is suspended. Like TimerNode, a copy is never registered.
+ */
+template <typename F> class StopCallbackSlot {
+  using Callback = std::stop_callback<F>;
+  alignas(Callback) std::byte storage[sizeof(Callback)];
+  bool engaged{false};
+
+public:
+  StopCallbackSlot() = default;
+  StopCallbackSlot(const StopCallbackSlot &) noexcept {}
+  StopCallbackSlot &operator=(const StopCallbackSlot &) noexcept {
+    this->reset();
+    return *this;
+  }
+  ~StopCallbackSlot() { this->reset(); }
+  /**
+   * @brief Register `f` to be called when a stop is requested, or call it at
+   * once if one has been requested already.
+   */
+  void emplace(const std::stop_token &token, F f) {
+    this->reset();
+    ::new (this->storage) Callback{token, std::move(f)};
+    this->engaged = true;
+  }
+  void reset() noexcept {
+    if (this->engaged) {
+      std::launder(reinterpret_cast<Callback *>(this->storage))->~Callback();
+      this->engaged = false;
+    }
+  }
+};
+
+/**
+ * @brief Unlink a pending timer and reschedule its coroutine. A stop requested
+ * on another thread than the one driving the loop is handed over to it.
+ */
+struct TimerCanceller {
+  EventLoop *loop;
+  TimerNode *node;
+  void operator()() const noexcept {
+    if (!this->loop->is_current()) {
+      this->loop->cancel_remotely(*this->node);
+    } else if (this->node->linked()) {
+      this->loop->cancel_delayed_task(*this->node);
+      this->loop->add_task(this->node->coro);
+    }
+  }
+};
+/**
+ * @brief Remove a pending wait from the reactor and reschedule its coroutine,
+ * the same way as TimerCanceller.
+ */
+struct IoCanceller {
+  EventLoop *loop;
+  IoWaiter *waiter;
+  void operator()() const noexcept {
+    if (!this->loop->is_current()) {
+      this->loop->cancel_remotely(*this->waiter);
+    } else if (this->waiter->linked()) {
+      this->loop->get_reactor().remove(*this->waiter);
+      this->loop->add_task(this->waiter->coro);
+    }
+  }
+};
+/**
+ * @brief Forward a stop request to another stop source.
+ */
+struct StopForwarder {
+  std::stop_source *target;
+  void operator()() const noexcept { this->target->request_stop(); }
+};
+} // namespace detail
+} // namespace cocos
+#endif // COCOS_CANCELLATION
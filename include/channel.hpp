@@ -0,0 +1,503 @@
+#ifndef COCOS_CHANNEL
+#define COCOS_CHANNEL
+#include "cancellation.hpp"
+#include "eventloop.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+namespace cocos {
+namespace detail {
+/**
+ * @brief A bounded lock-free MPMC queue (Vyukov). Each cell carries a sequence
+ * number telling whether it is free for the producer or full for the consumer
+ * at a given position, so producers and consumers only contend on their own
+ * position counter.
+ *
+ * Closing sets the top bit of the producer counter, so that a push racing
+ * with close() either reserved its cell before, or fails.
+ */
+template <typename T> class BoundedQueue {
+  struct Cell {
+    std::atomic<std::size_t> seq;
+    alignas(T) std::byte storage[sizeof(T)];
+
+    T *value() noexcept {
+      return std::launder(reinterpret_cast<T *>(this->storage));
+    }
+  };
+
+  static constexpr std::size_t closed_bit{~(~std::size_t{0} >> 1)};
+
+  std::size_t mask;
+  std::unique_ptr<Cell[]> cells;
+  alignas(64) std::atomic<std::size_t> head{0};
+  alignas(64) std::atomic<std::size_t> tail{0};
+
+public:
+  /**
+   * @param capacity Rounded up to a power of two, and at least 2.
+   */
+  explicit BoundedQueue(std::size_t capacity)
+      : mask{std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1},
+        cells{std::make_unique<Cell[]>(this->mask + 1)} {
+    for (std::size_t i{0}; i <= this->mask; ++i) {
+      this->cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+  BoundedQueue(const BoundedQueue &) = delete;
+  auto operator=(const BoundedQueue &) = delete;
+  ~BoundedQueue() {
+    std::optional<T> value;
+    while (this->try_pop(value)) {
+    }
+  }
+
+  std::size_t capacity() const noexcept { return this->mask + 1; }
+  /**
+   * @brief A snapshot, which may be stale by the time it is returned.
+   */
+  std::size_t size() const noexcept {
+    auto tail{this->tail.load(std::memory_order_relaxed) & ~closed_bit};
+    auto head{this->head.load(std::memory_order_relaxed)};
+    return tail > head ? tail - head : 0;
+  }
+  bool closed() const noexcept {
+    return this->tail.load(std::memory_order_acquire) & closed_bit;
+  }
+  /**
+   * @brief Make every later push fail. Pops go on until the queue is empty.
+   */
+  void close() noexcept {
+    this->tail.fetch_or(closed_bit, std::memory_order_acq_rel);
+  }
+  /**
+   * @brief Move `value` into the queue, unless it is full or closed.
+   */
+  bool try_push(T &value) {
+    auto pos{this->tail.load(std::memory_order_relaxed)};
+    while (true) {
+      if (pos & closed_bit) {
+        return false;
+      }
+      auto &cell{this->cells[pos & this->mask]};
+      auto seq{cell.seq.load(std::memory_order_acquire)};
+      auto diff{static_cast<std::ptrdiff_t>(seq - pos)};
+      if (diff == 0) {
+        if (this->tail.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+          ::new (cell.storage) T(std::move(value));
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = this->tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+  /**
+   * @brief Move the oldest value into `out`, unless the queue is empty. Once
+   * closed, it is empty only when every push reserved before is taken, so
+   * that an empty closed queue stays empty.
+   */
+  bool try_pop(std::optional<T> &out) {
+    auto pos{this->head.load(std::memory_order_relaxed)};
+    while (true) {
+      auto &cell{this->cells[pos & this->mask]};
+      auto seq{cell.seq.load(std::memory_order_acquire)};
+      auto diff{static_cast<std::ptrdiff_t>(seq - (pos + 1))};
+      if (diff == 0) {
+        if (this->head.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+          out.emplace(std::move(*cell.value()));
+          cell.value()->~T();
+          cell.seq.store(pos + this->mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        auto tail{this->tail.load(std::memory_order_acquire)};
+        if (!(tail & closed_bit) || (tail & ~closed_bit) == pos) {
+          return false;
+        }
+        // A push reserved the cell before close(), and is storing its value.
+        std::this_thread::yield();
+        pos = this->head.load(std::memory_order_relaxed);
+      } else {
+        pos = this->head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+};
+
+} // namespace detail
+
+/**
+ * @brief A bounded multi-producer multi-consumer channel between coroutines.
+ *
+ * Values go through a lock-free ring buffer. Only a coroutine which finds it
+ * full (or empty) takes a lock, to park itself in an intrusive list; whoever
+ * makes room (or brings a value) later hands it over directly and posts the
+ * parked coroutine back to the loop it parked on, which it holds by a
+ * WorkGuard meanwhile. Counters of parked coroutines, read after a full
+ * fence, let the fast path skip the lock when nobody waits.
+ *
+ * A parked coroutine is unparked by a stop request on the token of the task
+ * awaiting, and then throws Cancelled; a parked awaiter destroyed along with
+ * its coroutine unparks itself.
+ *
+ * It works on an EventLoop as well as on a ThreadPoolLoop, as long as it is
+ * used from coroutines or threads driving a loop.
+ */
+template <typename T> class Channel {
+  using Waiter = detail::ListedWaiter;
+  /**
+   * @brief Unparks a waiter on a stop request.
+   */
+  struct Canceller {
+    Channel *channel;
+    Waiter *waiter;
+    bool sender;
+    void operator()() const noexcept {
+      if (this->channel->unlink(*this->waiter, this->sender)) {
+        this->waiter->cancelled = true;
+        this->waiter->resume_on_loop();
+      }
+    }
+  };
+
+public:
+  /**
+   * @brief `co_await channel.send(v)` produces false if the channel was
+   * closed, in which case the value was not sent.
+   *
+   * @throw Cancelled If a stop was requested before the value was sent.
+   */
+  class SendAwaiter : Waiter {
+    friend class Channel;
+    Channel *channel;
+    T value;
+    bool sent{false};
+    std::stop_token token{};
+    detail::StopCallbackSlot<Canceller> on_stop{};
+
+  public:
+    SendAwaiter(Channel &channel, T value)
+        : channel{&channel}, value{std::move(value)} {}
+    SendAwaiter(SendAwaiter &&) = default;
+    ~SendAwaiter() {
+      if (this->suspended) {
+        this->on_stop.reset();
+        this->channel->unlink(*this, true);
+      }
+    }
+    void set_stop_token(std::stop_token stop_token) noexcept {
+      this->token = std::move(stop_token);
+    }
+    bool await_ready() {
+      if (this->token.stop_requested()) {
+        this->cancelled = true;
+        return true;
+      }
+      if (this->channel->closed()) {
+        return true;
+      }
+      this->sent = this->channel->try_send(this->value);
+      return this->sent;
+    }
+    bool await_suspend(std::coroutine_handle<> hdl) {
+      this->park(hdl);
+      this->suspended = true;
+      if (!this->channel->park_sender(*this)) {
+        this->suspended = false;
+        this->unpark();
+        return false;
+      }
+      if (this->token.stop_possible()) {
+        this->on_stop.emplace(this->token, {this->channel, this, true});
+      }
+      return true;
+    }
+    bool await_resume() {
+      this->on_stop.reset();
+      this->suspended = false;
+      this->unpark();
+      if (this->cancelled) {
+        throw Cancelled{};
+      }
+      return this->sent;
+    }
+  };
+  /**
+   * @brief `co_await channel.recv()` produces std::nullopt once the channel
+   * is closed and drained.
+   *
+   * @throw Cancelled If a stop was requested before a value was received.
+   */
+  class RecvAwaiter : Waiter {
+    friend class Channel;
+    Channel *channel;
+    std::optional<T> value{};
+    std::stop_token token{};
+    detail::StopCallbackSlot<Canceller> on_stop{};
+
+  public:
+    explicit RecvAwaiter(Channel &channel) : channel{&channel} {}
+    RecvAwaiter(RecvAwaiter &&) = default;
+    ~RecvAwaiter() {
+      if (this->suspended) {
+        this->on_stop.reset();
+        this->channel->unlink(*this, false);
+      }
+    }
+    void set_stop_token(std::stop_token stop_token) noexcept {
+      this->token = std::move(stop_token);
+    }
+    bool await_ready() {
+      if (this->token.stop_requested()) {
+        this->cancelled = true;
+        return true;
+      }
+      return this->channel->try_recv_into(this->value) ||
+             this->channel->closed();
+    }
+    bool await_suspend(std::coroutine_handle<> hdl) {
+      this->park(hdl);
+      this->suspended = true;
+      if (!this->channel->park_receiver(*this)) {
+        this->suspended = false;
+        this->unpark();
+        return false;
+      }
+      if (this->token.stop_possible()) {
+        this->on_stop.emplace(this->token, {this->channel, this, false});
+      }
+      return true;
+    }
+    std::optional<T> await_resume() {
+      this->on_stop.reset();
+      this->suspended = false;
+      this->unpark();
+      if (this->cancelled) {
+        throw Cancelled{};
+      }
+      if (!this->value) {
+        // Woken by close(), while a last value may have been sent.
+        this->channel->try_recv_into(this->value);
+      }
+      return std::move(this->value);
+    }
+  };
+
+  /**
+   * @param capacity The count of values buffered before senders are parked,
+   * rounded up to a power of two and at least 2.
+   */
+  explicit Channel(std::size_t capacity) : queue{capacity} {}
+  Channel(const Channel &) = delete;
+  auto operator=(const Channel &) = delete;
+
+  std::size_t capacity() const noexcept { return this->queue.capacity(); }
+  std::size_t size() const noexcept { return this->queue.size(); }
+  bool closed() const noexcept { return this->queue.closed(); }
+  SendAwaiter send(T value) { return SendAwaiter{*this, std::move(value)}; }
+  RecvAwaiter recv() { return RecvAwaiter{*this}; }
+  /**
+   * @brief Send without waiting. `value` is moved from only on success.
+   *
+   * @return false if the channel is full or closed.
+   */
+  bool try_send(T &value) {
+    if (!this->queue.try_push(value)) {
+      return false;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    this->wake();
+    return true;
+  }
+  bool try_send(T &&value) { return this->try_send(value); }
+  /**
+   * @brief Receive without waiting.
+   *
+   * @return std::nullopt if the channel is empty.
+   */
+  std::optional<T> try_recv() {
+    std::optional<T> value;
+    this->try_recv_into(value);
+    return value;
+  }
+  /**
+   * @brief Refuse further sends, and wake every parked coroutine. The values
+   * already sent can still be received.
+   */
+  void close() {
+    detail::WaiterList<Waiter> senders, receivers;
+    {
+      std::lock_guard lk{this->mtx};
+      this->queue.close();
+      for (auto list : {&this->senders, &this->receivers}) {
+        for (auto waiter{list->head}; waiter; waiter = waiter->next) {
+          waiter->listed = false;
+        }
+      }
+      std::swap(senders, this->senders);
+      std::swap(receivers, this->receivers);
+      this->senders_parked.store(0, std::memory_order_relaxed);
+      this->receivers_parked.store(0, std::memory_order_relaxed);
+    }
+    for (auto list : {&senders, &receivers}) {
+      while (auto waiter{list->pop_front()}) {
+        waiter->resume_on_loop();
+      }
+    }
+  }
+
+private:
+  detail::BoundedQueue<T> queue;
+  /**
+   * @brief Guards the lists of parked coroutines only.
+   */
+  std::mutex mtx;
+  detail::WaiterList<Waiter> senders;
+  detail::WaiterList<Waiter> receivers;
+  std::atomic<std::size_t> senders_parked{0};
+  std::atomic<std::size_t> receivers_parked{0};
+
+  bool try_recv_into(std::optional<T> &value) {
+    if (!this->queue.try_pop(value)) {
+      return false;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    this->wake();
+    return true;
+  }
+  /**
+   * @brief Park a sender, unless room was made after it found the queue full,
+   * which the full fence after registering makes visible.
+   *
+   * @return bool Whether the sender should suspend.
+   */
+  bool park_sender(SendAwaiter &awaiter) {
+    std::unique_lock lk{this->mtx};
+    if (this->closed()) {
+      return false;
+    }
+    this->senders.push_back(awaiter);
+    awaiter.listed = true;
+    this->senders_parked.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!this->queue.try_push(awaiter.value)) {
+      return true;
+    }
+    this->senders.remove(awaiter);
+    awaiter.listed = false;
+    this->senders_parked.fetch_sub(1, std::memory_order_relaxed);
+    awaiter.sent = true;
+    lk.unlock();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    this->wake();
+    return false;
+  }
+  bool park_receiver(RecvAwaiter &awaiter) {
+    std::unique_lock lk{this->mtx};
+    if (this->closed()) {
+      lk.unlock();
+      this->try_recv_into(awaiter.value);
+      return false;
+    }
+    this->receivers.push_back(awaiter);
+    awaiter.listed = true;
+    this->receivers_parked.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!this->queue.try_pop(awaiter.value)) {
+      return true;
+    }
+    this->receivers.remove(awaiter);
+    awaiter.listed = false;
+    this->receivers_parked.fetch_sub(1, std::memory_order_relaxed);
+    lk.unlock();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    this->wake();
+    return false;
+  }
+  /**
+   * @brief Take a waiter out of its list, unless it was woken already.
+   *
+   * @return bool Whether it was still parked.
+   */
+  bool unlink(Waiter &waiter, bool sender) noexcept {
+    std::lock_guard lk{this->mtx};
+    if (!waiter.listed) {
+      return false;
+    }
+    (sender ? this->senders : this->receivers).remove(waiter);
+    waiter.listed = false;
+    (sender ? this->senders_parked : this->receivers_parked)
+        .fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  /**
+   * @brief Called after a full fence by whoever changed the queue. While
+   * there are both a parked receiver and a value, or a parked sender and
+   * room, hand them over and post the woken coroutine to its loop. Each
+   * hand-over may enable the other kind.
+   */
+  void wake() {
+    auto progressed{true};
+    while (progressed) {
+      progressed = false;
+      if (this->receivers_parked.load(std::memory_order_relaxed) != 0) {
+        progressed |= this->wake_receiver();
+      }
+      if (this->senders_parked.load(std::memory_order_relaxed) != 0) {
+        progressed |= this->wake_sender();
+      }
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+  }
+  bool wake_receiver() {
+    std::unique_lock lk{this->mtx};
+    auto waiter{this->receivers.head};
+    if (!waiter ||
+        !this->queue.try_pop(static_cast<RecvAwaiter &>(*waiter).value)) {
+      // Another receiver got the value first.
+      return false;
+    }
+    this->receivers.remove(*waiter);
+    waiter->listed = false;
+    this->receivers_parked.fetch_sub(1, std::memory_order_relaxed);
+    lk.unlock();
+    waiter->resume_on_loop();
+    return true;
+  }
+  bool wake_sender() {
+    std::unique_lock lk{this->mtx};
+    auto waiter{this->senders.head};
+    if (!waiter) {
+      return false;
+    }
+    auto &awaiter{static_cast<SendAwaiter &>(*waiter)};
+    if (!this->queue.try_push(awaiter.value)) {
+      return false;
+    }
+    awaiter.sent = true;
+    this->senders.remove(*waiter);
+    waiter->listed = false;
+    this->senders_parked.fetch_sub(1, std::memory_order_relaxed);
+    lk.unlock();
+    waiter->resume_on_loop();
+    return true;
+  }
+};
+} // namespace cocos
+#endif // COCOS_CHANNEL
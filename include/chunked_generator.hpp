@@ -0,0 +1,209 @@
+#ifndef COCOS_CHUNKED_GENERATOR
+#define COCOS_CHUNKED_GENERATOR
+#include "frame_allocator.hpp"
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace cocos {
+template <typename T, std::size_t N> class ChunkedGenerator;
+
+namespace detail {
+/**
+ * @brief Suspends the producer only once the chunk buffer is full.
+ */
+struct ChunkAwaiter {
+  bool full;
+  bool await_ready() const noexcept { return !this->full; }
+  void await_suspend(std::coroutine_handle<>) const noexcept {}
+  void await_resume() const noexcept {}
+};
+} // namespace detail
+
+template <typename T, std::size_t N>
+struct ChunkedGeneratorPromise : PooledPromise {
+  std::array<T, N> buffer;
+  std::size_t size{0};
+  /**
+   * @brief A yielded span which did not fit into the buffer, handed to the
+   * consumer as a chunk of its own.
+   */
+  std::span<const T> spill{};
+  std::exception_ptr error{};
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  std::suspend_always final_suspend() const noexcept { return {}; }
+  ChunkedGenerator<T, N> get_return_object() {
+    return ChunkedGenerator<T, N>{
+        std::coroutine_handle<ChunkedGeneratorPromise>::from_promise(*this)};
+  }
+  void unhandled_exception() { this->error = std::current_exception(); }
+  void return_void() const noexcept {}
+  /**
+   * @brief Append one element to the chunk.
+   */
+  template <typename U>
+    requires std::convertible_to<U, T>
+  detail::ChunkAwaiter yield_value(U &&val) {
+    this->buffer[this->size++] = std::forward<U>(val);
+    return {this->size == N};
+  }
+  /**
+   * @brief Append a batch of elements to the chunk if they fit, or hand the
+   * chunk and then the batch itself over to the consumer. A batch of at least
+   * `N` elements is never copied. The batch must stay valid until the
+   * producer is resumed.
+   */
+  detail::ChunkAwaiter yield_value(std::span<const T> values) {
+    if (values.size() < N && values.size() <= N - this->size) {
+      std::ranges::copy(values, this->buffer.begin() + this->size);
+      this->size += values.size();
+      return {this->size == N};
+    }
+    this->spill = values;
+    return {true};
+  }
+};
+
+/**
+ * @brief A lazily evaluating generator which hands its elements over in
+ * chunks of up to `N`, so that a resume is paid per chunk rather than per
+ * element, and the consumer iterates contiguous memory.
+ *
+ * The producer yields single elements, which are gathered into a buffer in
+ * the promise, or `std::span`s of them.
+ *
+ * @tparam T The type to be generated.
+ * @tparam N The capacity of the chunk buffer.
+ */
+template <typename T, std::size_t N = 256> class ChunkedGenerator {
+  static_assert(N > 0);
+  static_assert(std::is_default_constructible_v<T>);
+
+public:
+  using promise_type = ChunkedGeneratorPromise<T, N>;
+  using Self = ChunkedGenerator;
+
+private:
+  using THandle = std::coroutine_handle<promise_type>;
+
+public:
+  constexpr ChunkedGenerator() : co_handle{} {}
+  explicit ChunkedGenerator(THandle handle) : co_handle{handle} {}
+  ChunkedGenerator(const Self &) = delete;
+  ChunkedGenerator(Self &&other)
+      : co_handle{std::exchange(other.co_handle, {})},
+        chunk{std::exchange(other.chunk, {})} {}
+  auto operator=(const Self &) = delete;
+  Self &operator=(Self &&other) {
+    Self tmp{std::move(other)};
+    this->swap(tmp);
+    return *this;
+  }
+  ~ChunkedGenerator() {
+    if (this->co_handle) {
+      this->co_handle.destroy();
+    }
+  }
+  void swap(Self &other) {
+    std::swap(this->co_handle, other.co_handle);
+    std::swap(this->chunk, other.chunk);
+  }
+  bool has_coroutine() const noexcept { return this->co_handle; }
+
+  /**
+   * @brief Move the generator to its next chunk, which is never empty.
+   *
+   * @return true if there is a next chunk.
+   * @return false if the generator is exhausted.
+   * @throw The exception which escaped the producer, once the elements it
+   * yielded before were handed over.
+   */
+  bool move_next() {
+    auto &promise{this->co_handle.promise()};
+    if (!promise.spill.empty()) {
+      this->chunk = std::exchange(promise.spill, {});
+      return true;
+    }
+    this->chunk = {};
+    if (!this->co_handle.done()) {
+      promise.size = 0;
+      this->co_handle.resume();
+      if (promise.size != 0) {
+        // Any error is rethrown on the next call.
+        this->chunk = {promise.buffer.data(), promise.size};
+        return true;
+      }
+      this->chunk = std::exchange(promise.spill, {});
+    }
+    if (promise.error) {
+      std::rethrow_exception(std::exchange(promise.error, {}));
+    }
+    return !this->chunk.empty();
+  }
+  /**
+   * @brief The current chunk, valid until the next call to `move_next()`.
+   */
+  std::span<const T> current_chunk() const noexcept { return this->chunk; }
+  /**
+   * @brief Call `f` with each chunk.
+   */
+  template <typename F> void for_each_chunk(F f) {
+    while (this->move_next()) {
+      f(this->chunk);
+    }
+  }
+  template <typename F> void for_each(F f) {
+    while (this->move_next()) {
+      for (auto &val : this->chunk) {
+        f(val);
+      }
+    }
+  }
+  /**
+   * @brief fold the element sequence into one value, in a plain loop over
+   * each chunk.
+   */
+  template <typename R, typename F> R fold(R initial_val, F f) {
+    R ret{std::move(initial_val)};
+    while (this->move_next()) {
+      for (auto &val : this->chunk) {
+        ret = f(ret, val);
+      }
+    }
+    return ret;
+  }
+  /**
+   * @brief Mapping each element into another value using `f`, a chunk at a
+   * time.
+   */
+  template <typename F>
+  ChunkedGenerator<std::invoke_result_t<F, const T &>, N> map(F f) {
+    using U = std::invoke_result_t<F, const T &>;
+    return [](Self g, F f) -> ChunkedGenerator<U, N> {
+      std::array<U, N> out;
+      while (g.move_next()) {
+        // A spilled chunk may be larger than the buffer.
+        auto in{g.current_chunk()};
+        while (!in.empty()) {
+          auto n{std::min(in.size(), N)};
+          std::ranges::transform(in.first(n), out.begin(), f);
+          co_yield std::span<const U>{out.data(), n};
+          in = in.subspan(n);
+        }
+      }
+    }(std::move(*this), std::move(f));
+  }
+
+private:
+  THandle co_handle;
+  std::span<const T> chunk{};
+};
+} // namespace cocos
+#endif // COCOS_CHUNKED_GENERATOR
@@ -2,6 +2,7 @@
 #define COCOS_CONCEPTS
 #include <concepts>
 #include <coroutine>
+#include <stop_token>
 namespace cocos::concepts {
 
 namespace detail {
@@ -34,5 +35,13 @@ concept Awaitable = Awaiter<A> || requires(A a) {
 } || requires(A a) {
   { operator co_await(static_cast<A &&>(a)) } -> Awaiter;
 };
+/**
+ * @brief An awaiter which can be cancelled through the stop token of the
+ * awaiting task.
+ */
+template <typename A>
+concept Stoppable = requires(A a, std::stop_token token) {
+  a.set_stop_token(token);
+};
 } // namespace cocos::concepts
 #endif // COCOS_CONCEPTS
\ No newline at end of file
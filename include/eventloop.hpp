@@ -1,45 +1,339 @@
 #ifndef COCOS_EVENTLOOP
 #define COCOS_EVENTLOOP
+#include "reactor.hpp"
+#include "timer_wheel.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <condition_variable>
 #include <coroutine>
+#include <cstddef>
+#include <cstdint>
 #include <deque>
-#include <queue>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <thread>
+#include <utility>
+#include <vector>
 
 namespace cocos {
+namespace detail {
+/**
+ * @brief Hint to the CPU that the thread is spinning.
+ */
+inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+/**
+ * @brief Signals the end of the tasks added to a ThreadPoolLoop to the
+ * threads blocked in their wait().
+ */
+class TaskDoneSignal {
+  std::mutex mtx;
+  std::condition_variable cv;
+
+public:
+  /**
+   * @brief Set the flag of a task, under the lock, since the waiting thread
+   * may destroy the task as soon as it sees it.
+   */
+  void set(bool &done) {
+    std::lock_guard lk{this->mtx};
+    done = true;
+    this->cv.notify_all();
+  }
+  void wait(const bool &done) {
+    std::unique_lock lk{this->mtx};
+    this->cv.wait(lk, [&done] { return done; });
+  }
+};
+} // namespace detail
+
 using TimePoint = std::chrono::time_point<std::chrono::steady_clock>;
-using Duration = std::chrono::duration<long long>;
+using Duration = std::chrono::nanoseconds;
 
 template <typename T> class Task;
+class ThreadPoolLoop;
 
-struct Delay {
-  std::coroutine_handle<> sleeping_coro;
-  std::chrono::time_point<std::chrono::steady_clock> awake_time;
+/**
+ * @brief The priority levels of the ready queue. A coroutine is resumed
+ * before every coroutine of a lower level, save for the starvation guard.
+ */
+enum class Priority : std::uint8_t { low, normal, high, critical };
+inline constexpr std::size_t priority_levels{4};
+
+/**
+ * @brief A coroutine posted to a loop from any thread. It is intrusive, e.g.
+ * in the awaiter of `resume_on()` on the coroutine's frame, and must stay put
+ * until the coroutine is resumed.
+ */
+struct PostNode {
+  std::coroutine_handle<> coro{};
+  PostNode *next{nullptr};
   /**
-   * @brief To ajust the priority queue to be a min heap.
+   * @brief Allocated by `post(handle)`, and deleted once taken by the loop.
    */
-  bool operator<(const Delay &other) const {
-    return awake_time > other.awake_time;
-  }
+  bool owned{false};
 };
 
 class EventLoop {
+  friend class ThreadPoolLoop;
   using Coro = std::coroutine_handle<>;
-  std::deque<Coro> tasks;
-  std::priority_queue<Delay> delays;
+  struct ReadyTask {
+    Coro coro;
+    /**
+     * @brief The order of scheduling across every level.
+     */
+    std::uint64_t seq;
+  };
+  struct DeadlineTask {
+    Coro coro;
+    std::uint64_t seq;
+    TimePoint deadline;
+  };
+  /**
+   * @brief One level of the ready queue: the tasks with a deadline, in a heap
+   * with the earliest on top, ahead of the FIFO of the others.
+   */
+  struct ReadyLevel {
+    std::vector<DeadlineTask> deadlines;
+    std::deque<ReadyTask> fifo;
+  };
+  std::array<ReadyLevel, priority_levels> levels;
+  /**
+   * @brief Bit `i` is set when level `i` is not empty.
+   */
+  std::uint32_t ready_levels{0};
+  std::size_t ready_count{0};
+  std::uint64_t ready_seq{0};
+  /**
+   * @brief Consecutive picks from a level while a lower one was waiting.
+   */
+  std::size_t bypassed{0};
+  std::size_t starvation_limit{64};
+  TimerWheel delays;
+  /**
+   * @brief Nodes for the timers added by handle, which have no awaiter to live
+   * in. Fired nodes are recycled through the free list.
+   */
+  std::deque<TimerNode> timer_nodes;
+  std::vector<TimerNode *> free_timer_nodes;
+  /**
+   * @brief Created by the first wait for a file descriptor.
+   */
+  std::unique_ptr<Reactor> reactor;
+  /**
+   * @brief Timers and I/O waits cancelled from other threads, which are
+   * unlinked by the thread driving the loop.
+   */
+  std::mutex remote_mtx;
+  std::vector<TimerNode *> remote_timers;
+  std::vector<IoWaiter *> remote_waiters;
+  /**
+   * @brief Timers and I/O waits whose frames are being destroyed on other
+   * threads, which wait on `remote_cv` until they are unlinked.
+   */
+  std::vector<TimerNode *> detached_timers;
+  std::vector<IoWaiter *> detached_waiters;
+  std::condition_variable remote_cv;
+  /**
+   * @brief Whether a thread drives the loop, under `remote_mtx`. Otherwise
+   * other threads may unlink their nodes themselves.
+   */
+  bool driven{false};
+  /**
+   * @brief Nodes unlinked through `detach()` by another thread than the one
+   * driving the loop, for a ThreadPoolLoop to take off its count of pending
+   * work. It is touched under `remote_mtx`, or by the driving thread.
+   */
+  std::size_t detached{0};
+  std::atomic<bool> has_remote{false};
+  /**
+   * @brief Wakes the thread driving the loop after a remote cancellation, if
+   * it may be blocked elsewhere than in the loop, e.g. a pool worker.
+   */
+  void (*remote_wake)(void *){nullptr};
+  void *remote_wake_ctx{nullptr};
+  /**
+   * @brief Coroutines posted from any thread, newest first, taken all at once
+   * by the thread driving the loop.
+   */
+  std::atomic<PostNode *> posted{nullptr};
+  /**
+   * @brief Whether the thread driving the loop is about to block in the
+   * reactor, so that a post has to wake it through the eventfd.
+   */
+  std::atomic<bool> sleeping{false};
+  /**
+   * @brief The count of live WorkGuard objects.
+   */
+  std::atomic<std::size_t> work_guards{0};
+  /**
+   * @brief The count of threads between publishing something to the loop and
+   * being done waking it, which the loop must not be destroyed under: the
+   * thread driving it may take what was published, and finish, before the
+   * wakeup returns.
+   */
+  std::atomic<std::size_t> posters{0};
+  /**
+   * @brief The loop driven by the current thread, e.g. the per-worker loop of
+   * a ThreadPoolLoop, or the loop whose run() is on the stack.
+   */
+  static inline thread_local EventLoop *current{nullptr};
+  /**
+   * @brief How long before a timer is due the loop stops blocking and spins
+   * instead, zero to never spin.
+   */
+  Duration spin_threshold{0};
+#if COCOS_TRACING
+  LoopStats stats;
+#endif
 
 public:
+  /**
+   * @brief Keeps run() waiting for posts, e.g. of a coroutine which went off
+   * to another thread and will come back through `resume_on()`, while the
+   * loop has nothing else to do. The loop must outlive it.
+   */
+  class WorkGuard {
+    EventLoop *loop;
+
+  public:
+    explicit WorkGuard(EventLoop &loop) : loop{&loop} {
+      loop.work_guards.fetch_add(1, std::memory_order_relaxed);
+    }
+    WorkGuard(WorkGuard &&other) noexcept
+        : loop{std::exchange(other.loop, nullptr)} {}
+    WorkGuard(const WorkGuard &) = delete;
+    auto operator=(const WorkGuard &) = delete;
+    auto operator=(WorkGuard &&) = delete;
+    ~WorkGuard() { this->reset(); }
+    /**
+     * @brief Release the loop, waking it if it is blocked on another thread.
+     */
+    void reset() noexcept {
+      if (auto loop{std::exchange(this->loop, nullptr)}) {
+        if (loop->is_current()) {
+          loop->work_guards.fetch_sub(1, std::memory_order_release);
+          return;
+        }
+        loop->posters.fetch_add(1, std::memory_order_relaxed);
+        loop->work_guards.fetch_sub(1, std::memory_order_release);
+        loop->wake();
+        loop->posters.fetch_sub(1, std::memory_order_release);
+      }
+    }
+  };
+
+  /**
+   * @brief The timer granularity of a default constructed loop. A timer fires
+   * at most this late, on top of the wakeup latency of the kernel.
+   */
+  static constexpr std::chrono::microseconds default_timer_granularity{1};
+
+  EventLoop() : EventLoop{default_timer_granularity} {}
+  /**
+   * @brief Construct a loop whose timers have the given granularity.
+   */
+  explicit EventLoop(std::chrono::steady_clock::duration timer_granularity)
+      : delays{timer_granularity} {}
+  EventLoop(const EventLoop &) = delete;
+  auto operator=(const EventLoop &) = delete;
+  /**
+   * @brief Wait for the threads still waking the loop. Posts never taken are
+   * dropped, as the coroutines on the ready queue are.
+   */
+  ~EventLoop() {
+    this->wait_for_posters();
+    this->take_posted([](Coro) {});
+  }
   /**
    * @brief Add a coroutine to be resumed.
    * @param handle The coroutine handle representing the coroutine.
+   * @param priority The level of the ready queue, behind the coroutines
+   * already on it.
    */
-  void add_task(Coro handle) { tasks.push_back(handle); }
+  void add_task(Coro handle, Priority priority = Priority::normal) {
+    auto level{static_cast<std::size_t>(priority)};
+    this->levels[level].fifo.push_back({handle, this->ready_seq++});
+    this->mark_ready(level);
+  }
+  /**
+   * @brief Add a coroutine to be resumed ahead of the coroutines without a
+   * deadline on its level, earliest deadline first. Missing the deadline
+   * changes nothing but the order.
+   */
+  void add_task(Coro handle, Priority priority, TimePoint deadline) {
+    auto level{static_cast<std::size_t>(priority)};
+    auto &deadlines{this->levels[level].deadlines};
+    deadlines.push_back({handle, this->ready_seq++, deadline});
+    std::ranges::push_heap(deadlines, std::ranges::greater{},
+                           &DeadlineTask::deadline);
+    this->mark_ready(level);
+  }
   /**
    * @brief Add a task to be runned.
    * @param task The task to be added.
    */
-  template <typename T> void add_task(const Task<T> &task) {
-    tasks.push_back(task.co_hdl);
+  template <typename T>
+  void add_task(const Task<T> &task, Priority priority = Priority::normal) {
+    task.co_hdl.promise().scheduled = true;
+    this->add_task(task.co_hdl, priority);
+  }
+  template <typename T>
+  void add_task(const Task<T> &task, Priority priority, TimePoint deadline) {
+    task.co_hdl.promise().scheduled = true;
+    this->add_task(task.co_hdl, priority, deadline);
+  }
+  /**
+   * @brief Schedule a coroutine from any thread. It is pushed on a lock-free
+   * stack, and the thread driving the loop is woken only if it is blocked,
+   * so the loop's own path takes no lock. Posted coroutines are resumed in
+   * the order of their posts, at the normal priority.
+   *
+   * @param node The node to link, which must stay put until `node.coro` is
+   * resumed.
+   */
+  void post(PostNode &node) noexcept {
+    this->posters.fetch_add(1, std::memory_order_relaxed);
+    auto head{this->posted.load(std::memory_order_relaxed)};
+    do {
+      node.next = head;
+    } while (!this->posted.compare_exchange_weak(
+        head, &node, std::memory_order_release, std::memory_order_relaxed));
+    this->wake();
+    this->posters.fetch_sub(1, std::memory_order_release);
+  }
+  /**
+   * @brief The same as above, with a node allocated for the handle.
+   */
+  void post(Coro handle) {
+    this->post(*new PostNode{handle, nullptr, true});
+  }
+  template <typename T> void post(const Task<T> &task) {
+    task.co_hdl.promise().scheduled = true;
+    this->post(task.co_hdl);
+  }
+  /**
+   * @brief After `limit` consecutive coroutines taken from a level while a
+   * lower one was waiting, the coroutine scheduled the longest ago is resumed
+   * instead, whatever its level. Zero disables the guard, so that a level
+   * runs only while every higher one is empty.
+   */
+  void set_starvation_limit(std::size_t limit) noexcept {
+    this->starvation_limit = limit;
+  }
+  std::size_t get_starvation_limit() const noexcept {
+    return this->starvation_limit;
   }
   /**
    * @brief Delay a resuming of a coroutine, until the awake time.
@@ -50,39 +344,638 @@ public:
   void
   add_delayed_task(Coro handle,
                    std::chrono::time_point<std::chrono::steady_clock> delay) {
-    delays.push({handle, delay});
+    TimerNode *node{nullptr};
+    if (this->free_timer_nodes.empty()) {
+      node = &this->timer_nodes.emplace_back();
+      node->pooled = true;
+    } else {
+      node = this->free_timer_nodes.back();
+      this->free_timer_nodes.pop_back();
+    }
+    node->coro = handle;
+    node->awake_time = delay;
+    this->delays.insert(*node);
+  }
+  /**
+   * @brief Delay a resuming of `node.coro` until `node.awake_time`, using a
+   * node owned by the caller. Destroying or cancelling the node unregisters
+   * the timer.
+   *
+   * @param node The timer entry, which must outlive its registration.
+   */
+  void add_delayed_task(TimerNode &node) { this->delays.insert(node); }
+  /**
+   * @brief Unregister a timer added by `add_delayed_task(TimerNode &)`.
+   */
+  void cancel_delayed_task(TimerNode &node) noexcept {
+    this->delays.cancel(node);
+  }
+  /**
+   * @brief Whether the loop is driven by the calling thread, so that its
+   * timers and waiters may be touched directly.
+   */
+  bool is_current() const noexcept { return current == this; }
+  /**
+   * @brief Cancel a timer from any thread: its coroutine is rescheduled once
+   * the thread driving the loop gets to it, unless it has fired by then.
+   */
+  void cancel_remotely(TimerNode &node) {
+    this->push_remote(this->remote_timers, node);
+  }
+  /**
+   * @brief The same as above, for a wait on a file descriptor.
+   */
+  void cancel_remotely(IoWaiter &waiter) {
+    this->push_remote(this->remote_waiters, waiter);
+  }
+  /**
+   * @brief Drop a pending remote cancellation. It must be called before the
+   * node it refers to is destroyed.
+   */
+  void forget_remote(TimerNode &node) noexcept {
+    this->erase_remote(this->remote_timers, node);
+  }
+  void forget_remote(IoWaiter &waiter) noexcept {
+    this->erase_remote(this->remote_waiters, waiter);
+  }
+  /**
+   * @brief Unregister a timer without resuming its coroutine, from any
+   * thread, e.g. as its frame is destroyed. Off the thread driving the loop,
+   * it is handed over to that thread, and waited for; it is unlinked at once
+   * if no thread drives the loop.
+   */
+  void detach(TimerNode &node) noexcept {
+    this->detach_node(this->detached_timers, node);
+  }
+  /**
+   * @brief The same as above, for a wait on a file descriptor.
+   */
+  void detach(IoWaiter &waiter) noexcept {
+    this->detach_node(this->detached_waiters, waiter);
+  }
+  /**
+   * @brief Block for timers due within `threshold` only until that long before
+   * they are due, and busy-wait the rest of the way, trading a core for a
+   * wakeup free of the kernel's scheduling latency. Readiness of descriptors
+   * is not noticed while spinning. Zero, the default, disables spinning.
+   */
+  void set_spin_threshold(Duration threshold) noexcept {
+    this->spin_threshold = threshold;
+  }
+  Duration get_spin_threshold() const noexcept { return this->spin_threshold; }
+#if COCOS_TRACING
+  /**
+   * @brief What the loop counted so far. Read it from the thread driving the
+   * loop, or once it is not driven.
+   */
+  const LoopStats &get_stats() const noexcept { return this->stats; }
+  void reset_stats() noexcept { this->stats = {}; }
+#endif
+  /**
+   * @brief Get the reactor waiting for the file descriptors of this loop.
+   */
+  Reactor &get_reactor() {
+    if (!this->reactor) {
+      this->reactor = std::make_unique<Reactor>();
+    }
+    return *this->reactor;
   }
   /**
    * @brief Run the event loop.
    *
    */
   void run() {
-    while (!tasks.empty() || !delays.empty()) {
-      if (!tasks.empty()) {
-        auto task = tasks.front();
-        tasks.pop_front();
-        task.resume();
+    this->run_until([] { return false; });
+  }
+  /**
+   * @brief Run the event loop until `done()` holds, blocking in the reactor or
+   * on the next timer while nothing is ready. It must not be called from a
+   * coroutine running on the loop.
+   *
+   * @return bool Whether `done()` holds, rather than the loop running out of
+   * work.
+   */
+  template <typename F> bool run_until(F &&done) {
+    auto outer{std::exchange(current, this)};
+    auto was_driven{this->drive(true)};
+    auto push{[this](Coro coro) { this->add_task(coro); }};
+    while (!done() && (this->ready_count != 0 || !delays.empty() ||
+                       this->io_waiting() != 0 || this->has_posts())) {
+      this->take_posted(push);
+      // Another thread may be blocked until its nodes are unlinked.
+      this->apply_remote(push);
+      if (auto task{this->pop_ready()}) {
+        this->resume(task);
         continue;
-      } else if (!delays.empty()) {
-        auto delay = delays.top();
-        if (delay.awake_time > std::chrono::steady_clock::now()) {
-          std::this_thread::sleep_until(delay.awake_time);
-        }
-        delays.pop();
-        delay.sleeping_coro.resume();
+      } else {
+        this->wait_events();
         continue;
       }
     }
+    this->drive(was_driven);
+    current = outer;
+    return done();
   }
   /**
-   * @brief Get the singleton loop object.
+   * @brief Get the loop of the current thread. That is the worker's loop on a
+   * ThreadPoolLoop worker, and a loop of the thread's own anywhere else, so
+   * that threads driving their own loops share nothing but posts.
    *
-   * @return EventLoop& The global EventLoop object.
+   * @return EventLoop& The EventLoop object coroutines should schedule onto.
    */
   static EventLoop &get_loop() {
-    static EventLoop instance;
+    if (current) {
+      return *current;
+    }
+    static thread_local EventLoop instance;
     return instance;
   }
+
+private:
+  void mark_ready(std::size_t level) noexcept {
+    this->ready_levels |= std::uint32_t{1} << level;
+    ++this->ready_count;
+#if COCOS_TRACING
+    this->stats.ready_high_water =
+        std::max(this->stats.ready_high_water, this->ready_count);
+#endif
+  }
+  /**
+   * @brief Resume a coroutine, timed and traced while COCOS_TRACING is on.
+   */
+  void resume(Coro coro) {
+#if COCOS_TRACING
+    // The frame may be gone after the resume, but its address still names
+    // the coroutine in the trace.
+    auto address{coro.address()};
+    auto start{std::chrono::steady_clock::now()};
+    trace::event('B', "resume", address);
+    coro.resume();
+    trace::event('E', "resume", address);
+    ++this->stats.resumes;
+    this->stats.resume_time.record(std::chrono::steady_clock::now() - start);
+#else
+    coro.resume();
+#endif
+  }
+  /**
+   * @brief Take the next coroutine to resume, or a null handle if none is
+   * ready: the head of the highest non-empty level, found from the bitmap,
+   * unless the starvation guard is due.
+   */
+  Coro pop_ready() {
+    if (this->ready_count == 0) {
+      return {};
+    }
+    auto top{static_cast<std::size_t>(std::bit_width(this->ready_levels) - 1)};
+    auto lower{this->ready_levels & ((std::uint32_t{1} << top) - 1)};
+    if (lower == 0) {
+      this->bypassed = 0;
+    } else if (this->starvation_limit != 0 &&
+               ++this->bypassed >= this->starvation_limit) {
+      this->bypassed = 0;
+      return this->pop_oldest();
+    }
+    auto &level{this->levels[top]};
+    Coro coro;
+    if (!level.deadlines.empty()) {
+      coro = this->pop_deadline(level);
+    } else {
+      coro = level.fifo.front().coro;
+      level.fifo.pop_front();
+    }
+    this->taken_from(top);
+    return coro;
+  }
+  /**
+   * @brief Take the coroutine scheduled the longest ago, among the heads of
+   * the FIFOs and of the deadline heaps.
+   */
+  Coro pop_oldest() {
+    std::size_t best_level{0};
+    auto best_seq{std::numeric_limits<std::uint64_t>::max()};
+    auto from_deadlines{false};
+    for (auto mask{this->ready_levels}; mask != 0; mask &= mask - 1) {
+      auto i{static_cast<std::size_t>(std::countr_zero(mask))};
+      auto &level{this->levels[i]};
+      if (!level.fifo.empty() && level.fifo.front().seq < best_seq) {
+        best_level = i;
+        best_seq = level.fifo.front().seq;
+        from_deadlines = false;
+      }
+      if (!level.deadlines.empty() && level.deadlines.front().seq < best_seq) {
+        best_level = i;
+        best_seq = level.deadlines.front().seq;
+        from_deadlines = true;
+      }
+    }
+    auto &level{this->levels[best_level]};
+    Coro coro;
+    if (from_deadlines) {
+      coro = this->pop_deadline(level);
+    } else {
+      coro = level.fifo.front().coro;
+      level.fifo.pop_front();
+    }
+    this->taken_from(best_level);
+    return coro;
+  }
+  static Coro pop_deadline(ReadyLevel &level) {
+    std::ranges::pop_heap(level.deadlines, std::ranges::greater{},
+                          &DeadlineTask::deadline);
+    auto coro{level.deadlines.back().coro};
+    level.deadlines.pop_back();
+    return coro;
+  }
+  void taken_from(std::size_t i) noexcept {
+    --this->ready_count;
+    if (this->levels[i].fifo.empty() && this->levels[i].deadlines.empty()) {
+      this->ready_levels &= ~(std::uint32_t{1} << i);
+    }
+  }
+  std::size_t io_waiting() const noexcept {
+    return this->reactor ? this->reactor->size() : 0;
+  }
+  void wait_for_posters() const noexcept {
+    while (this->posters.load(std::memory_order_acquire) != 0) {
+      std::this_thread::yield();
+    }
+  }
+  bool has_posts() const noexcept {
+    return this->posted.load(std::memory_order_relaxed) != nullptr ||
+           this->work_guards.load(std::memory_order_acquire) != 0;
+  }
+  /**
+   * @brief Take every posted coroutine, and hand them to `on_ready` in the
+   * order of their posts.
+   */
+  template <typename F> std::size_t take_posted(F &&on_ready) {
+    if (this->posted.load(std::memory_order_relaxed) == nullptr) {
+      return 0;
+    }
+    auto node{this->posted.exchange(nullptr, std::memory_order_acquire)};
+    PostNode *fifo{nullptr};
+    while (node) {
+      auto next{node->next};
+      node->next = fifo;
+      fifo = node;
+      node = next;
+    }
+    std::size_t taken{0};
+    while (fifo) {
+      auto next{fifo->next};
+      auto coro{fifo->coro};
+      if (fifo->owned) {
+        delete fifo;
+      }
+      on_ready(coro);
+      fifo = next;
+      ++taken;
+    }
+#if COCOS_TRACING
+    this->stats.posts += taken;
+#endif
+    return taken;
+  }
+  /**
+   * @brief Wake the thread driving the loop, if it is blocked or about to be.
+   * Together with the store to `sleeping` and the loads which follow it in
+   * `wait_events()`, either the thread sees what was published before, or
+   * this sees it sleeping.
+   */
+  void wake() noexcept {
+    if (this->remote_wake) {
+      this->remote_wake(this->remote_wake_ctx);
+      return;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (this->sleeping.load(std::memory_order_seq_cst)) {
+      this->reactor->notify();
+    }
+  }
+  /**
+   * @brief Whether something was published from another thread since the
+   * loop last looked.
+   */
+  bool has_foreign_work() const noexcept {
+    return this->posted.load(std::memory_order_seq_cst) != nullptr ||
+           this->has_remote.load(std::memory_order_seq_cst);
+  }
+  /**
+   * @brief Block until the next timer is due or a waited descriptor is ready,
+   * in one epoll_wait on the reactor with the timer armed on its timerfd, and
+   * queue what was woken. The last `spin_threshold` before the timer is spun.
+   */
+  void wait_events() {
+    using Clock = std::chrono::steady_clock;
+    auto awake_time{this->delays.next_expiration()};
+    auto push{[this](Coro coro) { this->add_task(coro); }};
+    auto &reactor{this->get_reactor()};
+    this->sleeping.store(true, std::memory_order_seq_cst);
+    if (this->has_foreign_work() ||
+        (!awake_time && reactor.empty() &&
+         this->work_guards.load(std::memory_order_seq_cst) == 0)) {
+      // Do not block for what was posted, nor on nothing, once the last
+      // guard is gone.
+      awake_time = Clock::now();
+    }
+    if (awake_time && this->spin_threshold > Duration::zero()) {
+      auto woken{reactor.poll(*awake_time - this->spin_threshold, push)};
+      if (woken == 0) {
+        while (Clock::now() < *awake_time && !this->has_foreign_work()) {
+          detail::cpu_relax();
+        }
+      }
+    } else {
+      reactor.poll(awake_time, push);
+    }
+    this->sleeping.store(false, std::memory_order_relaxed);
+    this->expire_timers(Clock::now(), push);
+    this->apply_remote(push);
+  }
+  /**
+   * @brief Hand the coroutine of every timer due by `now` to `on_ready`.
+   */
+  template <typename F> std::size_t expire_timers(TimePoint now, F &&on_ready) {
+    return this->delays.expire(now, [&](TimerNode &node) {
+#if COCOS_TRACING
+      ++this->stats.timer_fires;
+      this->stats.timer_lateness.record(now - node.awake_time);
+#endif
+      if (node.pooled) {
+        this->free_timer_nodes.push_back(&node);
+      }
+      on_ready(node.coro);
+    });
+  }
+  template <typename Node>
+  void push_remote(std::vector<Node *> &nodes, Node &node) {
+    this->posters.fetch_add(1, std::memory_order_relaxed);
+    {
+      std::lock_guard lk{this->remote_mtx};
+      nodes.push_back(&node);
+      this->has_remote.store(true, std::memory_order_release);
+    }
+    this->wake();
+    this->posters.fetch_sub(1, std::memory_order_release);
+  }
+  /**
+   * @brief Set whether a thread drives the loop. Unlinks what was detached
+   * meanwhile, if any, before the loop is let go of.
+   *
+   * @return bool Whether it was driven before.
+   */
+  bool drive(bool driven) noexcept {
+    std::lock_guard lk{this->remote_mtx};
+    this->unlink_detached();
+    return std::exchange(this->driven, driven);
+  }
+  bool unlink(TimerNode &node) noexcept {
+    if (!node.linked()) {
+      return false;
+    }
+    this->delays.cancel(node);
+    return true;
+  }
+  bool unlink(IoWaiter &waiter) noexcept {
+    if (!waiter.linked()) {
+      return false;
+    }
+    this->reactor->remove(waiter);
+    return true;
+  }
+  template <typename Node>
+  void detach_node(std::vector<Node *> &nodes, Node &node) noexcept {
+    if (this->is_current()) {
+      this->unlink(node);
+      return;
+    }
+    std::unique_lock lk{this->remote_mtx};
+    if (!this->driven) {
+      this->detached += this->unlink(node) ? 1 : 0;
+      return;
+    }
+    nodes.push_back(&node);
+    this->has_remote.store(true, std::memory_order_release);
+    this->posters.fetch_add(1, std::memory_order_relaxed);
+    lk.unlock();
+    this->wake();
+    this->posters.fetch_sub(1, std::memory_order_release);
+    lk.lock();
+    auto unlinked{
+        [&] { return std::ranges::find(nodes, &node) == nodes.end(); }};
+    while (!this->remote_cv.wait_for(lk, std::chrono::milliseconds{1},
+                                     unlinked)) {
+      // The thread driving the loop may be waiting the same way for a node
+      // of the loop of this thread.
+      if (current && current != this) {
+        lk.unlock();
+        current->apply_detached();
+        lk.lock();
+      }
+    }
+  }
+  /**
+   * @brief Unlink the nodes detached from other threads, and let those go
+   * on. `remote_mtx` must be held.
+   */
+  void unlink_detached() noexcept {
+    if (this->detached_timers.empty() && this->detached_waiters.empty()) {
+      return;
+    }
+    for (auto node : this->detached_timers) {
+      this->detached += this->unlink(*node) ? 1 : 0;
+    }
+    for (auto waiter : this->detached_waiters) {
+      this->detached += this->unlink(*waiter) ? 1 : 0;
+    }
+    this->detached_timers.clear();
+    this->detached_waiters.clear();
+    this->remote_cv.notify_all();
+  }
+  void apply_detached() noexcept {
+    std::lock_guard lk{this->remote_mtx};
+    this->unlink_detached();
+  }
+  template <typename Node>
+  void erase_remote(std::vector<Node *> &nodes, Node &node) noexcept {
+    if (!this->has_remote.load(std::memory_order_acquire)) {
+      return;
+    }
+    std::lock_guard lk{this->remote_mtx};
+    std::erase(nodes, &node);
+  }
+  /**
+   * @brief Unlink the timers and waiters cancelled from other threads, and
+   * hand their coroutines to `on_ready`, as well as the ones detached.
+   */
+  template <typename F> std::size_t apply_remote(F &&on_ready) {
+    if (!this->has_remote.load(std::memory_order_acquire)) {
+      return 0;
+    }
+    std::size_t cancelled{0};
+    std::lock_guard lk{this->remote_mtx};
+    for (auto node : this->remote_timers) {
+      if (node->linked()) {
+        this->delays.cancel(*node);
+        on_ready(node->coro);
+        ++cancelled;
+      }
+    }
+    for (auto waiter : this->remote_waiters) {
+      if (waiter->linked()) {
+        this->reactor->remove(*waiter);
+        on_ready(waiter->coro);
+        ++cancelled;
+      }
+    }
+    this->remote_timers.clear();
+    this->remote_waiters.clear();
+    this->unlink_detached();
+    this->has_remote.store(false, std::memory_order_relaxed);
+    return cancelled;
+  }
+};
+
+/**
+ * @brief Puts the awaiting coroutine back on the ready queue of the loop of
+ * its thread, so that what is more urgent, or was scheduled before it on the
+ * same level, runs first.
+ */
+struct RescheduleAwaiter {
+  Priority priority;
+  std::optional<TimePoint> deadline;
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> hdl) const {
+    auto &loop{EventLoop::get_loop()};
+    if (this->deadline) {
+      loop.add_task(hdl, this->priority, *this->deadline);
+    } else {
+      loop.add_task(hdl, this->priority);
+    }
+  }
+  void await_resume() const noexcept {}
+};
+inline RescheduleAwaiter reschedule(Priority priority = Priority::normal) {
+  return {priority, std::nullopt};
+}
+inline RescheduleAwaiter reschedule(Priority priority, TimePoint deadline) {
+  return {priority, deadline};
+}
+
+/**
+ * @brief Schedule a coroutine on `loop` from any thread.
+ */
+inline void post(EventLoop &loop, std::coroutine_handle<> handle) {
+  loop.post(handle);
+}
+
+/**
+ * @brief Suspends the awaiting coroutine and posts it to a loop, so that it
+ * goes on on the thread driving that loop. The post lives in the awaiter.
+ */
+class ResumeOnAwaiter {
+  EventLoop *loop;
+  PostNode node{};
+
+public:
+  explicit ResumeOnAwaiter(EventLoop &loop) noexcept : loop{&loop} {}
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> hdl) noexcept {
+    this->node.coro = hdl;
+    this->loop->post(this->node);
+  }
+  void await_resume() const noexcept {}
+};
+/**
+ * @brief `co_await resume_on(loop)` moves the coroutine over to `loop`, e.g.
+ * back to its home loop after blocking work on another thread. The loop must
+ * be driven, e.g. kept in run() by a WorkGuard.
+ */
+inline ResumeOnAwaiter resume_on(EventLoop &loop) noexcept {
+  return ResumeOnAwaiter{loop};
+}
+
+namespace detail {
+/**
+ * @brief The part of an awaiter which parks a coroutine until some other
+ * coroutine or thread wakes it: it remembers the loop the coroutine was
+ * suspended on, holds it by a WorkGuard meanwhile, and posts the coroutine
+ * back to it, so that waking neither moves the coroutine to the waker's
+ * thread nor resumes it on the waker's stack.
+ */
+struct LoopWaiter {
+  EventLoop *loop{nullptr};
+  std::optional<EventLoop::WorkGuard> guard{};
+  PostNode node{};
+
+  void park(std::coroutine_handle<> hdl) {
+    this->loop = &EventLoop::get_loop();
+    this->guard.emplace(*this->loop);
+    this->node.coro = hdl;
+  }
+  /**
+   * @brief Release the loop, once resumed or if it did not suspend after all.
+   */
+  void unpark() noexcept { this->guard.reset(); }
+  /**
+   * @brief The waiter must not be touched afterwards, since the coroutine
+   * may be resumed and destroy it at once.
+   */
+  void resume_on_loop() noexcept { this->loop->post(this->node); }
+};
+/**
+ * @brief A LoopWaiter which queues in a WaiterList under the lock of what it
+ * waits for, so that a stop request or its destruction can take it out.
+ */
+struct ListedWaiter : LoopWaiter {
+  ListedWaiter *prev{nullptr};
+  ListedWaiter *next{nullptr};
+  /**
+   * @brief Whether it is in a list, under the lock.
+   */
+  bool listed{false};
+  /**
+   * @brief Whether it was unparked by a stop request, rather than woken.
+   */
+  bool cancelled{false};
+  /**
+   * @brief Whether the coroutine is suspended, for its own thread only.
+   */
+  bool suspended{false};
+};
+/**
+ * @brief An intrusive FIFO of parked coroutines. The nodes live in the
+ * awaiters on the coroutine frames.
+ */
+template <typename Node> struct WaiterList {
+  Node *head{nullptr};
+  Node *tail{nullptr};
+
+  bool empty() const noexcept { return this->head == nullptr; }
+  void push_back(Node &node) noexcept {
+    node.next = nullptr;
+    node.prev = this->tail;
+    if (this->tail) {
+      this->tail->next = &node;
+    } else {
+      this->head = &node;
+    }
+    this->tail = &node;
+  }
+  void remove(Node &node) noexcept {
+    (node.prev ? node.prev->next : this->head) = node.next;
+    (node.next ? node.next->prev : this->tail) = node.prev;
+    node.prev = node.next = nullptr;
+  }
+  Node *pop_front() noexcept {
+    auto node{this->head};
+    if (node) {
+      this->remove(*node);
+    }
+    return node;
+  }
 };
+} // namespace detail
 } // namespace cocos
-#endif // COCOS_EVENTLOOP
\ No newline at end of file
+#endif // COCOS_EVENTLOOP
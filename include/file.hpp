@@ -0,0 +1,434 @@
+#ifndef COCOS_FILE
+#define COCOS_FILE
+#include "async_generator.hpp"
+#include "eventloop.hpp"
+#include "offload.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fcntl.h>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace cocos {
+namespace detail {
+/**
+ * @brief Open a file for reading.
+ *
+ * @throw std::system_error If it cannot be opened.
+ */
+inline int open_file(const char *path) {
+  while (true) {
+    auto fd{::open(path, O_RDONLY | O_CLOEXEC)};
+    if (fd >= 0) {
+      return fd;
+    }
+    if (errno != EINTR) {
+      throw std::system_error{errno, std::system_category(), "open"};
+    }
+  }
+}
+/**
+ * @brief Closes the file descriptor it owns.
+ */
+struct FileDescriptor {
+  int fd;
+
+  explicit FileDescriptor(int fd) noexcept : fd{fd} {}
+  FileDescriptor(const FileDescriptor &) = delete;
+  auto operator=(const FileDescriptor &) = delete;
+  ~FileDescriptor() { ::close(this->fd); }
+};
+/**
+ * @brief The file and the buffers of chunks().
+ */
+struct ChunkSource {
+  FileDescriptor file;
+  std::vector<char> storage;
+
+  ChunkSource(int fd, std::size_t size) : file{fd}, storage(size) {}
+};
+/**
+ * @brief Read from `offset` until `buf` is full or the end of the file,
+ * blocking.
+ *
+ * @return std::size_t The count of bytes read, less than the size of `buf`
+ * only at the end of the file.
+ */
+inline std::size_t read_at(int fd, std::uint64_t offset,
+                           std::span<std::byte> buf) {
+  std::size_t total{0};
+  while (total < buf.size()) {
+    auto n{::pread(fd, buf.data() + total, buf.size() - total,
+                   static_cast<off_t>(offset + total))};
+    if (n > 0) {
+      total += static_cast<std::size_t>(n);
+    } else if (n == 0) {
+      break;
+    } else if (errno != EINTR) {
+      throw std::system_error{errno, std::system_category(), "pread"};
+    }
+  }
+  return total;
+}
+} // namespace detail
+
+namespace detail {
+/**
+ * @brief The state of a FileRead, apart from it on the heap, so that a read
+ * abandoned in flight is freed by the thread which completes it.
+ */
+struct FileReadJob : OffloadJob {
+  enum class State : unsigned char { idle, running, awaited, done, abandoned };
+
+  std::atomic<State> state{State::idle};
+  int fd{-1};
+  std::uint64_t offset{0};
+  std::span<std::byte> buf{};
+  /**
+   * @brief Whatever keeps `fd` and `buf` valid, released once the read is
+   * done.
+   */
+  std::shared_ptr<const void> owner{};
+  std::size_t count{0};
+  std::exception_ptr error{};
+  EventLoop *loop{nullptr};
+  /**
+   * @brief Held only while awaited, so that a started read nobody awaits yet
+   * does not keep the loop running.
+   */
+  std::optional<EventLoop::WorkGuard> guard{};
+  PostNode node{};
+
+  /**
+   * @brief End the read with the count of bytes read or its error, from any
+   * thread, once. Once done is published, the job must not be touched
+   * unless a coroutine awaits it, or it was abandoned.
+   */
+  void complete(std::size_t count, std::exception_ptr error) noexcept {
+    this->count = count;
+    this->error = std::move(error);
+    this->owner.reset();
+    switch (this->state.exchange(State::done, std::memory_order_acq_rel)) {
+    case State::awaited:
+      this->loop->post(this->node);
+      break;
+    case State::abandoned:
+      delete this;
+      break;
+    default:
+      break;
+    }
+  }
+  /**
+   * @brief Read with pread, on a thread of a BlockingPool.
+   */
+  static void execute(OffloadJob &job) noexcept {
+    auto &self{static_cast<FileReadJob &>(job)};
+    std::size_t count{0};
+    std::exception_ptr error{};
+    try {
+      count = read_at(self.fd, self.offset, self.buf);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    self.complete(count, std::move(error));
+  }
+};
+} // namespace detail
+
+/**
+ * @brief Where FileRead runs its reads: `submit(ctx, job)` reads from
+ * `job.offset` of `job.fd` until `job.buf` is full or the end of the file,
+ * and calls `job.complete()` once, from any thread. It may complete the job
+ * before returning.
+ *
+ * blocking() runs them with pread on a BlockingPool. A backend over io_uring
+ * would queue an IORING_OP_READ per job, queue the rest again after a short
+ * read, and complete the jobs from its completion queue.
+ */
+struct FileBackend {
+  void *ctx;
+  void (*submit)(void *ctx, detail::FileReadJob &job);
+
+  static FileBackend blocking(BlockingPool &pool) noexcept {
+    return {&pool, [](void *pool, detail::FileReadJob &job) {
+              job.run = &detail::FileReadJob::execute;
+              static_cast<BlockingPool *>(pool)->submit(job);
+            }};
+  }
+};
+
+/**
+ * @brief A read of a file at an offset, run by a FileBackend from start()
+ * on, and awaited later by `co_await read.wait()`, which produces the count
+ * of bytes read. Starting several reads before awaiting the first keeps them
+ * in flight together.
+ *
+ * It may be started again once awaited. Destroying it does not wait for a
+ * read in flight, even along with a coroutine suspended awaiting it: the read
+ * is abandoned, and releases the owner given to start() once done.
+ */
+class FileRead {
+  using State = detail::FileReadJob::State;
+
+  std::unique_ptr<detail::FileReadJob> job{};
+
+public:
+  FileRead() = default;
+  FileRead(const FileRead &) = delete;
+  auto operator=(const FileRead &) = delete;
+  ~FileRead() {
+    if (!this->job) {
+      return;
+    }
+    // Held by a coroutine awaiting the read, which is destroyed along with
+    // it. The backend never touches it.
+    this->job->guard.reset();
+    // Acquire, so that a read done meanwhile is done with the job before
+    // it is freed here.
+    auto current{this->job->state.load(std::memory_order_acquire)};
+    while (current == State::running || current == State::awaited) {
+      if (this->job->state.compare_exchange_weak(current, State::abandoned,
+                                                 std::memory_order_acq_rel,
+                                                 std::memory_order_acquire)) {
+        // Its completion frees it, without posting the coroutine.
+        static_cast<void>(this->job.release());
+        return;
+      }
+    }
+  }
+
+  /**
+   * @brief Read from `offset` of `fd` into `buf`, until it is full or the end
+   * of the file. Both must stay valid until the read is done, which `owner`
+   * may ensure if the FileRead may be destroyed before then.
+   *
+   * @throw std::logic_error If a read is in flight.
+   */
+  void start(int fd, std::uint64_t offset, std::span<std::byte> buf,
+             std::shared_ptr<const void> owner = {},
+             BlockingPool &pool = BlockingPool::get_default()) {
+    this->start(fd, offset, buf, std::move(owner),
+                FileBackend::blocking(pool));
+  }
+  /**
+   * @brief The same as above, run by `backend`.
+   */
+  void start(int fd, std::uint64_t offset, std::span<std::byte> buf,
+             std::shared_ptr<const void> owner, FileBackend backend) {
+    if (!this->job) {
+      this->job = std::make_unique<detail::FileReadJob>();
+    }
+    auto &job{*this->job};
+    auto current{job.state.load(std::memory_order_acquire)};
+    if (current == State::running || current == State::awaited) {
+      throw std::logic_error{"FileRead started while in flight"};
+    }
+    job.fd = fd;
+    job.offset = offset;
+    job.buf = buf;
+    job.owner = std::move(owner);
+    job.error = nullptr;
+    job.state.store(State::running, std::memory_order_relaxed);
+    try {
+      backend.submit(backend.ctx, job);
+    } catch (...) {
+      job.owner.reset();
+      job.state.store(State::idle, std::memory_order_relaxed);
+      throw;
+    }
+  }
+
+  /**
+   * @brief Awaits the read started last.
+   */
+  class Awaiter {
+    detail::FileReadJob *job;
+
+  public:
+    explicit Awaiter(detail::FileReadJob *job) noexcept : job{job} {}
+    bool await_ready() const noexcept {
+      return !this->job ||
+             this->job->state.load(std::memory_order_acquire) == State::done;
+    }
+    bool await_suspend(std::coroutine_handle<> hdl) {
+      auto &job{*this->job};
+      job.loop = &EventLoop::get_loop();
+      job.guard.emplace(*job.loop);
+      job.node.coro = hdl;
+      auto expected{State::running};
+      if (job.state.compare_exchange_strong(expected, State::awaited,
+                                            std::memory_order_acq_rel)) {
+        return true;
+      }
+      job.guard.reset();
+      return false;
+    }
+    /**
+     * @return std::size_t The count of bytes read, less than the size of the
+     * buffer only at the end of the file.
+     * @throw std::system_error If the read failed.
+     * @throw std::logic_error If it was never started.
+     */
+    std::size_t await_resume() {
+      if (!this->job ||
+          this->job->state.load(std::memory_order_relaxed) == State::idle) {
+        throw std::logic_error{"FileRead awaited before start"};
+      }
+      auto &job{*this->job};
+      job.guard.reset();
+      if (job.error) {
+        std::rethrow_exception(job.error);
+      }
+      return job.count;
+    }
+  };
+  /**
+   * @brief `co_await read.wait()` produces the count of bytes read.
+   */
+  Awaiter wait() noexcept { return Awaiter{this->job.get()}; }
+};
+
+/**
+ * @brief `co_await async_read(fd, offset, buf)` reads from `offset` of `fd`
+ * until `buf` is full or the end of the file, on the default BlockingPool,
+ * and produces the count of bytes read.
+ */
+inline auto async_read(int fd, std::uint64_t offset,
+                       std::span<std::byte> buf) {
+  return offload(
+      [fd, offset, buf] { return detail::read_at(fd, offset, buf); });
+}
+/**
+ * @brief The same as above, opening and closing the file at `path` on the
+ * pool as well.
+ *
+ * @throw std::system_error If the file cannot be opened or read.
+ */
+inline auto async_read_file(std::string path, std::uint64_t offset,
+                            std::span<std::byte> buf) {
+  return offload([path = std::move(path), offset, buf] {
+    detail::FileDescriptor file{detail::open_file(path.c_str())};
+    return detail::read_at(file.fd, offset, buf);
+  });
+}
+
+/**
+ * @brief Stream the file at `path` in chunks of `size` bytes, the last one
+ * possibly shorter, keeping `depth` reads in flight ahead of the consumer.
+ *
+ * The chunks are views of `depth` buffers which are reused, so memory stays
+ * constant whatever the size of the file: a chunk is valid until the next
+ * `co_await next()`, and the generator must not be prefetched. The file is
+ * opened on `pool`, and read by `backend`.
+ *
+ * @throw std::system_error If the file cannot be opened or read.
+ */
+inline AsyncGenerator<std::string_view>
+chunks(std::string path, std::size_t size, std::size_t depth,
+       FileBackend backend, BlockingPool &pool = BlockingPool::get_default()) {
+  size = std::max<std::size_t>(size, 1);
+  depth = std::max<std::size_t>(depth, 1);
+  auto fd{co_await offload(
+      pool, [&path] { return detail::open_file(path.c_str()); })};
+  // Shared with the reads in flight, which outlive the generator if it is
+  // destroyed early.
+  auto source{std::make_shared<detail::ChunkSource>(fd, size * depth)};
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  auto buffer{[&](std::size_t i) {
+    return std::as_writable_bytes(
+        std::span{source->storage}.subspan(i * size, size));
+  }};
+  auto reads{std::make_unique<FileRead[]>(depth)};
+  std::uint64_t next_offset{0};
+  for (std::size_t i{0}; i < depth; ++i, next_offset += size) {
+    reads[i].start(fd, next_offset, buffer(i), source, backend);
+  }
+  for (std::size_t i{0};; i = (i + 1) % depth, next_offset += size) {
+    auto n{co_await reads[i].wait()};
+    if (n != 0) {
+      co_yield std::string_view{source->storage.data() + i * size, n};
+    }
+    if (n < size) {
+      // The reads still in flight are past the end, and are abandoned.
+      break;
+    }
+    reads[i].start(fd, next_offset, buffer(i), source, backend);
+  }
+}
+/**
+ * @brief The same as above, opened and read on `pool`.
+ */
+inline AsyncGenerator<std::string_view>
+chunks(std::string path, std::size_t size = 1 << 20, std::size_t depth = 4,
+       BlockingPool &pool = BlockingPool::get_default()) {
+  return chunks(std::move(path), size, depth, FileBackend::blocking(pool),
+                pool);
+}
+
+namespace detail {
+/**
+ * @brief The lines of the chunks of `source`, as lines() streams them.
+ */
+inline AsyncGenerator<std::string_view>
+split_lines(AsyncGenerator<std::string_view> source) {
+  std::string carry;
+  while (auto chunk{co_await source.next()}) {
+    auto rest{*chunk};
+    for (auto end{rest.find('\n')}; end != std::string_view::npos;
+         end = rest.find('\n')) {
+      if (carry.empty()) {
+        co_yield rest.substr(0, end);
+      } else {
+        carry.append(rest.substr(0, end));
+        co_yield std::string_view{carry};
+        carry.clear();
+      }
+      rest.remove_prefix(end + 1);
+    }
+    carry.append(rest);
+  }
+  if (!carry.empty()) {
+    co_yield std::string_view{carry};
+  }
+}
+} // namespace detail
+
+/**
+ * @brief Stream the lines of the file at `path`, without their '\n', reading
+ * it as chunks() does.
+ *
+ * A line is a view of a chunk, or of a buffer which is reused for the lines
+ * spanning two chunks, and is valid until the next `co_await next()`.
+ *
+ * @throw std::system_error If the file cannot be opened or read.
+ */
+inline AsyncGenerator<std::string_view>
+lines(std::string path, std::size_t size = 1 << 20, std::size_t depth = 4,
+      BlockingPool &pool = BlockingPool::get_default()) {
+  return detail::split_lines(chunks(std::move(path), size, depth, pool));
+}
+/**
+ * @brief The same as above, read by `backend`.
+ */
+inline AsyncGenerator<std::string_view>
+lines(std::string path, std::size_t size, std::size_t depth,
+      FileBackend backend, BlockingPool &pool = BlockingPool::get_default()) {
+  return detail::split_lines(
+      chunks(std::move(path), size, depth, backend, pool));
+}
+} // namespace cocos
+#endif // COCOS_FILE
@@ -0,0 +1,174 @@
+#ifndef COCOS_FRAME_ALLOCATOR
+#define COCOS_FRAME_ALLOCATOR
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace cocos {
+namespace detail {
+/**
+ * @brief Every frame ends with the function which frees it, so that one
+ * `operator delete` serves both the pooled and the allocator-aware frames.
+ */
+using FrameDeleter = void (*)(void *frame, std::size_t size) noexcept;
+
+constexpr std::size_t align_up(std::size_t n, std::size_t alignment) noexcept {
+  return (n + alignment - 1) & ~(alignment - 1);
+}
+constexpr std::size_t deleter_offset(std::size_t size) noexcept {
+  return align_up(size, alignof(FrameDeleter));
+}
+inline FrameDeleter &deleter_of(void *frame, std::size_t size) noexcept {
+  return *std::launder(reinterpret_cast<FrameDeleter *>(
+      static_cast<std::byte *>(frame) + deleter_offset(size)));
+}
+
+/**
+ * @brief Thread-local free lists of coroutine frames, one per size class.
+ *
+ * A frame freed on another thread than the one which allocated it simply
+ * joins the free list of the freeing thread. Frames larger than the largest
+ * class, and the overflow of a full list, go to the global allocator.
+ */
+class FramePool {
+  static constexpr std::size_t granularity{64};
+  static constexpr std::size_t max_size{4096};
+  static constexpr std::size_t classes{max_size / granularity};
+  static constexpr std::size_t max_cached{256};
+
+  struct Block {
+    Block *next;
+  };
+  std::array<Block *, classes> heads{};
+  std::array<std::size_t, classes> counts{};
+  /**
+   * @brief Frames may outlive the pool of their thread, e.g. when they are
+   * owned by a static object. They are then freed directly.
+   */
+  static inline thread_local bool destroyed{false};
+
+  FramePool() = default;
+  ~FramePool() {
+    for (auto head : this->heads) {
+      while (head) {
+        ::operator delete(std::exchange(head, head->next));
+      }
+    }
+    destroyed = true;
+  }
+  static FramePool &local() {
+    thread_local FramePool pool;
+    return pool;
+  }
+
+public:
+  static void *allocate(std::size_t size) {
+#ifndef COCOS_DISABLE_FRAME_POOL
+    if (size <= max_size && !destroyed) {
+      auto &pool{FramePool::local()};
+      auto index{(size - 1) / granularity};
+      if (auto block{pool.heads[index]}) {
+        pool.heads[index] = block->next;
+        --pool.counts[index];
+        return block;
+      }
+      return ::operator new((index + 1) * granularity);
+    }
+#endif
+    return ::operator new(size);
+  }
+  static void deallocate(void *p, std::size_t size) noexcept {
+#ifndef COCOS_DISABLE_FRAME_POOL
+    if (size <= max_size && !destroyed) {
+      auto &pool{FramePool::local()};
+      auto index{(size - 1) / granularity};
+      if (pool.counts[index] < max_cached) {
+        pool.heads[index] = ::new (p) Block{pool.heads[index]};
+        ++pool.counts[index];
+        return;
+      }
+    }
+#endif
+    ::operator delete(p);
+  }
+};
+
+/**
+ * @brief A frame allocated by a user supplied allocator, which is stored
+ * right after the frame deleter so that the frame can free itself.
+ */
+template <typename Alloc> struct AllocatorFrame {
+  struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Chunk {
+    std::byte bytes[__STDCPP_DEFAULT_NEW_ALIGNMENT__];
+  };
+  using ChunkAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<Chunk>;
+  using Traits = std::allocator_traits<ChunkAlloc>;
+
+  static constexpr std::size_t alloc_offset(std::size_t size) noexcept {
+    return align_up(deleter_offset(size) + sizeof(FrameDeleter),
+                    alignof(ChunkAlloc));
+  }
+  static constexpr std::size_t chunks(std::size_t size) noexcept {
+    return (alloc_offset(size) + sizeof(ChunkAlloc) + sizeof(Chunk) - 1) /
+           sizeof(Chunk);
+  }
+  static ChunkAlloc &alloc_of(void *frame, std::size_t size) noexcept {
+    return *std::launder(reinterpret_cast<ChunkAlloc *>(
+        static_cast<std::byte *>(frame) + alloc_offset(size)));
+  }
+  static void *allocate(std::size_t size, const Alloc &alloc) {
+    ChunkAlloc chunk_alloc{alloc};
+    void *frame{Traits::allocate(chunk_alloc, chunks(size))};
+    ::new (static_cast<std::byte *>(frame) + alloc_offset(size))
+        ChunkAlloc{std::move(chunk_alloc)};
+    deleter_of(frame, size) = &AllocatorFrame::deallocate;
+    return frame;
+  }
+  static void deallocate(void *frame, std::size_t size) noexcept {
+    auto &stored{alloc_of(frame, size)};
+    ChunkAlloc chunk_alloc{std::move(stored)};
+    stored.~ChunkAlloc();
+    Traits::deallocate(chunk_alloc, static_cast<Chunk *>(frame), chunks(size));
+  }
+};
+
+inline void pooled_frame_deallocate(void *frame, std::size_t size) noexcept {
+  FramePool::deallocate(frame, deleter_offset(size) + sizeof(FrameDeleter));
+}
+} // namespace detail
+
+/**
+ * @brief A base of promise types, whose coroutine frames are recycled through
+ * thread-local free lists instead of the global `operator new`.
+ *
+ * A coroutine may instead supply its own allocator, e.g. an arena, by taking
+ * `std::allocator_arg_t, const Alloc &` as its first parameters (after the
+ * implicit object parameter for member functions).
+ */
+struct PooledPromise {
+  static void *operator new(std::size_t size) {
+    auto frame{detail::FramePool::allocate(detail::deleter_offset(size) +
+                                           sizeof(detail::FrameDeleter))};
+    detail::deleter_of(frame, size) = &detail::pooled_frame_deallocate;
+    return frame;
+  }
+  template <typename Alloc, typename... Args>
+  static void *operator new(std::size_t size, std::allocator_arg_t,
+                            const Alloc &alloc, const Args &...) {
+    return detail::AllocatorFrame<Alloc>::allocate(size, alloc);
+  }
+  template <typename This, typename Alloc, typename... Args>
+  static void *operator new(std::size_t size, const This &,
+                            std::allocator_arg_t, const Alloc &alloc,
+                            const Args &...) {
+    return detail::AllocatorFrame<Alloc>::allocate(size, alloc);
+  }
+  static void operator delete(void *frame, std::size_t size) noexcept {
+    detail::deleter_of(frame, size)(frame, size);
+  }
+};
+} // namespace cocos
+#endif // COCOS_FRAME_ALLOCATOR
@@ -1,53 +1,194 @@
 #ifndef COCOS_GENERATOR
 #define COCOS_GENERATOR
+#include "frame_allocator.hpp"
+#include <concepts>
 #include <coroutine>
+#include <cstddef>
 #include <exception>
+#include <iterator>
+#include <memory>
 #include <ranges>
+#include <type_traits>
 #include <utility>
-#include <variant>
 #include <optional>
 namespace cocos {
 template <typename T> class Generator;
 
-template <typename T> struct GeneratorPromise {
-  std::variant<std::monostate, T, std::exception_ptr> result;
+/**
+ * @brief `co_yield elements_of(gen)` yields every element of `gen` from the
+ * generator it is called in.
+ */
+template <typename T> struct ElementsOf {
+  Generator<T> generator;
+};
+template <typename T> ElementsOf<T> elements_of(Generator<T> generator) {
+  return {std::move(generator)};
+}
+
+/**
+ * @brief The promise stores the address of the current element rather than
+ * the element itself. A yielded temporary or xvalue lives in the coroutine
+ * frame until the producer is resumed, and so does a copy of a yielded
+ * lvalue, so `current_value()` refers to it without moving it.
+ *
+ * For `Generator<U &>` and `Generator<const U &>`, yielded lvalues are not
+ * copied either; the consumer refers to the producer's own object.
+ */
+template <typename T> struct GeneratorPromise : PooledPromise {
+  using THandle = std::coroutine_handle<GeneratorPromise>;
+  using Value = std::remove_reference_t<T>;
+  using Yielded = std::conditional_t<std::is_reference_v<T>, T, Value &&>;
+
+  Value *value{nullptr};
+  std::exception_ptr error{};
+  /**
+   * @brief Generators delegated to by `elements_of` form a stack. Each one
+   * knows the one below it, and the bottom one, which is consumed, knows the
+   * top one, which is resumed directly by `move_next()`, whatever the depth.
+   */
+  GeneratorPromise *root{this};
+  THandle parent{};
+  THandle leaf{};
+
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    /**
+     * @brief A delegated generator hands over to the one below it.
+     */
+    std::coroutine_handle<> await_suspend(THandle hdl) noexcept {
+      auto &promise{hdl.promise()};
+      if (promise.parent) {
+        promise.root->leaf = promise.parent;
+        return promise.parent;
+      }
+      return std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+  struct ElementsOfAwaiter {
+    Generator<T> nested;
+    bool await_ready() const noexcept {
+      return !this->nested.co_handle || this->nested.co_handle.done();
+    }
+    /**
+     * @brief Push the nested generator, which may have been consumed partly
+     * and be delegating itself, onto the stack, and resume its top.
+     */
+    std::coroutine_handle<> await_suspend(THandle hdl) noexcept {
+      auto &promise{hdl.promise()};
+      auto &nested{this->nested.co_handle.promise()};
+      for (auto h{nested.leaf}; h; h = h.promise().parent) {
+        h.promise().root = promise.root;
+      }
+      nested.parent = hdl;
+      promise.root->leaf = nested.leaf;
+      return nested.leaf;
+    }
+    /**
+     * @throw What the nested generator threw.
+     */
+    void await_resume() {
+      if (this->nested.co_handle && this->nested.co_handle.promise().error) {
+        std::rethrow_exception(this->nested.co_handle.promise().error);
+      }
+    }
+  };
+  /**
+   * @brief Holds a copy of a yielded lvalue, or of a value converted to `T`,
+   * across the suspension.
+   */
+  struct CopyAwaiter {
+    Value copy;
+    GeneratorPromise *promise;
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<>) noexcept {
+      this->promise->value = std::addressof(this->copy);
+    }
+    void await_resume() const noexcept {}
+  };
 
   constexpr std::suspend_always initial_suspend() const noexcept { return {}; }
-  constexpr std::suspend_always final_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
   Generator<T> get_return_object() {
-    return Generator{
-        std::coroutine_handle<GeneratorPromise>::from_promise(*this)};
-  }
-  void unhandled_exception() {
-    this->result.template emplace<std::exception_ptr>(std::current_exception());
+    this->leaf = THandle::from_promise(*this);
+    return Generator{this->leaf};
   }
-  template <typename U> std::suspend_always yield_value(U &&val) {
-    this->result.template emplace<T>(std::forward<U>(val));
+  void unhandled_exception() { this->error = std::current_exception(); }
+  void return_void() const noexcept {}
+  /**
+   * @brief A yielded reference, or a yielded rvalue of a value type, is
+   * referred to where it lives.
+   */
+  std::suspend_always yield_value(Yielded val) noexcept {
+    this->value = std::addressof(val);
     return {};
   }
+  CopyAwaiter yield_value(const Value &val)
+    requires(!std::is_reference_v<T>)
+  {
+    return {val, this};
+  }
+  template <typename U>
+    requires(!std::is_reference_v<T> &&
+             !std::same_as<std::remove_cvref_t<U>, Value> &&
+             std::convertible_to<U, T>)
+  CopyAwaiter yield_value(U &&val) {
+    return {static_cast<T>(std::forward<U>(val)), this};
+  }
+  ElementsOfAwaiter yield_value(ElementsOf<T> elements) noexcept {
+    return {std::move(elements.generator)};
+  }
   T &get_or_throw() {
-    auto p{std::get_if<T>(&(this->result))};
-    if (p) {
-      return *p;
-    } else {
-      std::rethrow_exception(std::get<2>(this->result));
+    if (this->error) {
+      std::rethrow_exception(this->error);
     }
+    return *this->value;
   }
 };
 /**
- * @brief A lazily evaluating generator.
+ * @brief A lazily evaluating generator. It is also an input view, iterated
+ * once by range-for, `std::ranges` algorithms and `std::views`.
  *
  * @tparam T The type to be generated.
  */
-template <typename T> class Generator {
+template <typename T> class Generator : public std::ranges::view_base {
 public:
   using promise_type = GeneratorPromise<T>;
   using Self = Generator;
 
 private:
   using THandle = std::coroutine_handle<promise_type>;
+  friend promise_type;
 
 public:
+  /**
+   * @brief An input iterator over the elements, which are produced as it is
+   * incremented. It ends when the generator is exhausted.
+   */
+  class Iterator {
+  public:
+    using value_type = std::remove_cvref_t<T>;
+    using difference_type = std::ptrdiff_t;
+
+    Iterator() = default;
+    explicit Iterator(THandle handle) : co_handle{handle} {}
+    T &operator*() const noexcept {
+      return *this->co_handle.promise().leaf.promise().value;
+    }
+    Iterator &operator++() {
+      Generator::advance(this->co_handle);
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+    friend bool operator==(const Iterator &iter,
+                           std::default_sentinel_t) noexcept {
+      return iter.co_handle.done();
+    }
+
+  private:
+    THandle co_handle{};
+  };
+
   /**
    * @brief construct a Generator with no underlying coroutine.
    *
@@ -74,9 +215,8 @@ public:
    */
   auto operator=(const Self &) = delete;
   Self &operator=(Self &&other) {
-    Self tmp{};
-    tmp.swap(other);
-    this->swap(other);
+    Self tmp{std::move(other)};
+    this->swap(tmp);
     return *this;
   }
   /**
@@ -99,19 +239,49 @@ public:
    * @return false if there is not a naxt value.
    */
   bool move_next() {
-    this->co_handle.resume();
+    this->co_handle.promise().leaf.resume();
     return !(this->co_handle.done());
   }
-  T &current_value() { return this->co_handle.promise().get_or_throw(); }
+  T &current_value() {
+    return this->co_handle.promise().leaf.promise().get_or_throw();
+  }
+  /**
+   * @brief Once `move_next()` returned false, throw what the generator threw,
+   * if anything, which `move_next()` does not.
+   */
+  void rethrow_if_failed() {
+    if (auto &error{this->co_handle.promise().error}) [[unlikely]] {
+      std::rethrow_exception(std::exchange(error, {}));
+    }
+  }
+  /**
+   * @brief Start the generator, and iterate its elements. It may be called
+   * only once.
+   *
+   * @throw What the generator threw, when it is reached.
+   */
+  Iterator begin() {
+    Generator::advance(this->co_handle);
+    return Iterator{this->co_handle};
+  }
+  std::default_sentinel_t end() const noexcept { return {}; }
   template <typename Iter>
   static Generator<T> from_iterator(Iter begin, Iter end) {
     for (auto iter{begin}; iter != end; ++iter) {
       co_yield *iter;
     }
   }
-  template <typename R> static Generator<T> from_range(R &&range) {
-    auto r{std::forward<R>(range)};
-    return from_iterator(std::ranges::begin(r), std::ranges::end(r));
+  /**
+   * @brief Generate the elements of `range`. An lvalue is referred to, and
+   * must outlive the generator; an rvalue is moved into the coroutine frame.
+   */
+  template <std::ranges::input_range R>
+  static Generator<T> from_range(R &&range) {
+    return [](R r) -> Generator<T> {
+      for (auto &&elem : r) {
+        co_yield std::forward<decltype(elem)>(elem);
+      }
+    }(std::forward<R>(range));
   }
   /**
    * @brief Mapping each element into another value using the function f.
@@ -140,7 +310,8 @@ public:
     return [](Generator<T> g, F f) -> Generator<T> {
       while (g.move_next()) {
         if (f(g.current_value())) {
-          co_yield g.current_value();
+          // Passed on where it lives in `g`, rather than copied.
+          co_yield std::forward<T>(g.current_value());
         }
       }
     }(std::move(*this), std::move(f));
@@ -189,7 +360,7 @@ public:
           break;
         }
         n -= 1;
-        co_yield prom.current_value();
+        co_yield std::forward<T>(prom.current_value());
       }
     }(std::move(*this), n);
   }
@@ -206,7 +377,7 @@ public:
     return [](Generator<T> prom, F f) -> Generator<T> {
       while (prom.move_next()) {
         if (f(prom.current_value())) {
-          co_yield prom.current_value();
+          co_yield std::forward<T>(prom.current_value());
         } else {
           break;
         }
@@ -256,6 +427,13 @@ public:
 
 private:
   std::coroutine_handle<promise_type> co_handle;
+
+  static void advance(THandle handle) {
+    handle.promise().leaf.resume();
+    if (handle.done() && handle.promise().error) {
+      std::rethrow_exception(std::exchange(handle.promise().error, {}));
+    }
+  }
 };
 } // namespace cocos
 #endif // COCOS_GENERATOR
\ No newline at end of file
@@ -0,0 +1,134 @@
+#ifndef COCOS_IO
+#define COCOS_IO
+#include "cancellation.hpp"
+#include "eventloop.hpp"
+#include "reactor.hpp"
+#include "task.hpp"
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stop_token>
+#include <sys/epoll.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace cocos {
+/**
+ * @brief Wait until a file descriptor is ready for the given epoll events.
+ */
+struct IoAwaiter {
+  int fd;
+  std::uint32_t events;
+  IoWaiter waiter{};
+  EventLoop *loop{nullptr};
+  std::stop_token token{};
+  detail::StopCallbackSlot<detail::IoCanceller> on_stop{};
+  /**
+   * @brief Whether the coroutine is suspended, so that the wait may still be
+   * registered when it is destroyed.
+   */
+  bool suspended{false};
+
+  IoAwaiter(int fd, std::uint32_t events) : fd{fd}, events{events} {}
+  IoAwaiter(const IoAwaiter &) = default;
+  /**
+   * @brief The waiter may still be referred to by a cancellation from another
+   * thread, which must not outlive it. If the waiting coroutine is destroyed,
+   * possibly on another thread than the one driving the loop, the wait is
+   * detached through the loop.
+   */
+  ~IoAwaiter() {
+    this->on_stop.reset();
+    if (this->loop) {
+      this->loop->forget_remote(this->waiter);
+    }
+    if (this->suspended) {
+      this->loop->detach(this->waiter);
+    }
+  }
+  /**
+   * @brief Set by the awaiting task, so that a stop request removes the wait
+   * from the reactor at once.
+   */
+  void set_stop_token(std::stop_token stop_token) noexcept {
+    this->token = std::move(stop_token);
+  }
+  /**
+   * @brief Readiness is only known by asking the reactor.
+   */
+  bool await_ready() const noexcept { return this->token.stop_requested(); }
+  /**
+   * @brief Register the waiting coroutine with the reactor of the loop.
+   *
+   * @param hdl the waiting coroutine.
+   */
+  void await_suspend(std::coroutine_handle<> hdl) {
+    this->loop = &EventLoop::get_loop();
+    this->waiter.coro = hdl;
+    this->waiter.events = this->events;
+    this->loop->get_reactor().add(this->fd, this->waiter);
+    this->suspended = true;
+    if (this->token.stop_possible()) {
+      this->on_stop.emplace(this->token, {this->loop, &this->waiter});
+    }
+  }
+  /**
+   * @return std::uint32_t The epoll events which woke the coroutine.
+   * @throw Cancelled if a stop has been requested.
+   */
+  std::uint32_t await_resume() {
+    this->on_stop.reset();
+    this->suspended = false;
+    if (this->token.stop_requested()) {
+      throw Cancelled{};
+    }
+    return this->waiter.revents;
+  }
+};
+
+inline IoAwaiter readable(int fd) { return {fd, EPOLLIN}; }
+inline IoAwaiter writable(int fd) { return {fd, EPOLLOUT}; }
+
+/**
+ * @brief Read once from a non-blocking file descriptor, waiting until it is
+ * readable if no data is available. The wait is cancelled by the stop token
+ * of the awaiting task.
+ *
+ * @return std::size_t The count of bytes read, 0 at the end of file.
+ */
+inline Task<std::size_t> read(int fd, std::span<std::byte> buf) {
+  while (true) {
+    auto n{::read(fd, buf.data(), buf.size())};
+    if (n >= 0) {
+      co_return static_cast<std::size_t>(n);
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      co_await readable(fd);
+    } else if (errno != EINTR) {
+      throw std::system_error{errno, std::system_category(), "read"};
+    }
+  }
+}
+/**
+ * @brief Write once to a non-blocking file descriptor, waiting until it is
+ * writable if its buffer is full. The wait is cancelled as in read().
+ *
+ * @return std::size_t The count of bytes written.
+ */
+inline Task<std::size_t> write(int fd, std::span<const std::byte> buf) {
+  while (true) {
+    auto n{::write(fd, buf.data(), buf.size())};
+    if (n >= 0) {
+      co_return static_cast<std::size_t>(n);
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      co_await writable(fd);
+    } else if (errno != EINTR) {
+      throw std::system_error{errno, std::system_category(), "write"};
+    }
+  }
+}
+} // namespace cocos
+#endif // COCOS_IO
@@ -0,0 +1,243 @@
+#ifndef COCOS_OFFLOAD
+#define COCOS_OFFLOAD
+#include "eventloop.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace cocos {
+namespace detail {
+/**
+ * @brief A call queued on a BlockingPool. It is intrusive, living in the
+ * awaiter on the offloading coroutine's frame.
+ */
+struct OffloadJob {
+  OffloadJob *next{nullptr};
+  void (*run)(OffloadJob &) noexcept {nullptr};
+};
+} // namespace detail
+
+/**
+ * @brief An elastic pool of threads for blocking calls, e.g. `stat`, a
+ * compression or a lookup through a local stub, which would stall an
+ * EventLoop.
+ *
+ * A thread is started when a job is queued and no idle thread is left to
+ * take it, up to `max_threads`; beyond that, jobs wait in FIFO order. A
+ * thread idle for `idle_timeout` leaves. Queuing a job wakes a thread only
+ * if there is an idle one which is not being woken already.
+ */
+class BlockingPool {
+  std::mutex mtx;
+  std::condition_variable cv;
+  /**
+   * @brief Notified when the last thread leaves.
+   */
+  std::condition_variable exit_cv;
+  detail::OffloadJob *head{nullptr};
+  detail::OffloadJob *tail{nullptr};
+  std::size_t queued{0};
+  std::size_t threads{0};
+  std::size_t idle{0};
+  std::size_t max_threads;
+  std::chrono::steady_clock::duration idle_timeout;
+  bool stopping{false};
+
+public:
+  static constexpr std::size_t default_max_threads{64};
+  static constexpr std::chrono::seconds default_idle_timeout{10};
+
+  explicit BlockingPool(
+      std::size_t max_threads = default_max_threads,
+      std::chrono::steady_clock::duration idle_timeout = default_idle_timeout)
+      : max_threads{std::max<std::size_t>(max_threads, 1)},
+        idle_timeout{idle_timeout} {}
+  BlockingPool(const BlockingPool &) = delete;
+  auto operator=(const BlockingPool &) = delete;
+  /**
+   * @brief Run the jobs still queued, and wait for every thread to leave.
+   */
+  ~BlockingPool() {
+    std::unique_lock lk{this->mtx};
+    this->stopping = true;
+    this->cv.notify_all();
+    this->exit_cv.wait(lk, [this] { return this->threads == 0; });
+  }
+
+  /**
+   * @brief Queue a job, to be run on one of the threads of the pool.
+   */
+  void submit(detail::OffloadJob &job) {
+    std::lock_guard lk{this->mtx};
+    job.next = nullptr;
+    if (this->tail) {
+      this->tail->next = &job;
+    } else {
+      this->head = &job;
+    }
+    this->tail = &job;
+    ++this->queued;
+    if (this->queued <= this->idle) {
+      this->cv.notify_one();
+    } else if (this->threads < this->max_threads) {
+      try {
+        std::thread{[this] { this->work(); }}.detach();
+      } catch (...) {
+        if (this->threads == 0) {
+          // Nobody would ever take it.
+          this->head = this->tail = nullptr;
+          this->queued = 0;
+          throw;
+        }
+        return;
+      }
+      ++this->threads;
+    }
+  }
+  std::size_t thread_count() {
+    std::lock_guard lk{this->mtx};
+    return this->threads;
+  }
+  /**
+   * @brief The pool used by `offload(f)`.
+   */
+  static BlockingPool &get_default() {
+    static BlockingPool pool;
+    return pool;
+  }
+
+private:
+  void work() {
+    std::unique_lock lk{this->mtx};
+    while (true) {
+      if (!this->head) {
+        if (this->stopping) {
+          break;
+        }
+        ++this->idle;
+        auto woken{this->cv.wait_for(lk, this->idle_timeout, [this] {
+          return this->head || this->stopping;
+        })};
+        --this->idle;
+        if (!woken) {
+          break;
+        }
+        continue;
+      }
+      auto job{this->head};
+      this->head = job->next;
+      if (!this->head) {
+        this->tail = nullptr;
+      }
+      --this->queued;
+      lk.unlock();
+      job->run(*job);
+      lk.lock();
+    }
+    // Notified under the lock, which the pool may not outlive.
+    --this->threads;
+    this->exit_cv.notify_all();
+  }
+};
+
+/**
+ * @brief Runs a call on a BlockingPool, then posts the awaiting coroutine
+ * back to the loop it was suspended on, with the result or the exception of
+ * the call. Completions come back through the loop's post stack, so a loop
+ * takes every completion published since its last wakeup at once.
+ *
+ * The loop is held by a WorkGuard while the call is in flight, and must
+ * outlive the call.
+ */
+template <typename F> class OffloadAwaiter : detail::OffloadJob {
+  using Result = std::invoke_result_t<F &>;
+  using Value = std::conditional_t<
+      std::is_reference_v<Result>,
+      std::reference_wrapper<std::remove_reference_t<Result>>, Result>;
+  using Stored =
+      std::conditional_t<std::is_void_v<Result>, std::monostate, Value>;
+
+  F f;
+  BlockingPool *pool;
+  EventLoop *loop{nullptr};
+  std::optional<EventLoop::WorkGuard> guard{};
+  PostNode node{};
+  std::variant<std::monostate, Stored, std::exception_ptr> result{};
+
+public:
+  OffloadAwaiter(BlockingPool &pool, F f) : f{std::move(f)}, pool{&pool} {}
+  OffloadAwaiter(const OffloadAwaiter &) = delete;
+  OffloadAwaiter(OffloadAwaiter &&other)
+      : f{std::move(other.f)}, pool{other.pool} {}
+  auto operator=(const OffloadAwaiter &) = delete;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> hdl) {
+    this->loop = &EventLoop::get_loop();
+    this->guard.emplace(*this->loop);
+    this->node.coro = hdl;
+    this->run = &OffloadAwaiter::execute;
+    this->pool->submit(*this);
+  }
+  /**
+   * @throw What the call threw.
+   */
+  Result await_resume() {
+    this->guard.reset();
+    if (auto error{std::get_if<std::exception_ptr>(&this->result)}) {
+      std::rethrow_exception(*error);
+    }
+    if constexpr (std::is_reference_v<Result>) {
+      return std::get<Stored>(this->result).get();
+    } else if constexpr (!std::is_void_v<Result>) {
+      return std::move(std::get<Stored>(this->result));
+    }
+  }
+
+private:
+  /**
+   * @brief Run on a thread of the pool. The awaiter must not be touched once
+   * posted, since the coroutine may be resumed and destroy it at once.
+   */
+  static void execute(detail::OffloadJob &job) noexcept {
+    auto &self{static_cast<OffloadAwaiter &>(job)};
+    try {
+      if constexpr (std::is_void_v<Result>) {
+        std::invoke(self.f);
+      } else {
+        self.result.template emplace<Stored>(std::invoke(self.f));
+      }
+    } catch (...) {
+      self.result.template emplace<std::exception_ptr>(
+          std::current_exception());
+    }
+    self.loop->post(self.node);
+  }
+};
+
+/**
+ * @brief `co_await offload(f)` runs `f()` on the default BlockingPool, and
+ * resumes the coroutine on its loop with what `f()` returned or threw, so
+ * that blocking calls do not stall the loop meanwhile.
+ */
+template <typename F> OffloadAwaiter<F> offload(F f) {
+  return {BlockingPool::get_default(), std::move(f)};
+}
+/**
+ * @brief The same as above, on a given pool.
+ */
+template <typename F> OffloadAwaiter<F> offload(BlockingPool &pool, F f) {
+  return {pool, std::move(f)};
+}
+} // namespace cocos
+#endif // COCOS_OFFLOAD
@@ -0,0 +1,248 @@
+#ifndef COCOS_PAR_MAP
+#define COCOS_PAR_MAP
+#include "frame_allocator.hpp"
+#include "generator.hpp"
+#include "threadpool.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cocos {
+/**
+ * @brief Whether par_map yields its results in the order of the source, or
+ * as soon as they are computed.
+ */
+enum class ParMapOrder { ordered, unordered };
+
+namespace detail {
+/**
+ * @brief A window of elements being mapped on a pool, shared by the consuming
+ * generator and the jobs.
+ *
+ * The consumer fills a slot and submits it; a job maps it and marks it done.
+ * In order, the element with sequence number `s` uses slot `s % window`,
+ * since the elements in flight are always consecutive.
+ */
+template <typename T, typename R> class ParMapState {
+  struct Slot {
+    std::optional<T> input;
+    std::optional<R> output;
+    std::exception_ptr error;
+    bool done{false};
+  };
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::vector<Slot> slots;
+  ParMapOrder order;
+  /**
+   * @brief Unordered: slots not in flight, and done slots in completion order.
+   */
+  std::vector<std::size_t> free_slots;
+  std::deque<std::size_t> completed;
+  std::size_t submitted{0};
+  std::size_t yielded{0};
+  /**
+   * @brief Jobs not finished yet, which refer to the state.
+   */
+  std::size_t running{0};
+
+public:
+  ParMapState(std::size_t window, ParMapOrder order)
+      : slots(window), order{order} {
+    for (std::size_t i{window}; i > 0; --i) {
+      this->free_slots.push_back(i - 1);
+    }
+  }
+  ParMapState(const ParMapState &) = delete;
+  auto operator=(const ParMapState &) = delete;
+  /**
+   * @brief Wait for the jobs in flight, e.g. when the consumer stops early.
+   */
+  ~ParMapState() {
+    std::unique_lock lk{this->mtx};
+    this->cv.wait(lk, [this] { return this->running == 0; });
+  }
+
+  bool has_room() const noexcept {
+    return this->submitted - this->yielded < this->slots.size();
+  }
+  bool in_flight() const noexcept { return this->submitted != this->yielded; }
+  /**
+   * @return std::size_t The slot to hand to a job.
+   */
+  std::size_t submit(T &&input) {
+    std::size_t slot{0};
+    if (this->order == ParMapOrder::ordered) {
+      slot = this->submitted % this->slots.size();
+    } else {
+      slot = this->free_slots.back();
+      this->free_slots.pop_back();
+    }
+    this->slots[slot].input.emplace(std::move(input));
+    ++this->submitted;
+    std::lock_guard lk{this->mtx};
+    ++this->running;
+    return slot;
+  }
+  /**
+   * @brief Map the input of a slot on the calling worker.
+   */
+  template <typename F> void run(std::size_t slot, F &f) {
+    auto &s{this->slots[slot]};
+    try {
+      s.output.emplace(std::invoke(f, std::move(*s.input)));
+    } catch (...) {
+      s.error = std::current_exception();
+    }
+    s.input.reset();
+    // Notified under the lock, which the state may not outlive.
+    std::lock_guard lk{this->mtx};
+    s.done = true;
+    if (this->order == ParMapOrder::unordered) {
+      this->completed.push_back(slot);
+    }
+    --this->running;
+    this->cv.notify_all();
+  }
+  /**
+   * @brief Block until the next result is done.
+   *
+   * @return std::size_t Its slot.
+   */
+  std::size_t wait_next() {
+    std::unique_lock lk{this->mtx};
+    if (this->order == ParMapOrder::ordered) {
+      auto &s{this->slots[this->yielded % this->slots.size()]};
+      this->cv.wait(lk, [&] { return s.done; });
+      return this->yielded % this->slots.size();
+    }
+    this->cv.wait(lk, [this] { return !this->completed.empty(); });
+    auto slot{this->completed.front()};
+    this->completed.pop_front();
+    return slot;
+  }
+  /**
+   * @brief Free a done slot, and move its result out or throw its exception.
+   */
+  R take(std::size_t slot) {
+    auto &s{this->slots[slot]};
+    s.done = false;
+    ++this->yielded;
+    if (this->order == ParMapOrder::unordered) {
+      this->free_slots.push_back(slot);
+    }
+    if (s.error) {
+      std::rethrow_exception(std::exchange(s.error, {}));
+    }
+    R result{std::move(*s.output)};
+    s.output.reset();
+    return result;
+  }
+};
+
+/**
+ * @brief Maps one element on a pool worker. Its frame destroys itself.
+ */
+struct ParMapJob {
+  struct promise_type : PooledPromise {
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    ParMapJob get_return_object() {
+      return ParMapJob{
+          std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    void unhandled_exception() noexcept { std::terminate(); }
+    void return_void() const noexcept {}
+  };
+  std::coroutine_handle<promise_type> co_hdl;
+};
+
+template <typename T, typename R, typename F>
+ParMapJob make_par_map_job(ParMapState<T, R> &state, F &f, std::size_t slot) {
+  state.run(slot, f);
+  co_return;
+}
+
+template <typename T, typename F, typename R>
+Generator<R> par_map(Generator<T> source, F f, ThreadPoolLoop *pool,
+                     [[maybe_unused]]
+                     std::unique_ptr<ThreadPoolLoop> owned_pool,
+                     std::size_t window, ParMapOrder order) {
+  // Destroyed before the parameters, waiting for the jobs in flight before an
+  // owned pool is stopped.
+  ParMapState<T, R> state{window, order};
+  auto more{true};
+  while (true) {
+    while (more && state.has_room()) {
+      more = source.move_next();
+      if (more) {
+        auto slot{state.submit(std::move(source.current_value()))};
+        pool->add_task(make_par_map_job(state, f, slot).co_hdl);
+      }
+    }
+    if (!state.in_flight()) {
+      break;
+    }
+    co_yield state.take(state.wait_next());
+  }
+  // After the results of the elements the source yielded before it threw.
+  source.rethrow_if_failed();
+}
+} // namespace detail
+
+/**
+ * @brief Map each element of `source` using `f` on the workers of `pool`,
+ * with at most `window` elements pulled from the source and not yielded yet.
+ * The window is the only buffering, so a slow consumer holds the source back.
+ *
+ * `f` is called concurrently from the workers. The generator blocks the
+ * consuming thread while it waits for a result, and must not be consumed on a
+ * worker of the pool. Destroying it waits for the elements in flight.
+ * What `f` throws for an element is thrown in its place; what the source
+ * throws, after the results of the elements before.
+ *
+ * @param pool A started pool, e.g. shared by several pipelines.
+ * @param order Whether to yield in the order of the source, holding back
+ * results which are done early, or as soon as they are done.
+ * @throw std::logic_error if the pool is not running.
+ */
+template <typename T, typename F, typename R = std::invoke_result_t<F &, T>>
+Generator<R> par_map(Generator<T> source, F f, ThreadPoolLoop &pool,
+                     std::size_t window,
+                     ParMapOrder order = ParMapOrder::ordered) {
+  if (!pool.running()) {
+    throw std::logic_error{"par_map on a pool which is not running"};
+  }
+  return detail::par_map<T, F, R>(std::move(source), std::move(f), &pool,
+                                  nullptr, std::max<std::size_t>(window, 1),
+                                  order);
+}
+/**
+ * @brief The same as above, on a pool of `n_workers` threads of its own,
+ * which lives as long as the generator.
+ */
+template <typename T, typename F, typename R = std::invoke_result_t<F &, T>>
+Generator<R> par_map(Generator<T> source, F f, std::size_t n_workers,
+                     std::size_t window,
+                     ParMapOrder order = ParMapOrder::ordered) {
+  auto pool{std::make_unique<ThreadPoolLoop>(n_workers)};
+  pool->start();
+  auto raw{pool.get()};
+  return detail::par_map<T, F, R>(std::move(source), std::move(f), raw,
+                                  std::move(pool),
+                                  std::max<std::size_t>(window, 1), order);
+}
+} // namespace cocos
+#endif // COCOS_PAR_MAP
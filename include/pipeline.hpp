@@ -0,0 +1,247 @@
+#ifndef COCOS_PIPELINE
+#define COCOS_PIPELINE
+#include "generator.hpp"
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Fused generator pipelines. `gen | pipe::filter(p) | pipe::map(f)` composes
+ * the adaptors at compile time into a single loop over the source generator,
+ * so each element costs one resume of the source, instead of one coroutine
+ * frame and one resume per adaptor as with `gen.filter(p).map(f)`.
+ *
+ * Every stage is called with an element and the rest of the pipeline, and
+ * returns whether the source should be pulled again.
+ */
+namespace cocos {
+namespace pipe {
+/**
+ * @brief Mapping each element into another value using `f`.
+ */
+template <typename F> struct Map {
+  F f;
+  template <typename In> using Output = std::invoke_result_t<F &, In &>;
+
+  bool done() const noexcept { return false; }
+  template <typename V, typename Next> bool operator()(V &&v, Next &&next) {
+    return next(std::invoke(this->f, v));
+  }
+};
+/**
+ * @brief Passing on the elements where `f(elem)` is `true`.
+ */
+template <typename F> struct Filter {
+  F f;
+  template <typename In> using Output = In;
+
+  bool done() const noexcept { return false; }
+  template <typename V, typename Next> bool operator()(V &&v, Next &&next) {
+    if (std::invoke(this->f, v)) {
+      return next(std::forward<V>(v));
+    }
+    return true;
+  }
+};
+/**
+ * @brief Passing on the first `n` elements. The source is not pulled again
+ * after the last of them.
+ */
+struct Take {
+  std::size_t n;
+  template <typename In> using Output = In;
+
+  bool done() const noexcept { return this->n == 0; }
+  template <typename V, typename Next> bool operator()(V &&v, Next &&next) {
+    --this->n;
+    return next(std::forward<V>(v)) && this->n != 0;
+  }
+};
+/**
+ * @brief Passing on the elements until `f(elem)` is `false`.
+ */
+template <typename F> struct TakeWhile {
+  F f;
+  template <typename In> using Output = In;
+
+  bool done() const noexcept { return false; }
+  template <typename V, typename Next> bool operator()(V &&v, Next &&next) {
+    return std::invoke(this->f, v) && next(std::forward<V>(v));
+  }
+};
+/**
+ * @brief Passing on each intermediate result of folding with `f`.
+ */
+template <typename R, typename F> struct Scan {
+  R val;
+  F f;
+  template <typename In> using Output = R;
+
+  bool done() const noexcept { return false; }
+  template <typename V, typename Next> bool operator()(V &&v, Next &&next) {
+    this->val = std::invoke(this->f, this->val, v);
+    return next(this->val);
+  }
+};
+
+template <typename F> Map<F> map(F f) { return {std::move(f)}; }
+template <typename F> Filter<F> filter(F f) { return {std::move(f)}; }
+inline Take take(std::size_t n) { return {n}; }
+template <typename F> TakeWhile<F> take_while(F f) { return {std::move(f)}; }
+template <typename R, typename F> Scan<R, F> scan(R initial, F f) {
+  return {std::move(initial), std::move(f)};
+}
+} // namespace pipe
+
+namespace detail {
+template <typename S> struct IsPipeStage : std::false_type {};
+template <typename F> struct IsPipeStage<pipe::Map<F>> : std::true_type {};
+template <typename F> struct IsPipeStage<pipe::Filter<F>> : std::true_type {};
+template <> struct IsPipeStage<pipe::Take> : std::true_type {};
+template <typename F>
+struct IsPipeStage<pipe::TakeWhile<F>> : std::true_type {};
+template <typename R, typename F>
+struct IsPipeStage<pipe::Scan<R, F>> : std::true_type {};
+
+template <typename In, typename... Stages> struct PipeOutput {
+  using type = In;
+};
+template <typename In, typename Stage, typename... Rest>
+struct PipeOutput<In, Stage, Rest...> {
+  using type = typename PipeOutput<
+      std::remove_cvref_t<typename Stage::template Output<In>>,
+      Rest...>::type;
+};
+} // namespace detail
+
+template <typename S>
+concept PipeStage = detail::IsPipeStage<std::remove_cvref_t<S>>::value;
+
+/**
+ * @brief A generator with a chain of stages fused onto it. It is consumed
+ * like a Generator, by a terminal operation or by turning it back into one.
+ *
+ * @tparam T The type generated by the source.
+ * @tparam Stages The stages, in the order the elements pass them.
+ */
+template <typename T, typename... Stages> class Pipeline {
+public:
+  /**
+   * @brief The type of the elements coming out of the last stage.
+   */
+  using value_type = typename detail::PipeOutput<T, Stages...>::type;
+
+  Pipeline(Generator<T> source, std::tuple<Stages...> stages)
+      : source{std::move(source)}, stages{std::move(stages)} {}
+
+  template <PipeStage S>
+  Pipeline<T, Stages..., std::remove_cvref_t<S>> then(S &&stage) && {
+    return {std::move(this->source),
+            std::tuple_cat(std::move(this->stages),
+                           std::tuple{std::forward<S>(stage)})};
+  }
+  /**
+   * @brief Drive the source, passing each element through the stages into
+   * `sink`, until either is exhausted.
+   *
+   * @param sink Called with each resulting element, returning whether to go
+   * on.
+   * @throw What the source threw, when it is reached.
+   */
+  template <typename Sink> void run(Sink &&sink) {
+    if (this->exhausted()) {
+      return;
+    }
+    while (this->source.move_next()) {
+      if (!this->push<0>(this->source.current_value(), sink)) {
+        return;
+      }
+    }
+    this->source.rethrow_if_failed();
+  }
+  template <typename F> void for_each(F f) {
+    this->run([&](auto &&v) {
+      f(v);
+      return true;
+    });
+  }
+  template <typename R, typename F> R fold(R initial_val, F f) {
+    R ret{std::move(initial_val)};
+    this->run([&](auto &&v) {
+      ret = f(ret, v);
+      return true;
+    });
+    return ret;
+  }
+  template <typename F> std::optional<value_type> reduce(F f) {
+    std::optional<value_type> val;
+    this->run([&](auto &&v) {
+      if (val) {
+        *val = f(*val, std::forward<decltype(v)>(v));
+      } else {
+        val.emplace(std::forward<decltype(v)>(v));
+      }
+      return true;
+    });
+    return val;
+  }
+  /**
+   * @brief Turn the pipeline back into a Generator, with one coroutine frame
+   * for all the stages. What the source throws is thrown by the Generator.
+   */
+  Generator<value_type> generator() && {
+    return [](Pipeline p) -> Generator<value_type> {
+      // Every stage passes on at most one element per element of the source.
+      std::optional<value_type> out;
+      auto more{!p.exhausted()};
+      while (more && p.source.move_next()) {
+        more = p.template push<0>(p.source.current_value(), [&](auto &&v) {
+          out.emplace(std::forward<decltype(v)>(v));
+          return true;
+        });
+        if (out) {
+          co_yield std::move(*out);
+          out.reset();
+        }
+      }
+      if (more) {
+        p.source.rethrow_if_failed();
+      }
+    }(std::move(*this));
+  }
+
+private:
+  Generator<T> source;
+  std::tuple<Stages...> stages;
+
+  bool exhausted() const {
+    return std::apply([](auto &...s) { return (s.done() || ...); },
+                      this->stages);
+  }
+  template <std::size_t I, typename V, typename Sink>
+  bool push(V &&v, Sink &&sink) {
+    if constexpr (I == sizeof...(Stages)) {
+      return sink(std::forward<V>(v));
+    } else {
+      return std::get<I>(this->stages)(std::forward<V>(v), [&](auto &&w) {
+        return this->push<I + 1>(std::forward<decltype(w)>(w), sink);
+      });
+    }
+  }
+};
+
+template <typename T, PipeStage S>
+Pipeline<T, std::remove_cvref_t<S>> operator|(Generator<T> &&source,
+                                              S &&stage) {
+  return {std::move(source), std::tuple{std::forward<S>(stage)}};
+}
+template <typename T, typename... Stages, PipeStage S>
+Pipeline<T, Stages..., std::remove_cvref_t<S>>
+operator|(Pipeline<T, Stages...> &&pipeline, S &&stage) {
+  return std::move(pipeline).then(std::forward<S>(stage));
+}
+} // namespace cocos
+#endif // COCOS_PIPELINE
@@ -0,0 +1,357 @@
+#ifndef COCOS_REACTOR
+#define COCOS_REACTOR
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <optional>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <system_error>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+
+namespace cocos {
+class Reactor;
+/**
+ * @brief An intrusive wait for a file descriptor to become ready. It lives in
+ * the awaiter on the waiting coroutine's frame.
+ *
+ * A registered waiter removes itself when destroyed, which must happen on
+ * the thread driving its reactor; a waiter which may be destroyed elsewhere
+ * is detached through `EventLoop::detach()` first.
+ */
+struct IoWaiter {
+  std::coroutine_handle<> coro{};
+  /**
+   * @brief The awaited epoll events, e.g. EPOLLIN or EPOLLOUT.
+   */
+  std::uint32_t events{0};
+  /**
+   * @brief The epoll events reported when the waiter was woken.
+   */
+  std::uint32_t revents{0};
+
+  IoWaiter() = default;
+  IoWaiter(const IoWaiter &other)
+      : coro{other.coro}, events{other.events}, revents{other.revents} {}
+  IoWaiter &operator=(const IoWaiter &other) {
+    this->coro = other.coro;
+    this->events = other.events;
+    this->revents = other.revents;
+    return *this;
+  }
+  inline ~IoWaiter();
+  bool linked() const noexcept { return this->reactor != nullptr; }
+
+private:
+  friend class Reactor;
+  IoWaiter *prev{nullptr};
+  IoWaiter *next{nullptr};
+  Reactor *reactor{nullptr};
+  void *state{nullptr};
+};
+
+/**
+ * @brief An epoll based reactor. Every file descriptor is registered with
+ * EPOLLONESHOT, and is re-armed only while someone waits on it, so a ready
+ * descriptor nobody waits for does not wake the loop again.
+ *
+ * It is driven by the EventLoop, which blocks in `poll()` with the deadline of
+ * its next timer, so timers and I/O share one syscall per iteration. The
+ * deadline is armed on a timerfd in the epoll set rather than passed as the
+ * epoll timeout, which the kernel may defer by the thread's timer slack. An
+ * eventfd in the epoll set lets other threads interrupt the wait.
+ */
+class Reactor {
+  struct FdState {
+    int fd;
+    IoWaiter *head{nullptr};
+    /**
+     * @brief The events the descriptor is currently armed for.
+     */
+    std::uint32_t armed{0};
+    bool registered{false};
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  int epfd;
+  /**
+   * @brief A CLOCK_MONOTONIC timerfd, registered with a null `data.ptr`.
+   */
+  int tfd;
+  /**
+   * @brief An eventfd written by `notify()`, registered with its own address
+   * as `data.ptr`.
+   */
+  int efd;
+  /**
+   * @brief The deadline the timerfd is armed for, if any.
+   */
+  std::optional<Clock::time_point> timer_deadline;
+  std::unordered_map<int, std::unique_ptr<FdState>> fds;
+  std::size_t count{0};
+  std::array<epoll_event, 128> ready{};
+
+public:
+  Reactor() : epfd{::epoll_create1(EPOLL_CLOEXEC)}, tfd{-1}, efd{-1} {
+    if (this->epfd < 0) {
+      throw std::system_error{errno, std::system_category(), "epoll_create1"};
+    }
+    // steady_clock is CLOCK_MONOTONIC on Linux.
+    this->tfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    if (this->tfd < 0 ||
+        ::epoll_ctl(this->epfd, EPOLL_CTL_ADD, this->tfd, &ev) < 0) {
+      this->close_on_error("timerfd");
+    }
+    this->efd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ev.data.ptr = &this->efd;
+    if (this->efd < 0 ||
+        ::epoll_ctl(this->epfd, EPOLL_CTL_ADD, this->efd, &ev) < 0) {
+      this->close_on_error("eventfd");
+    }
+  }
+  Reactor(const Reactor &) = delete;
+  auto operator=(const Reactor &) = delete;
+  ~Reactor() {
+    for (auto &[fd, state] : this->fds) {
+      while (auto w{state->head}) {
+        state->head = w->next;
+        w->prev = w->next = nullptr;
+        w->reactor = nullptr;
+        w->state = nullptr;
+      }
+    }
+    ::close(this->efd);
+    ::close(this->tfd);
+    ::close(this->epfd);
+  }
+
+  /**
+   * @brief The count of pending waiters.
+   */
+  std::size_t size() const noexcept { return this->count; }
+  bool empty() const noexcept { return this->count == 0; }
+  int native_handle() const noexcept { return this->epfd; }
+  /**
+   * @brief Interrupt the current or the next wait in `poll()`. It may be
+   * called from any thread.
+   */
+  void notify() noexcept {
+    std::uint64_t one{1};
+    [[maybe_unused]] auto r{::write(this->efd, &one, sizeof(one))};
+  }
+  /**
+   * @brief Wait for `waiter.events` on `fd`.
+   */
+  void add(int fd, IoWaiter &waiter) {
+    auto &slot{this->fds[fd]};
+    if (!slot) {
+      slot = std::make_unique<FdState>(fd);
+    }
+    auto &state{*slot};
+    waiter.revents = 0;
+    waiter.prev = nullptr;
+    waiter.next = state.head;
+    if (state.head) {
+      state.head->prev = &waiter;
+    }
+    state.head = &waiter;
+    waiter.reactor = this;
+    waiter.state = &state;
+    ++this->count;
+    try {
+      this->arm(state);
+    } catch (...) {
+      this->remove(waiter);
+      throw;
+    }
+  }
+  /**
+   * @brief Stop waiting, if the waiter is still pending.
+   */
+  void remove(IoWaiter &waiter) noexcept {
+    if (waiter.reactor != this) {
+      return;
+    }
+    auto &state{*static_cast<FdState *>(waiter.state)};
+    this->unlink(state, waiter);
+    --this->count;
+  }
+  /**
+   * @brief Wait until a waited descriptor is ready or the deadline is reached,
+   * and hand the coroutine of every woken waiter to `on_ready`.
+   *
+   * @param deadline When to give up waiting, or std::nullopt to wait forever.
+   * @param on_ready Called with the `std::coroutine_handle<>` of each waiter.
+   * @return std::size_t The count of woken waiters.
+   */
+  template <typename F>
+  std::size_t
+  poll(std::optional<std::chrono::steady_clock::time_point> deadline,
+       F &&on_ready) {
+    auto n{this->wait(deadline)};
+    std::size_t woken{0};
+    for (int i{0}; i < n; ++i) {
+      if (!this->ready[i].data.ptr) {
+        this->drain_timer();
+        continue;
+      }
+      if (this->ready[i].data.ptr == &this->efd) {
+        this->drain_notifications();
+        continue;
+      }
+      auto &state{*static_cast<FdState *>(this->ready[i].data.ptr)};
+      auto revents{this->ready[i].events};
+      state.armed = 0;
+      auto w{state.head};
+      while (w) {
+        auto next{w->next};
+        if (revents & (w->events | EPOLLERR | EPOLLHUP)) {
+          w->revents = revents;
+          this->unlink(state, *w);
+          --this->count;
+          ++woken;
+          on_ready(w->coro);
+        }
+        w = next;
+      }
+      this->arm(state);
+    }
+    return woken;
+  }
+
+private:
+  static std::uint32_t interest(const FdState &state) noexcept {
+    std::uint32_t events{0};
+    for (auto w{state.head}; w; w = w->next) {
+      events |= w->events;
+    }
+    return events;
+  }
+  /**
+   * @brief Arm the descriptor for what its waiters wait for, if it is not
+   * armed for exactly that already.
+   */
+  void arm(FdState &state) {
+    auto events{Reactor::interest(state)};
+    if (events == 0 || events == state.armed) {
+      return;
+    }
+    epoll_event ev{};
+    ev.events = events | EPOLLONESHOT;
+    ev.data.ptr = &state;
+    auto op{state.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD};
+    if (::epoll_ctl(this->epfd, op, state.fd, &ev) < 0) {
+      // The descriptor was closed and reused, or registered behind our back.
+      op = errno == ENOENT ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+      if ((errno != ENOENT && errno != EEXIST) ||
+          ::epoll_ctl(this->epfd, op, state.fd, &ev) < 0) {
+        state.registered = false;
+        throw std::system_error{errno, std::system_category(), "epoll_ctl"};
+      }
+    }
+    state.registered = true;
+    state.armed = events;
+  }
+  void unlink(FdState &state, IoWaiter &waiter) noexcept {
+    if (waiter.next) {
+      waiter.next->prev = waiter.prev;
+    }
+    if (waiter.prev) {
+      waiter.prev->next = waiter.next;
+    } else {
+      state.head = waiter.next;
+    }
+    waiter.prev = waiter.next = nullptr;
+    waiter.reactor = nullptr;
+    waiter.state = nullptr;
+  }
+  /**
+   * @brief Wait for events, with the timerfd armed for `deadline` unless it is
+   * already passed, in which case do not block at all.
+   */
+  int wait(std::optional<Clock::time_point> deadline) {
+    int timeout{-1};
+    if (deadline && *deadline <= Clock::now()) {
+      timeout = 0;
+    } else {
+      this->arm_timer(deadline);
+    }
+    auto n{::epoll_wait(this->epfd, this->ready.data(),
+                        static_cast<int>(this->ready.size()), timeout)};
+    if (n < 0) {
+      if (errno == EINTR) {
+        return 0;
+      }
+      throw std::system_error{errno, std::system_category(), "epoll_wait"};
+    }
+    return n;
+  }
+  /**
+   * @brief Arm the timerfd for an absolute deadline, or disarm it, unless it
+   * is armed for exactly that already.
+   */
+  void arm_timer(std::optional<Clock::time_point> deadline) {
+    if (deadline == this->timer_deadline) {
+      return;
+    }
+    using namespace std::chrono;
+    itimerspec spec{};
+    if (deadline) {
+      auto since_epoch{deadline->time_since_epoch()};
+      auto secs{duration_cast<seconds>(since_epoch)};
+      spec.it_value.tv_sec = static_cast<std::time_t>(secs.count());
+      spec.it_value.tv_nsec = static_cast<long>(
+          duration_cast<nanoseconds>(since_epoch - secs).count());
+      if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+        // A zero it_value would disarm the timer instead.
+        spec.it_value.tv_nsec = 1;
+      }
+    }
+    if (::timerfd_settime(this->tfd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+      throw std::system_error{errno, std::system_category(),
+                              "timerfd_settime"};
+    }
+    this->timer_deadline = deadline;
+  }
+  void drain_timer() noexcept {
+    std::uint64_t expirations{0};
+    [[maybe_unused]] auto r{
+        ::read(this->tfd, &expirations, sizeof(expirations))};
+    this->timer_deadline.reset();
+  }
+  void drain_notifications() noexcept {
+    std::uint64_t count{0};
+    [[maybe_unused]] auto r{::read(this->efd, &count, sizeof(count))};
+  }
+  [[noreturn]] void close_on_error(const char *what) {
+    auto error{errno};
+    if (this->efd >= 0) {
+      ::close(this->efd);
+    }
+    if (this->tfd >= 0) {
+      ::close(this->tfd);
+    }
+    ::close(this->epfd);
+    throw std::system_error{error, std::system_category(), what};
+  }
+};
+
+inline IoWaiter::~IoWaiter() {
+  if (this->reactor) {
+    this->reactor->remove(*this);
+  }
+}
+} // namespace cocos
+#endif // COCOS_REACTOR
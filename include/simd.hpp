@@ -0,0 +1,371 @@
+#ifndef COCOS_SIMD
+#define COCOS_SIMD
+#include "chunked_generator.hpp"
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Vectorized kernels over arithmetic streams. Each kernel is a plain loop over
+ * independent accumulator lanes, which the compiler turns into SIMD code; on
+ * x86 it is compiled a second time for AVX2, and the version to run is chosen
+ * once at runtime with `__builtin_cpu_supports`.
+ *
+ * Integer results are identical to folding the elements one by one, with
+ * two's complement wrapping. Floating-point sums and dot products add in a
+ * different order, and may round differently.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COCOS_SIMD_DISPATCH 1
+#define COCOS_SIMD_AVX2 [[gnu::target("avx2")]]
+#else
+#define COCOS_SIMD_DISPATCH 0
+#endif
+
+namespace cocos {
+namespace simd {
+template <typename T>
+concept Arithmetic = std::is_arithmetic_v<T> && !std::same_as<T, bool>;
+
+namespace detail {
+/**
+ * @brief Accumulators per kernel, enough for four 256-bit registers.
+ */
+template <typename T> constexpr std::size_t lanes{128 / sizeof(T)};
+
+inline bool has_avx2() noexcept {
+#if COCOS_SIMD_DISPATCH
+  static const bool avx2{__builtin_cpu_supports("avx2") != 0};
+  return avx2;
+#else
+  return false;
+#endif
+}
+
+/**
+ * @brief Integers are added as unsigned, so that they wrap instead of
+ * overflowing, in whatever order.
+ */
+template <typename T> constexpr T add(T a, T b) noexcept {
+  if constexpr (std::is_integral_v<T>) {
+    using U = std::make_unsigned_t<T>;
+    return static_cast<T>(static_cast<U>(a) + static_cast<U>(b));
+  } else {
+    return a + b;
+  }
+}
+template <typename T> constexpr T mul(T a, T b) noexcept {
+  if constexpr (std::is_integral_v<T>) {
+    using U = std::make_unsigned_t<T>;
+    return static_cast<T>(static_cast<U>(a) * static_cast<U>(b));
+  } else {
+    return a * b;
+  }
+}
+
+template <typename T>
+[[gnu::always_inline]] inline T sum_kernel(const T *p, std::size_t n) {
+  constexpr auto L{lanes<T>};
+  T acc[L]{};
+  std::size_t i{0};
+  for (; i + L <= n; i += L) {
+    for (std::size_t j{0}; j < L; ++j) {
+      acc[j] = add(acc[j], p[i + j]);
+    }
+  }
+  T total{};
+  for (std::size_t j{0}; j < L; ++j) {
+    total = add(total, acc[j]);
+  }
+  for (; i < n; ++i) {
+    total = add(total, p[i]);
+  }
+  return total;
+}
+template <typename T>
+[[gnu::always_inline]] inline T dot_kernel(const T *a, const T *b,
+                                           std::size_t n) {
+  constexpr auto L{lanes<T>};
+  T acc[L]{};
+  std::size_t i{0};
+  for (; i + L <= n; i += L) {
+    for (std::size_t j{0}; j < L; ++j) {
+      acc[j] = add(acc[j], mul(a[i + j], b[i + j]));
+    }
+  }
+  T total{};
+  for (std::size_t j{0}; j < L; ++j) {
+    total = add(total, acc[j]);
+  }
+  for (; i < n; ++i) {
+    total = add(total, mul(a[i], b[i]));
+  }
+  return total;
+}
+/**
+ * @brief The least element by `Less`, of at least one.
+ */
+template <typename T, typename Less>
+[[gnu::always_inline]] inline T extremum_kernel(const T *p, std::size_t n,
+                                                Less less) {
+  constexpr auto L{lanes<T>};
+  T acc[L];
+  for (std::size_t j{0}; j < L; ++j) {
+    acc[j] = p[0];
+  }
+  std::size_t i{0};
+  for (; i + L <= n; i += L) {
+    for (std::size_t j{0}; j < L; ++j) {
+      acc[j] = less(p[i + j], acc[j]) ? p[i + j] : acc[j];
+    }
+  }
+  T best{acc[0]};
+  for (std::size_t j{1}; j < L; ++j) {
+    best = less(acc[j], best) ? acc[j] : best;
+  }
+  for (; i < n; ++i) {
+    best = less(p[i], best) ? p[i] : best;
+  }
+  return best;
+}
+template <typename T, typename F>
+[[gnu::always_inline]] inline std::size_t
+count_if_kernel(const T *p, std::size_t n, F &pred) {
+  constexpr auto L{lanes<T>};
+  std::size_t acc[L]{};
+  std::size_t i{0};
+  for (; i + L <= n; i += L) {
+    for (std::size_t j{0}; j < L; ++j) {
+      acc[j] += pred(p[i + j]) ? 1 : 0;
+    }
+  }
+  std::size_t total{0};
+  for (std::size_t j{0}; j < L; ++j) {
+    total += acc[j];
+  }
+  for (; i < n; ++i) {
+    total += pred(p[i]) ? 1 : 0;
+  }
+  return total;
+}
+template <typename T, typename U, typename F>
+[[gnu::always_inline]] inline void
+transform_kernel(const T *in, U *out, std::size_t n, F &f) {
+  for (std::size_t i{0}; i < n; ++i) {
+    out[i] = f(in[i]);
+  }
+}
+
+#if COCOS_SIMD_DISPATCH
+template <typename T>
+COCOS_SIMD_AVX2 T sum_avx2(const T *p, std::size_t n) {
+  return sum_kernel(p, n);
+}
+template <typename T>
+COCOS_SIMD_AVX2 T dot_avx2(const T *a, const T *b, std::size_t n) {
+  return dot_kernel(a, b, n);
+}
+template <typename T, typename Less>
+COCOS_SIMD_AVX2 T extremum_avx2(const T *p, std::size_t n, Less less) {
+  return extremum_kernel(p, n, less);
+}
+template <typename T, typename F>
+COCOS_SIMD_AVX2 std::size_t count_if_avx2(const T *p, std::size_t n,
+                                          F &pred) {
+  return count_if_kernel(p, n, pred);
+}
+template <typename T, typename U, typename F>
+COCOS_SIMD_AVX2 void transform_avx2(const T *in, U *out, std::size_t n,
+                                    F &f) {
+  transform_kernel(in, out, n, f);
+}
+#endif
+
+struct Less {
+  template <typename T> bool operator()(T a, T b) const noexcept {
+    return a < b;
+  }
+};
+struct Greater {
+  template <typename T> bool operator()(T a, T b) const noexcept {
+    return b < a;
+  }
+};
+template <Arithmetic T, typename Less>
+T extremum(std::span<const T> values, Less less) {
+#if COCOS_SIMD_DISPATCH
+  if (has_avx2()) {
+    return extremum_avx2(values.data(), values.size(), less);
+  }
+#endif
+  return extremum_kernel(values.data(), values.size(), less);
+}
+template <Arithmetic T, std::size_t N, typename Less>
+std::optional<T> extremum(ChunkedGenerator<T, N> gen, Less less) {
+  std::optional<T> best;
+  while (gen.move_next()) {
+    auto val{extremum(gen.current_chunk(), less)};
+    if (!best || less(val, *best)) {
+      best = val;
+    }
+  }
+  return best;
+}
+} // namespace detail
+
+template <Arithmetic T> T sum(std::span<const T> values) {
+#if COCOS_SIMD_DISPATCH
+  if (detail::has_avx2()) {
+    return detail::sum_avx2(values.data(), values.size());
+  }
+#endif
+  return detail::sum_kernel(values.data(), values.size());
+}
+/**
+ * @brief The sum of the elements, zero if there is none.
+ */
+template <Arithmetic T, std::size_t N> T sum(ChunkedGenerator<T, N> gen) {
+  T total{};
+  while (gen.move_next()) {
+    total = detail::add(total, simd::sum(gen.current_chunk()));
+  }
+  return total;
+}
+/**
+ * @brief The least element of a non-empty span.
+ */
+template <Arithmetic T> T min(std::span<const T> values) {
+  return detail::extremum(values, detail::Less{});
+}
+/**
+ * @return std::optional<T> The least element, nullopt if there is none.
+ */
+template <Arithmetic T, std::size_t N>
+std::optional<T> min(ChunkedGenerator<T, N> gen) {
+  return detail::extremum(std::move(gen), detail::Less{});
+}
+/**
+ * @brief The greatest element of a non-empty span.
+ */
+template <Arithmetic T> T max(std::span<const T> values) {
+  return detail::extremum(values, detail::Greater{});
+}
+/**
+ * @return std::optional<T> The greatest element, nullopt if there is none.
+ */
+template <Arithmetic T, std::size_t N>
+std::optional<T> max(ChunkedGenerator<T, N> gen) {
+  return detail::extremum(std::move(gen), detail::Greater{});
+}
+/**
+ * @brief Count the elements where `pred(elem)` is `true`.
+ */
+template <Arithmetic T, typename F>
+std::size_t count_if(std::span<const T> values, F pred) {
+#if COCOS_SIMD_DISPATCH
+  if (detail::has_avx2()) {
+    return detail::count_if_avx2(values.data(), values.size(), pred);
+  }
+#endif
+  return detail::count_if_kernel(values.data(), values.size(), pred);
+}
+template <Arithmetic T, std::size_t N, typename F>
+std::size_t count_if(ChunkedGenerator<T, N> gen, F pred) {
+  std::size_t count{0};
+  while (gen.move_next()) {
+    count += simd::count_if(gen.current_chunk(), pred);
+  }
+  return count;
+}
+/**
+ * @brief Count the elements equal to `value`.
+ */
+template <Arithmetic T, std::size_t N>
+std::size_t count(ChunkedGenerator<T, N> gen, T value) {
+  return simd::count_if(std::move(gen), [value](T v) { return v == value; });
+}
+/**
+ * @brief The dot product of two spans of the same size.
+ */
+template <Arithmetic T>
+T dot(std::span<const T> a, std::span<const T> b) {
+#if COCOS_SIMD_DISPATCH
+  if (detail::has_avx2()) {
+    return detail::dot_avx2(a.data(), b.data(), std::min(a.size(), b.size()));
+  }
+#endif
+  return detail::dot_kernel(a.data(), b.data(), std::min(a.size(), b.size()));
+}
+/**
+ * @brief The dot product of two streams, up to the end of the shorter one.
+ * Their chunks need not line up.
+ */
+template <Arithmetic T, std::size_t N, std::size_t M>
+T dot(ChunkedGenerator<T, N> a, ChunkedGenerator<T, M> b) {
+  T total{};
+  std::span<const T> x, y;
+  while (true) {
+    if (x.empty()) {
+      if (!a.move_next()) {
+        break;
+      }
+      x = a.current_chunk();
+    }
+    if (y.empty()) {
+      if (!b.move_next()) {
+        break;
+      }
+      y = b.current_chunk();
+    }
+    auto n{std::min(x.size(), y.size())};
+    total = detail::add(total, simd::dot(x.first(n), y.first(n)));
+    x = x.subspan(n);
+    y = y.subspan(n);
+  }
+  return total;
+}
+/**
+ * @brief Write `f(in[i])` into `out[i]`, for the size of the shorter span.
+ */
+template <Arithmetic T, typename U, typename F>
+void transform(std::span<const T> in, std::span<U> out, F f) {
+  auto n{std::min(in.size(), out.size())};
+#if COCOS_SIMD_DISPATCH
+  if (detail::has_avx2()) {
+    detail::transform_avx2(in.data(), out.data(), n, f);
+    return;
+  }
+#endif
+  detail::transform_kernel(in.data(), out.data(), n, f);
+}
+/**
+ * @brief Mapping each element into another value using `f`, a chunk at a
+ * time through the vectorized transform.
+ */
+template <Arithmetic T, std::size_t N, typename F>
+ChunkedGenerator<std::invoke_result_t<F, T>, N> map(ChunkedGenerator<T, N> gen,
+                                                    F f) {
+  using U = std::invoke_result_t<F, T>;
+  return [](ChunkedGenerator<T, N> g, F f) -> ChunkedGenerator<U, N> {
+    std::array<U, N> out;
+    while (g.move_next()) {
+      // A spilled chunk may be larger than the buffer.
+      auto in{g.current_chunk()};
+      while (!in.empty()) {
+        auto n{std::min(in.size(), N)};
+        simd::transform(in.first(n), std::span<U>{out.data(), n}, f);
+        co_yield std::span<const U>{out.data(), n};
+        in = in.subspan(n);
+      }
+    }
+  }(std::move(gen), std::move(f));
+}
+} // namespace simd
+} // namespace cocos
+#endif // COCOS_SIMD
@@ -1,12 +1,50 @@
 #ifndef COCOS_SLEEP
 #define COCOS_SLEEP
+#include "cancellation.hpp"
 #include "eventloop.hpp"
 #include <chrono>
 #include <coroutine>
+#include <stop_token>
 namespace cocos {
     inline TimePoint now() { return std::chrono::steady_clock::now(); }
     struct Sleep {
         std::chrono::time_point<std::chrono::steady_clock> awake_time;
+        /**
+         * @brief The timer entry, living on the sleeping coroutine's frame.
+         */
+        TimerNode node{};
+        EventLoop *loop{nullptr};
+        std::stop_token token{};
+        detail::StopCallbackSlot<detail::TimerCanceller> on_stop{};
+        /**
+         * @brief Whether the coroutine is suspended, so that the timer may
+         * still be linked when it is destroyed.
+         */
+        bool suspended{false};
+        Sleep(TimePoint time) : awake_time{time} {}
+        Sleep(const Sleep &) = default;
+        /**
+         * @brief The node may still be referred to by a cancellation from
+         * another thread, which must not outlive it. If the sleeping
+         * coroutine is destroyed, possibly on another thread than the one
+         * driving the loop, the timer is detached through the loop.
+         */
+        ~Sleep() {
+            on_stop.reset();
+            if (loop) {
+                loop->forget_remote(node);
+            }
+            if (suspended) {
+                loop->detach(node);
+            }
+        }
+        /**
+         * @brief Set by the awaiting task, so that a stop request wakes the
+         * sleeping coroutine at once.
+         */
+        void set_stop_token(std::stop_token stop_token) noexcept {
+            token = std::move(stop_token);
+        }
         /**
          * @brief If the time to awake is already passed, just resume.
          * 
@@ -14,7 +52,7 @@ namespace cocos {
          * @return false It should wait.
          */
         bool await_ready() const {
-            return awake_time <= now();
+            return awake_time <= now() || token.stop_requested();
         }
         /**
          * @brief Delay the sleeping coroutine until the awake time.
@@ -22,13 +60,26 @@ namespace cocos {
          * @param hdl the sleeping coroutine.
          */
         void await_suspend(std::coroutine_handle<> hdl) {
-            EventLoop::get_loop().add_delayed_task(hdl, awake_time);
+            loop = &EventLoop::get_loop();
+            node = {hdl, awake_time};
+            loop->add_delayed_task(node);
+            suspended = true;
+            if (token.stop_possible()) {
+                on_stop.emplace(token, {loop, &node});
+            }
         }
         /**
          * @brief Sleep returns no value.
          * 
+         * @throw Cancelled if a stop has been requested.
          */
-        void await_resume() {}
+        void await_resume() {
+            on_stop.reset();
+            suspended = false;
+            if (token.stop_requested()) {
+                throw Cancelled{};
+            }
+        }
     };
     
     inline Sleep sleep_until(TimePoint time) {
@@ -0,0 +1,626 @@
+#ifndef COCOS_SYNC
+#define COCOS_SYNC
+#include "cancellation.hpp"
+#include "coroutine_concepts.hpp"
+#include "eventloop.hpp"
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <mutex>
+#include <stop_token>
+#include <utility>
+
+/**
+ * Coroutine synchronization primitives. Waiting never allocates: every waiter
+ * is an intrusive node in the awaiter on the waiting coroutine's frame, queued
+ * under a lock taken only by coroutines which have to wait and by whoever
+ * wakes them. Whoever releases a waiter hands it ownership at once, and posts
+ * it back to the loop it parked on, which it holds by a WorkGuard meanwhile;
+ * so a coroutine stays on its loop, and a long queue of waiters is not
+ * resumed nested on the releaser's stack. Only `AsyncMutex::async_unlock()`
+ * transfers to a waiter of the same loop directly.
+ *
+ * A parked coroutine is unparked by a stop request on the token of the task
+ * awaiting, and then throws Cancelled; a parked awaiter destroyed along with
+ * its coroutine unparks itself.
+ */
+namespace cocos {
+class AsyncMutex;
+
+/**
+ * @brief Unlocks an AsyncMutex when it goes out of scope.
+ */
+class AsyncLockGuard {
+  AsyncMutex *mutex;
+
+public:
+  explicit AsyncLockGuard(AsyncMutex &mutex) noexcept : mutex{&mutex} {}
+  AsyncLockGuard(AsyncLockGuard &&other) noexcept
+      : mutex{std::exchange(other.mutex, nullptr)} {}
+  AsyncLockGuard(const AsyncLockGuard &) = delete;
+  auto operator=(const AsyncLockGuard &) = delete;
+  inline ~AsyncLockGuard();
+  /**
+   * @brief Leave the mutex locked, e.g. for
+   * `co_await guard.release().async_unlock()`.
+   */
+  AsyncMutex &release() noexcept {
+    return *std::exchange(this->mutex, nullptr);
+  }
+};
+
+/**
+ * @brief A FIFO mutex for coroutines.
+ *
+ * The state is a single word: unlocked, locked, or locked with waiters. Only
+ * the last one takes the lock of the queue, to park a coroutine or to hand
+ * the mutex to the first waiter directly on unlock.
+ */
+class AsyncMutex {
+  enum State : unsigned char { unlocked, locked, contended };
+  /**
+   * @brief Unparks a waiter on a stop request.
+   */
+  struct Canceller {
+    AsyncMutex *mutex;
+    detail::ListedWaiter *waiter;
+    void operator()() const noexcept {
+      if (this->mutex->unlink(*this->waiter)) {
+        this->waiter->cancelled = true;
+        this->waiter->resume_on_loop();
+      }
+    }
+  };
+
+public:
+  /**
+   * @throw Cancelled If a stop was requested before the mutex was acquired.
+   */
+  class LockAwaiter : detail::ListedWaiter {
+    friend class AsyncMutex;
+    std::stop_token token{};
+    detail::StopCallbackSlot<Canceller> on_stop{};
+
+  protected:
+    AsyncMutex *mutex;
+
+  public:
+    explicit LockAwaiter(AsyncMutex &mutex) noexcept : mutex{&mutex} {}
+    LockAwaiter(LockAwaiter &&) = default;
+    ~LockAwaiter() {
+      if (this->suspended) {
+        this->on_stop.reset();
+        this->mutex->unlink(*this);
+      }
+    }
+    void set_stop_token(std::stop_token stop_token) noexcept {
+      this->token = std::move(stop_token);
+    }
+    bool await_ready() noexcept {
+      if (this->token.stop_requested()) {
+        this->cancelled = true;
+        return true;
+      }
+      return this->mutex->try_lock();
+    }
+    bool await_suspend(std::coroutine_handle<> hdl) {
+      this->park(hdl);
+      this->suspended = true;
+      if (!this->mutex->park(*this)) {
+        this->suspended = false;
+        this->unpark();
+        return false;
+      }
+      if (this->token.stop_possible()) {
+        this->on_stop.emplace(this->token, {this->mutex, this});
+      }
+      return true;
+    }
+    void await_resume() {
+      this->on_stop.reset();
+      this->suspended = false;
+      this->unpark();
+      if (this->cancelled) {
+        throw Cancelled{};
+      }
+    }
+  };
+  class ScopedLockAwaiter : public LockAwaiter {
+  public:
+    using LockAwaiter::LockAwaiter;
+    [[nodiscard]] AsyncLockGuard await_resume() {
+      LockAwaiter::await_resume();
+      return AsyncLockGuard{*this->mutex};
+    }
+  };
+
+  /**
+   * @brief Hands the mutex to the longest waiting coroutine by symmetric
+   * transfer when it parked on the loop of the unlocking one, which is
+   * queued behind it on that loop instead. A waiter parked on another loop
+   * is posted there, and the unlocking coroutine goes on at once.
+   */
+  class UnlockAwaiter {
+    AsyncMutex *mutex;
+    detail::ListedWaiter *waiter{nullptr};
+
+  public:
+    explicit UnlockAwaiter(AsyncMutex &mutex) noexcept : mutex{&mutex} {}
+    bool await_ready() noexcept {
+      this->waiter = this->mutex->take_waiter();
+      if (!this->waiter) {
+        return true;
+      }
+      if (!this->waiter->loop->is_current()) {
+        this->waiter->resume_on_loop();
+        return true;
+      }
+      return false;
+    }
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<> hdl) noexcept {
+      this->waiter->loop->add_task(hdl);
+      return this->waiter->node.coro;
+    }
+    void await_resume() const noexcept {}
+  };
+
+  AsyncMutex() = default;
+  AsyncMutex(const AsyncMutex &) = delete;
+  auto operator=(const AsyncMutex &) = delete;
+
+  bool try_lock() noexcept {
+    auto expected{unlocked};
+    return this->state.compare_exchange_strong(expected, locked,
+                                               std::memory_order_acquire,
+                                               std::memory_order_relaxed);
+  }
+  /**
+   * @brief `co_await mutex.lock()` resumes once the mutex is held.
+   */
+  LockAwaiter lock() noexcept { return LockAwaiter{*this}; }
+  /**
+   * @brief `co_await mutex.scoped_lock()` produces a guard which unlocks.
+   */
+  ScopedLockAwaiter scoped_lock() noexcept { return ScopedLockAwaiter{*this}; }
+  /**
+   * @brief `co_await mutex.async_unlock()` releases the mutex, and resumes
+   * a waiter parked on the same loop in place of the awaiting coroutine,
+   * without a trip through the loop's queue for the waiter.
+   */
+  UnlockAwaiter async_unlock() noexcept { return UnlockAwaiter{*this}; }
+  /**
+   * @brief Release the mutex, or hand it to the longest waiting coroutine and
+   * post it to its loop. A plain call cannot transfer to the waiter, which
+   * would run nested on the caller's stack; `async_unlock()` can.
+   */
+  void unlock() {
+    if (auto waiter{this->take_waiter()}) {
+      waiter->resume_on_loop();
+    }
+  }
+
+private:
+  std::atomic<State> state{unlocked};
+  /**
+   * @brief Guards the queue of parked coroutines only.
+   */
+  std::mutex mtx;
+  detail::WaiterList<detail::ListedWaiter> waiters;
+
+  /**
+   * @return bool Whether to suspend, false if the mutex was acquired instead.
+   */
+  bool park(LockAwaiter &awaiter) {
+    std::lock_guard lk{this->mtx};
+    auto old{this->state.load(std::memory_order_relaxed)};
+    while (old != contended) {
+      auto next{old == unlocked ? locked : contended};
+      if (this->state.compare_exchange_weak(old, next,
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+        if (next == locked) {
+          return false;
+        }
+        break;
+      }
+    }
+    this->waiters.push_back(awaiter);
+    awaiter.listed = true;
+    return true;
+  }
+  /**
+   * @brief Release the mutex, unless a coroutine waits for it.
+   *
+   * @return The waiter which now holds the mutex, if any.
+   */
+  detail::ListedWaiter *take_waiter() noexcept {
+    auto expected{locked};
+    if (this->state.compare_exchange_strong(expected, unlocked,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    std::lock_guard lk{this->mtx};
+    auto waiter{this->waiters.pop_front()};
+    if (!waiter) {
+      // Every waiter was cancelled.
+      this->state.store(unlocked, std::memory_order_release);
+      return nullptr;
+    }
+    waiter->listed = false;
+    if (this->waiters.empty()) {
+      this->state.store(locked, std::memory_order_relaxed);
+    }
+    return waiter;
+  }
+  /**
+   * @brief Take a waiter out of the queue, unless it was handed the mutex
+   * already.
+   *
+   * @return bool Whether it was still parked.
+   */
+  bool unlink(detail::ListedWaiter &waiter) noexcept {
+    std::lock_guard lk{this->mtx};
+    if (!waiter.listed) {
+      return false;
+    }
+    this->waiters.remove(waiter);
+    waiter.listed = false;
+    if (this->waiters.empty()) {
+      this->state.store(locked, std::memory_order_relaxed);
+    }
+    return true;
+  }
+};
+
+inline AsyncLockGuard::~AsyncLockGuard() {
+  if (this->mutex) {
+    this->mutex->unlock();
+  }
+}
+
+/**
+ * @brief A counting semaphore for coroutines, e.g. to limit concurrency.
+ *
+ * Acquiring and releasing touch one atomic counter when no one has to wait.
+ * A coroutine which finds no unit queues under a lock; a counter of queued
+ * coroutines, read after a full fence, lets a release skip the lock when
+ * nobody waits. Queued coroutines are granted units in arrival order, but a
+ * coroutine arriving while a unit is free takes it ahead of them.
+ */
+class AsyncSemaphore {
+  /**
+   * @brief Unparks a waiter on a stop request.
+   */
+  struct Canceller {
+    AsyncSemaphore *semaphore;
+    detail::ListedWaiter *waiter;
+    void operator()() const noexcept {
+      if (this->semaphore->unlink(*this->waiter)) {
+        this->waiter->cancelled = true;
+        this->waiter->resume_on_loop();
+      }
+    }
+  };
+
+public:
+  /**
+   * @throw Cancelled If a stop was requested before a unit was taken.
+   */
+  class AcquireAwaiter : detail::ListedWaiter {
+    friend class AsyncSemaphore;
+    AsyncSemaphore *semaphore;
+    std::stop_token token{};
+    detail::StopCallbackSlot<Canceller> on_stop{};
+
+  public:
+    explicit AcquireAwaiter(AsyncSemaphore &semaphore) noexcept
+        : semaphore{&semaphore} {}
+    AcquireAwaiter(AcquireAwaiter &&) = default;
+    ~AcquireAwaiter() {
+      if (this->suspended) {
+        this->on_stop.reset();
+        this->semaphore->unlink(*this);
+      }
+    }
+    void set_stop_token(std::stop_token stop_token) noexcept {
+      this->token = std::move(stop_token);
+    }
+    bool await_ready() noexcept {
+      if (this->token.stop_requested()) {
+        this->cancelled = true;
+        return true;
+      }
+      return this->semaphore->try_acquire();
+    }
+    bool await_suspend(std::coroutine_handle<> hdl) {
+      this->park(hdl);
+      this->suspended = true;
+      if (!this->semaphore->park(*this)) {
+        this->suspended = false;
+        this->unpark();
+        return false;
+      }
+      if (this->token.stop_possible()) {
+        this->on_stop.emplace(this->token, {this->semaphore, this});
+      }
+      return true;
+    }
+    void await_resume() {
+      this->on_stop.reset();
+      this->suspended = false;
+      this->unpark();
+      if (this->cancelled) {
+        throw Cancelled{};
+      }
+    }
+  };
+
+  explicit AsyncSemaphore(std::ptrdiff_t initial) : count{initial} {}
+  AsyncSemaphore(const AsyncSemaphore &) = delete;
+  auto operator=(const AsyncSemaphore &) = delete;
+
+  bool try_acquire() noexcept {
+    auto old{this->count.load(std::memory_order_relaxed)};
+    while (old > 0) {
+      if (this->count.compare_exchange_weak(old, old - 1,
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  /**
+   * @brief `co_await semaphore.acquire()` resumes once a unit is taken.
+   */
+  AcquireAwaiter acquire() noexcept { return AcquireAwaiter{*this}; }
+  /**
+   * @brief Give back `n` units, granting them to as many waiters in arrival
+   * order, and posting those to their loops.
+   */
+  void release(std::ptrdiff_t n = 1) {
+    this->count.fetch_add(n, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (this->waiting.load(std::memory_order_relaxed) == 0) {
+      return;
+    }
+    detail::WaiterList<detail::ListedWaiter> granted;
+    {
+      std::lock_guard lk{this->mtx};
+      while (!this->waiters.empty() && this->try_acquire()) {
+        auto waiter{this->waiters.pop_front()};
+        waiter->listed = false;
+        this->waiting.fetch_sub(1, std::memory_order_relaxed);
+        granted.push_back(*waiter);
+      }
+    }
+    while (auto waiter{granted.pop_front()}) {
+      waiter->resume_on_loop();
+    }
+  }
+
+private:
+  std::atomic<std::ptrdiff_t> count;
+  std::atomic<std::size_t> waiting{0};
+  /**
+   * @brief Guards the queue of parked coroutines only.
+   */
+  std::mutex mtx;
+  detail::WaiterList<detail::ListedWaiter> waiters;
+
+  /**
+   * @brief Park a waiter, unless a unit was released after it found none,
+   * which the full fence after registering makes visible.
+   *
+   * @return bool Whether to suspend, false if a unit was acquired instead.
+   */
+  bool park(AcquireAwaiter &awaiter) {
+    std::lock_guard lk{this->mtx};
+    this->waiters.push_back(awaiter);
+    awaiter.listed = true;
+    this->waiting.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!this->try_acquire()) {
+      return true;
+    }
+    this->waiters.remove(awaiter);
+    awaiter.listed = false;
+    this->waiting.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+  /**
+   * @return bool Whether the waiter was still parked.
+   */
+  bool unlink(detail::ListedWaiter &waiter) noexcept {
+    std::lock_guard lk{this->mtx};
+    if (!waiter.listed) {
+      return false;
+    }
+    this->waiters.remove(waiter);
+    waiter.listed = false;
+    this->waiting.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+};
+
+/**
+ * @brief A manual-reset event: once set, every waiter is resumed and later
+ * waits complete at once, until it is reset.
+ */
+class AsyncEvent {
+  /**
+   * @brief Unparks a waiter on a stop request.
+   */
+  struct Canceller {
+    const AsyncEvent *event;
+    detail::ListedWaiter *waiter;
+    void operator()() const noexcept {
+      if (this->event->unlink(*this->waiter)) {
+        this->waiter->cancelled = true;
+        this->waiter->resume_on_loop();
+      }
+    }
+  };
+
+public:
+  /**
+   * @throw Cancelled If a stop was requested before the event was set.
+   */
+  class WaitAwaiter : detail::ListedWaiter {
+    friend class AsyncEvent;
+    const AsyncEvent *event;
+    std::stop_token token{};
+    detail::StopCallbackSlot<Canceller> on_stop{};
+
+  public:
+    explicit WaitAwaiter(const AsyncEvent &event) noexcept : event{&event} {}
+    WaitAwaiter(WaitAwaiter &&) = default;
+    ~WaitAwaiter() {
+      if (this->suspended) {
+        this->on_stop.reset();
+        this->event->unlink(*this);
+      }
+    }
+    void set_stop_token(std::stop_token stop_token) noexcept {
+      this->token = std::move(stop_token);
+    }
+    bool await_ready() noexcept {
+      if (this->token.stop_requested()) {
+        this->cancelled = true;
+        return true;
+      }
+      return this->event->is_set();
+    }
+    bool await_suspend(std::coroutine_handle<> hdl) {
+      this->park(hdl);
+      this->suspended = true;
+      if (!this->event->park(*this)) {
+        this->suspended = false;
+        this->unpark();
+        return false;
+      }
+      if (this->token.stop_possible()) {
+        this->on_stop.emplace(this->token, {this->event, this});
+      }
+      return true;
+    }
+    void await_resume() {
+      this->on_stop.reset();
+      this->suspended = false;
+      this->unpark();
+      if (this->cancelled) {
+        throw Cancelled{};
+      }
+    }
+  };
+
+  explicit AsyncEvent(bool initially_set = false) : flag{initially_set} {}
+  AsyncEvent(const AsyncEvent &) = delete;
+  auto operator=(const AsyncEvent &) = delete;
+
+  bool is_set() const noexcept {
+    return this->flag.load(std::memory_order_acquire);
+  }
+  /**
+   * @brief `co_await event.wait()` resumes once the event is set.
+   */
+  WaitAwaiter wait() const noexcept { return WaitAwaiter{*this}; }
+  /**
+   * @brief Set the event, and post every waiter to its loop.
+   */
+  void set() {
+    if (this->is_set()) {
+      return;
+    }
+    detail::WaiterList<detail::ListedWaiter> woken;
+    {
+      std::lock_guard lk{this->mtx};
+      this->flag.store(true, std::memory_order_release);
+      for (auto waiter{this->waiters.head}; waiter; waiter = waiter->next) {
+        waiter->listed = false;
+      }
+      std::swap(woken, this->waiters);
+    }
+    // A waiter's frame may be gone once it is posted.
+    while (auto waiter{woken.pop_front()}) {
+      waiter->resume_on_loop();
+    }
+  }
+  void reset() noexcept { this->flag.store(false, std::memory_order_relaxed); }
+
+private:
+  std::atomic<bool> flag;
+  /**
+   * @brief Guards the queue of parked coroutines only.
+   */
+  mutable std::mutex mtx;
+  mutable detail::WaiterList<detail::ListedWaiter> waiters;
+
+  /**
+   * @return bool Whether to suspend, false if the event was set meanwhile.
+   */
+  bool park(WaitAwaiter &awaiter) const {
+    std::lock_guard lk{this->mtx};
+    if (this->is_set()) {
+      return false;
+    }
+    this->waiters.push_back(awaiter);
+    awaiter.listed = true;
+    return true;
+  }
+  /**
+   * @return bool Whether the waiter was still parked.
+   */
+  bool unlink(detail::ListedWaiter &waiter) const noexcept {
+    std::lock_guard lk{this->mtx};
+    if (!waiter.listed) {
+      return false;
+    }
+    this->waiters.remove(waiter);
+    waiter.listed = false;
+    return true;
+  }
+};
+
+/**
+ * @brief A single-use countdown latch: waiters are resumed once it has been
+ * counted down to zero.
+ */
+class Latch {
+  std::atomic<std::ptrdiff_t> count;
+  AsyncEvent event;
+
+public:
+  explicit Latch(std::ptrdiff_t expected)
+      : count{expected}, event{expected <= 0} {}
+  Latch(const Latch &) = delete;
+  auto operator=(const Latch &) = delete;
+
+  bool try_wait() const noexcept { return this->event.is_set(); }
+  /**
+   * @brief Count down by `n`, posting every waiter to its loop if it reaches
+   * zero.
+   */
+  void count_down(std::ptrdiff_t n = 1) {
+    if (this->count.fetch_sub(n, std::memory_order_acq_rel) == n) {
+      this->event.set();
+    }
+  }
+  /**
+   * @brief `co_await latch.wait()` resumes once the count has reached zero.
+   */
+  AsyncEvent::WaitAwaiter wait() const noexcept { return this->event.wait(); }
+};
+
+static_assert(concepts::Awaiter<AsyncMutex::LockAwaiter>);
+static_assert(concepts::Awaiter<AsyncMutex::ScopedLockAwaiter>);
+static_assert(concepts::Awaiter<AsyncMutex::UnlockAwaiter>);
+static_assert(concepts::Awaiter<AsyncSemaphore::AcquireAwaiter>);
+static_assert(concepts::Awaiter<AsyncEvent::WaitAwaiter>);
+static_assert(concepts::Stoppable<AsyncMutex::LockAwaiter>);
+static_assert(concepts::Stoppable<AsyncSemaphore::AcquireAwaiter>);
+static_assert(concepts::Stoppable<AsyncEvent::WaitAwaiter>);
+} // namespace cocos
+#endif // COCOS_SYNC
@@ -0,0 +1,147 @@
+#ifndef COCOS_SYNC_WAIT
+#define COCOS_SYNC_WAIT
+#include "eventloop.hpp"
+#include "frame_allocator.hpp"
+#include "task.hpp"
+#include "threadpool.hpp"
+#include "when_all.hpp"
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace cocos {
+namespace detail {
+/**
+ * @brief Parks the calling thread on a condition variable until a task on a
+ * pool is finished.
+ */
+class SyncWaitEvent {
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool done{false};
+
+public:
+  /**
+   * @brief Notified under the lock, so that the waiting thread cannot destroy
+   * the event before the notifying one has let go of it.
+   */
+  void set() {
+    std::lock_guard lk{this->mtx};
+    this->done = true;
+    this->cv.notify_one();
+  }
+  void wait() {
+    std::unique_lock lk{this->mtx};
+    this->cv.wait(lk, [this] { return this->done; });
+  }
+};
+
+template <typename T> class SyncWaitTask;
+
+template <typename T> struct SyncWaitPromise : PooledPromise {
+  SyncWaitEvent *event{nullptr};
+  std::variant<std::monostate, WhenResult<T>, std::exception_ptr> result;
+
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<SyncWaitPromise> hdl) noexcept {
+      hdl.promise().event->set();
+    }
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  SyncWaitTask<T> get_return_object() {
+    return SyncWaitTask<T>{
+        std::coroutine_handle<SyncWaitPromise>::from_promise(*this)};
+  }
+  void unhandled_exception() {
+    this->result.template emplace<2>(std::current_exception());
+  }
+  template <typename U> void return_value(U &&value) {
+    this->result.template emplace<1>(std::forward<U>(value));
+  }
+};
+
+/**
+ * @brief Runs the awaited task on a pool, and signals the waiting thread from
+ * its final suspend point.
+ */
+template <typename T> class SyncWaitTask {
+public:
+  using promise_type = SyncWaitPromise<T>;
+  using THandle = std::coroutine_handle<promise_type>;
+
+  explicit SyncWaitTask(THandle hdl) : co_hdl{hdl} {}
+  SyncWaitTask(const SyncWaitTask &) = delete;
+  auto operator=(const SyncWaitTask &) = delete;
+  ~SyncWaitTask() { this->co_hdl.destroy(); }
+  void start(ThreadPoolLoop &pool, SyncWaitEvent &event) {
+    this->co_hdl.promise().event = &event;
+    pool.add_task(this->co_hdl);
+  }
+  WhenResult<T> &&result() {
+    auto &result{this->co_hdl.promise().result};
+    if (result.index() == 2) {
+      std::rethrow_exception(std::get<2>(result));
+    }
+    return std::get<1>(std::move(result));
+  }
+
+private:
+  THandle co_hdl;
+};
+
+template <typename T> SyncWaitTask<T> make_sync_wait_task(Task<T> task) {
+  if constexpr (std::is_void_v<T>) {
+    co_await std::move(task);
+    co_return std::monostate{};
+  } else {
+    co_return co_await std::move(task);
+  }
+}
+} // namespace detail
+
+/**
+ * @brief Block the calling thread until the task is finished, running the
+ * loop of the thread meanwhile. Timers and I/O are waited for in the reactor,
+ * so the thread does not spin. It must not be called from a coroutine.
+ *
+ * @return The result of the task, or throw its exception. Throw
+ * std::logic_error if the loop runs out of work before the task is finished.
+ */
+template <typename T> T sync_wait(Task<T> task) {
+  if constexpr (std::is_void_v<T>) {
+    task.wait();
+  } else {
+    return std::move(task.wait());
+  }
+}
+/**
+ * @brief Run the task on the pool, and park the calling thread on a
+ * condition variable until it is finished. The workers are kept up for the
+ * duration of the call, and spawned if they are not, whether the pool was
+ * started, is in run() or neither. It must not be called from a worker of
+ * the pool.
+ *
+ * @return The result of the task, or throw its exception.
+ */
+template <typename T> T sync_wait(ThreadPoolLoop &pool, Task<T> task) {
+  ThreadPoolLoop::KeepAlive keep_alive{pool};
+  detail::SyncWaitEvent event;
+  auto wrapper{detail::make_sync_wait_task(std::move(task))};
+  wrapper.start(pool, event);
+  event.wait();
+  if constexpr (std::is_void_v<T>) {
+    wrapper.result();
+  } else {
+    return std::move(wrapper.result());
+  }
+}
+} // namespace cocos
+#endif // COCOS_SYNC_WAIT
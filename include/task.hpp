@@ -1,10 +1,15 @@
 #ifndef COCOS_TASK
 #define COCOS_TASK
+#include "cancellation.hpp"
 #include "coroutine_concepts.hpp"
 #include "eventloop.hpp"
+#include "frame_allocator.hpp"
+#include "trace.hpp"
 #include <algorithm>
 #include <coroutine>
 #include <exception>
+#include <stdexcept>
+#include <stop_token>
 #include <type_traits>
 #include <utility>
 #include <variant>
@@ -14,12 +19,37 @@ template <typename T = void> struct TaskPromise;
 template <typename T = void> class Task;
 template <typename T> struct TaskAwaiter;
 
+namespace detail {
+/**
+ * @brief Run the loop of the current thread until the top-level task `hdl`
+ * is finished, rather than resuming it out of order.
+ */
+template <typename P> void drive_until_done(std::coroutine_handle<P> hdl) {
+  auto &loop{EventLoop::get_loop()};
+  if (!hdl.promise().scheduled) {
+    hdl.promise().scheduled = true;
+    loop.add_task(hdl);
+  }
+  if (!loop.run_until([hdl] { return hdl.done(); })) {
+    throw std::logic_error{"the loop ran out of work before the task finished"};
+  }
+}
+} // namespace detail
+
 struct FinalAwaiter {
   std::coroutine_handle<> prev_hdl;
   bool await_ready() const noexcept { return false; }
-  std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept {
-    if (this->prev_hdl) {
-      return this->prev_hdl;
+  template <typename P>
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<P> hdl) noexcept {
+    trace::event('i', "complete", hdl.address());
+    // The task may be destroyed as soon as its end is signalled.
+    auto prev_hdl{this->prev_hdl};
+    auto &promise{hdl.promise()};
+    if (promise.done_signal) {
+      promise.done_signal->set(promise.signalled);
+    }
+    if (prev_hdl) {
+      return prev_hdl;
     }
     return std::noop_coroutine();
   }
@@ -33,11 +63,23 @@ template <typename T> struct TaskAwaiter {
    */
   bool await_ready() const noexcept { return false; }
   /**
-   * @brief Add the awaiting coroutine to the event loop.
+   * @brief A task awaited by a cancellable one becomes cancellable through
+   * the same token, unless it was given one of its own.
    */
-  std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept {
-    EventLoop::get_loop().add_task(task);
-    return std::noop_coroutine();
+  void set_stop_token(const std::stop_token &token) noexcept {
+    auto &own{this->task.co_hdl.promise().stop_token};
+    if (!own.stop_possible()) {
+      own = token;
+    }
+  }
+  /**
+   * @brief Transfer to the awaited task directly (symmetric transfer), rather
+   * than through the event loop. The task transfers back to the awaiting
+   * coroutine when it finishes, see FinalAwaiter.
+   */
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> hdl) noexcept {
+    this->task.co_hdl.promise().prev_hdl = hdl;
+    return this->task.co_hdl;
   }
   /**
    * @brief When a task resumes, it is already ready for the result, so that the
@@ -53,6 +95,7 @@ template <typename T> struct TaskAwaiter {
 template <> class Task<void> {
   friend struct TaskAwaiter<void>;
   friend class EventLoop;
+  friend class ThreadPoolLoop;
   template <typename U> friend struct TaskPromise;
 
 public:
@@ -78,10 +121,26 @@ public:
     return *this;
   }
   void swap(Self &other) noexcept { std::swap(this->co_hdl, other.co_hdl); }
+  /**
+   * @brief Await the task from any kind of coroutine. The task is moved into
+   * the awaiter.
+   */
+  TaskAwaiter<void> operator co_await() && noexcept;
+  /**
+   * @brief Make the task cancellable: a stop request on `token` cancels the
+   * timer, I/O or task it is waiting for, which then throws Cancelled. The
+   * token is handed down to every task it awaits.
+   */
+  void set_stop_token(std::stop_token token) noexcept;
+  std::stop_token get_stop_token() const noexcept;
 
 public:
+  bool done() const noexcept { return this->co_hdl.done(); }
   /**
-   * @brief Block the thread to wait for the result.
+   * @brief Run the loop of the current thread until the task is finished,
+   * scheduling the task first if it was never added to a loop, see
+   * sync_wait(). A task added to a ThreadPoolLoop is waited for on a
+   * condition variable instead.
    */
   void wait(); // impl see below, due to the circular dependency.
 
@@ -120,6 +179,7 @@ private:
 template <typename T> class Task {
   friend struct TaskAwaiter<T>;
   friend class EventLoop;
+  friend class ThreadPoolLoop;
   template <typename U> friend struct TaskPromise;
 
 public:
@@ -145,19 +205,44 @@ public:
     return *this;
   }
   void swap(Self &other) noexcept { std::swap(this->co_hdl, other.co_hdl); }
+  /**
+   * @brief Await the task from any kind of coroutine. The task is moved into
+   * the awaiter.
+   */
+  TaskAwaiter<T> operator co_await() && noexcept {
+    return TaskAwaiter<T>{std::move(*this)};
+  }
+  /**
+   * @brief Make the task cancellable: a stop request on `token` cancels the
+   * timer, I/O or task it is waiting for, which then throws Cancelled. The
+   * token is handed down to every task it awaits.
+   */
+  void set_stop_token(std::stop_token token) noexcept {
+    this->co_hdl.promise().stop_token = std::move(token);
+  }
+  std::stop_token get_stop_token() const noexcept {
+    return this->co_hdl.promise().stop_token;
+  }
 
 public:
+  bool done() const noexcept { return this->co_hdl.done(); }
   /**
-   * @brief Block the thread to wait for the result.
+   * @brief Run the loop of the current thread until the task is finished,
+   * scheduling the task first if it was never added to a loop, see
+   * sync_wait(). A task added to a ThreadPoolLoop is waited for on a
+   * condition variable instead.
    *
    * @return The result of the task or throw the exception happend within the
    * task.
    */
   T& wait() {
-    while (!this->co_hdl.done()) {
-      this->co_hdl.resume();
+    auto &promise{this->co_hdl.promise()};
+    if (promise.done_signal) {
+      promise.done_signal->wait(promise.signalled);
+    } else if (!this->co_hdl.done()) {
+      detail::drive_until_done(this->co_hdl);
     }
-    return this->co_hdl.promise().get();
+    return promise.get();
   }
 
   template <typename F> Task<std::invoke_result_t<F, T &>> then(F f) {
@@ -192,13 +277,28 @@ public:
   THandle co_hdl;
 };
 
-template <> struct TaskPromise<void> {
+template <> struct TaskPromise<void> : PooledPromise {
   /**
    * @brief A task of void do not need to store the result.
    *
    */
   std::exception_ptr ep;
   std::coroutine_handle<> prev_hdl{};
+  /**
+   * @brief Cancels the waits of the task, see Task::set_stop_token().
+   */
+  std::stop_token stop_token{};
+  /**
+   * @brief Whether the task was added to a loop, which is then the one to
+   * start it.
+   */
+  bool scheduled{false};
+  /**
+   * @brief Whether the end of the task was signalled, through the signal of
+   * the ThreadPoolLoop it was added to, if any.
+   */
+  bool signalled{false};
+  detail::TaskDoneSignal *done_signal{nullptr};
   /**
    * @brief Tasks are lazy, so they are not ready when they are first awaited.
    *
@@ -213,12 +313,19 @@ template <> struct TaskPromise<void> {
    */
   FinalAwaiter final_suspend() const noexcept { return {prev_hdl}; }
   /**
-   * @brief An awaiter needs no transformation.
+   * @brief An awaiter needs no transformation, but a cancellable one is given
+   * the stop token of the task.
    * @return A The very same awaiter.
    */
   template <concepts::Awaiter A> A await_transform(A &&a) const noexcept {
+    if constexpr (concepts::Stoppable<A>) {
+      a.set_stop_token(this->stop_token);
+    }
     return std::forward<A>(a);
   }
+  StopTokenAwaiter await_transform(GetStopToken) const noexcept {
+    return {this->stop_token};
+  }
   /**
    * @brief Transform a task to an awaiter. Once a task is awaited, it is no
    * more needed(because its result becomes the value of the await epression),
@@ -226,23 +333,23 @@ template <> struct TaskPromise<void> {
    *
    */
   template <typename T> TaskAwaiter<T> await_transform(Task<T> &t) noexcept {
-    auto task{std::move(t)};
-    task.co_hdl.promise().prev_hdl =
-        std::coroutine_handle<TaskPromise<void>>::from_promise(*this);
-    return TaskAwaiter<T>{std::move(task)};
+    TaskAwaiter<T> awaiter{std::move(t)};
+    awaiter.set_stop_token(this->stop_token);
+    return awaiter;
   }
   /**
    * @brief The same as above, but for rvalue reference.
    *
    */
   template <typename T> TaskAwaiter<T> await_transform(Task<T> &&t) noexcept {
-    auto task{std::move(t)};
-    task.co_hdl.promise().prev_hdl =
-        std::coroutine_handle<TaskPromise<void>>::from_promise(*this);
-    return TaskAwaiter<T>{std::move(task)};
+    TaskAwaiter<T> awaiter{std::move(t)};
+    awaiter.set_stop_token(this->stop_token);
+    return awaiter;
   }
   Task<void> get_return_object() {
-    return Task<void>{std::coroutine_handle<TaskPromise>::from_promise(*this)};
+    auto hdl{std::coroutine_handle<TaskPromise>::from_promise(*this)};
+    trace::event('i', "create", hdl.address());
+    return Task<void>{hdl};
   }
   /**
    * @brief If exception happens, store it.
@@ -261,7 +368,7 @@ template <> struct TaskPromise<void> {
   }
 };
 
-template <typename T> struct TaskPromise {
+template <typename T> struct TaskPromise : PooledPromise {
   /**
    * @brief Either the result nor the exception is stored in the promise. Null
    * exception_ptr represents unfinished coroutine.
@@ -269,6 +376,21 @@ template <typename T> struct TaskPromise {
    */
   std::variant<std::exception_ptr, T> result;
   std::coroutine_handle<> prev_hdl{};
+  /**
+   * @brief Cancels the waits of the task, see Task::set_stop_token().
+   */
+  std::stop_token stop_token{};
+  /**
+   * @brief Whether the task was added to a loop, which is then the one to
+   * start it.
+   */
+  bool scheduled{false};
+  /**
+   * @brief Whether the end of the task was signalled, through the signal of
+   * the ThreadPoolLoop it was added to, if any.
+   */
+  bool signalled{false};
+  detail::TaskDoneSignal *done_signal{nullptr};
   /**
    * @brief Tasks are lazy, so they are not ready when they are first awaited.
    *
@@ -283,12 +405,19 @@ template <typename T> struct TaskPromise {
    */
   FinalAwaiter final_suspend() const noexcept { return {prev_hdl}; }
   /**
-   * @brief An awaiter needs no transformation.
+   * @brief An awaiter needs no transformation, but a cancellable one is given
+   * the stop token of the task.
    * @return A The very same awaiter.
    */
   template <concepts::Awaiter A> A await_transform(A &&a) const noexcept {
+    if constexpr (concepts::Stoppable<A>) {
+      a.set_stop_token(this->stop_token);
+    }
     return std::forward<A>(a);
   }
+  StopTokenAwaiter await_transform(GetStopToken) const noexcept {
+    return {this->stop_token};
+  }
   /**
    * @brief Transform a task to an awaiter. Once a task is awaited, it is no
    * more needed(because its result becomes the value of the await epression),
@@ -296,23 +425,23 @@ template <typename T> struct TaskPromise {
    *
    */
   template <typename U> TaskAwaiter<U> await_transform(Task<U> &t) noexcept {
-    auto task{std::move(t)};
-    task.co_hdl.promise().prev_hdl =
-        std::coroutine_handle<TaskPromise<T>>::from_promise(*this);
-    return TaskAwaiter<U>{std::move(task)};
+    TaskAwaiter<U> awaiter{std::move(t)};
+    awaiter.set_stop_token(this->stop_token);
+    return awaiter;
   }
   /**
    * @brief The same as above, but for rvalue reference.
    *
    */
   template <typename U> TaskAwaiter<U> await_transform(Task<U> &&t) noexcept {
-    auto task{std::move(t)};
-    task.co_hdl.promise().prev_hdl =
-        std::coroutine_handle<TaskPromise<T>>::from_promise(*this);
-    return TaskAwaiter<U>{std::move(task)};
+    TaskAwaiter<U> awaiter{std::move(t)};
+    awaiter.set_stop_token(this->stop_token);
+    return awaiter;
   }
   Task<T> get_return_object() {
-    return Task<T>{std::coroutine_handle<TaskPromise>::from_promise(*this)};
+    auto hdl{std::coroutine_handle<TaskPromise>::from_promise(*this)};
+    trace::event('i', "create", hdl.address());
+    return Task<T>{hdl};
   }
   /**
    * @brief If exception happens, store it.
@@ -341,12 +470,25 @@ template <typename T> struct TaskPromise {
   }
 };
 
-inline void Task<void>::wait() {
+inline TaskAwaiter<void> Task<void>::operator co_await() && noexcept {
+  return TaskAwaiter<void>{std::move(*this)};
+}
 
-  while (!this->co_hdl.done()) {
-    this->co_hdl.resume();
+inline void Task<void>::set_stop_token(std::stop_token token) noexcept {
+  this->co_hdl.promise().stop_token = std::move(token);
+}
+inline std::stop_token Task<void>::get_stop_token() const noexcept {
+  return this->co_hdl.promise().stop_token;
+}
+
+inline void Task<void>::wait() {
+  auto &promise{this->co_hdl.promise()};
+  if (promise.done_signal) {
+    promise.done_signal->wait(promise.signalled);
+  } else if (!this->co_hdl.done()) {
+    detail::drive_until_done(this->co_hdl);
   }
-  this->co_hdl.promise().get();
+  promise.get();
 }
 } // namespace cocos
 #endif // COCOS_TASK
\ No newline at end of file
@@ -0,0 +1,549 @@
+#ifndef COCOS_THREADPOOL
+#define COCOS_THREADPOOL
+#include "eventloop.hpp"
+#include "work_stealing_deque.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cocos {
+/**
+ * @brief A multi-threaded event loop. Each worker owns a Chase-Lev deque of
+ * ready coroutines, and steals from a random victim when it runs out of work.
+ *
+ * Coroutines running on a worker see the worker's own EventLoop through
+ * `EventLoop::get_loop()`, so Task and Sleep work on the pool unchanged:
+ * whatever they schedule is moved into the worker's deque after each resume,
+ * and their timers and I/O waits are kept by the worker which registered them.
+ * A wait cancelled from another worker is handed over to its owner.
+ */
+class ThreadPoolLoop {
+  using Coro = std::coroutine_handle<>;
+  /**
+   * @brief How many times in a row the LIFO slot may be preferred over the
+   * deque, so that two coroutines waking each other cannot starve the rest.
+   */
+  static constexpr std::size_t max_lifo_streak{3};
+  /**
+   * @brief How many resumes a busy worker performs between timer checks.
+   */
+  static constexpr std::size_t timer_check_interval{32};
+  /**
+   * @brief Where an idle worker blocks: on its condition variable, or, if it
+   * waits for descriptors, in its reactor, woken through its eventfd.
+   */
+  enum class Parked : std::uint8_t { no, cv, reactor };
+
+  struct Worker {
+    WorkStealingDeque<Coro> deque;
+    /**
+     * @brief The coroutine woken last by this worker, run next while its data
+     * is still in cache. It is invisible to thieves.
+     */
+    Coro lifo_slot{};
+    std::size_t lifo_streak{0};
+    std::size_t ticks{0};
+    /**
+     * @brief Collects what resumed coroutines schedule, and keeps the timers
+     * registered on this worker.
+     */
+    EventLoop loop;
+    std::minstd_rand rng;
+    std::thread thread;
+    ThreadPoolLoop *pool;
+    /**
+     * @brief Under the pool's `park_mtx`.
+     */
+    Parked parked{Parked::no};
+    bool woken{false};
+    std::condition_variable cv;
+
+    Worker(ThreadPoolLoop &pool, std::size_t seed)
+        : rng{static_cast<unsigned>(seed + 1)}, pool{&pool} {}
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  /**
+   * @brief Coroutines added from outside the workers.
+   */
+  std::mutex inject_mtx;
+  std::deque<Coro> injected;
+  std::atomic<std::size_t> injected_count{0};
+  /**
+   * @brief Coroutines queued or delayed anywhere in the pool, plus the ones
+   * being resumed. The pool is finished when it drops to zero.
+   */
+  std::atomic<std::int64_t> pending{0};
+  std::mutex park_mtx;
+  std::atomic<std::size_t> idle{0};
+  /**
+   * @brief The count of live KeepAlive, plus one between start() and stop(),
+   * while which workers wait for new tasks instead of leaving when the pool
+   * runs out of work.
+   */
+  std::atomic<std::size_t> holds{0};
+  /**
+   * @brief Guards `spawned` and `started`, since run(), start(), stop() and
+   * sync_wait() may race each other.
+   */
+  std::mutex lifecycle_mtx;
+  /**
+   * @brief Whether the worker threads are up, to be joined by whoever
+   * spawned them.
+   */
+  bool spawned{false};
+  /**
+   * @brief Whether start() spawned the workers, so that stop() joins them.
+   */
+  bool start_spawned{false};
+  std::atomic<bool> started{false};
+  /**
+   * @brief Signals the end of the added tasks to Task::wait().
+   */
+  detail::TaskDoneSignal done_signal;
+
+public:
+  /**
+   * @brief Construct a pool.
+   *
+   * @param n_workers The number of worker threads, the number of hardware
+   * threads by default.
+   */
+  explicit ThreadPoolLoop(std::size_t n_workers = std::max(
+                              1u, std::thread::hardware_concurrency())) {
+    for (std::size_t i{0}; i < std::max<std::size_t>(n_workers, 1); ++i) {
+      auto &worker{
+          this->workers.emplace_back(std::make_unique<Worker>(*this, i))};
+      // Only the owner of a loop takes its posts and remote cancellations.
+      worker->loop.remote_wake = [](void *worker) {
+        auto &self{*static_cast<Worker *>(worker)};
+        self.pool->notify(self);
+      };
+      worker->loop.remote_wake_ctx = worker.get();
+    }
+  }
+  ThreadPoolLoop(const ThreadPoolLoop &) = delete;
+  auto operator=(const ThreadPoolLoop &) = delete;
+  /**
+   * @brief Stop the pool, and wait for the threads still waking its workers,
+   * whose wakeups go through the pool.
+   */
+  ~ThreadPoolLoop() {
+    this->stop();
+    for (auto &worker : this->workers) {
+      worker->loop.wait_for_posters();
+    }
+  }
+
+  std::size_t worker_count() const noexcept { return this->workers.size(); }
+  /**
+   * @brief Add a coroutine to be resumed by any worker.
+   * @param handle The coroutine handle representing the coroutine.
+   */
+  void add_task(Coro handle) {
+    this->pending.fetch_add(1, std::memory_order_relaxed);
+    {
+      std::lock_guard lk{this->inject_mtx};
+      this->injected.push_back(handle);
+      this->injected_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    this->notify_one();
+  }
+  /**
+   * @brief Add a task to be runned.
+   * @param task The task to be added.
+   */
+  template <typename T> void add_task(const Task<T> &task) {
+    task.co_hdl.promise().scheduled = true;
+    task.co_hdl.promise().done_signal = &this->done_signal;
+    this->add_task(task.co_hdl);
+  }
+  /**
+   * @brief Keeps the workers up while it lives, spawning them if they are
+   * not, e.g. for the duration of a sync_wait(). The workers it spawned are
+   * joined on its destruction, once the pool runs out of work.
+   */
+  class KeepAlive {
+    ThreadPoolLoop *pool;
+    bool spawned;
+
+  public:
+    explicit KeepAlive(ThreadPoolLoop &pool)
+        : pool{&pool}, spawned{pool.hold()} {}
+    KeepAlive(const KeepAlive &) = delete;
+    auto operator=(const KeepAlive &) = delete;
+    ~KeepAlive() { this->pool->release(this->spawned); }
+  };
+
+  /**
+   * @brief Run the pool until every added task, and everything they scheduled,
+   * is finished. Tasks should be added before, or from within the pool. If
+   * the pool was started, or is held by a KeepAlive meanwhile, it returns
+   * only once it is stopped, or released.
+   *
+   * @throw std::logic_error If the workers are already up, from start() or
+   * another run().
+   */
+  void run() {
+    {
+      std::lock_guard lk{this->lifecycle_mtx};
+      if (this->spawned) {
+        throw std::logic_error{"ThreadPoolLoop::run() while it is running"};
+      }
+      this->spawn();
+    }
+    this->join_when_finished();
+  }
+  /**
+   * @brief Start the workers in the background, where they keep waiting for
+   * tasks, e.g. from sync_wait(), until stop(). Does nothing if the pool was
+   * started already; keeps the workers of a run() waiting as well.
+   */
+  void start() {
+    std::lock_guard lk{this->lifecycle_mtx};
+    if (this->started.load(std::memory_order_relaxed)) {
+      return;
+    }
+    this->started.store(true, std::memory_order_release);
+    this->holds.fetch_add(1, std::memory_order_acq_rel);
+    if (!this->spawned) {
+      this->spawn();
+      this->start_spawned = true;
+    }
+  }
+  /**
+   * @brief Let the workers leave once the pool runs out of work, and join
+   * them if start() spawned them. Does nothing if the pool was not started.
+   */
+  void stop() {
+    bool join{false};
+    {
+      std::lock_guard lk{this->lifecycle_mtx};
+      if (!this->started.load(std::memory_order_relaxed)) {
+        return;
+      }
+      this->started.store(false, std::memory_order_release);
+      join = std::exchange(this->start_spawned, false);
+    }
+    this->release(join);
+  }
+  /**
+   * @brief Whether the pool is between start() and stop().
+   */
+  bool running() const noexcept {
+    return this->started.load(std::memory_order_acquire);
+  }
+
+private:
+  /**
+   * @return bool Whether the workers were spawned, and are to be joined by
+   * the caller through release().
+   */
+  bool hold() {
+    std::lock_guard lk{this->lifecycle_mtx};
+    this->holds.fetch_add(1, std::memory_order_acq_rel);
+    if (this->spawned) {
+      return false;
+    }
+    this->spawn();
+    return true;
+  }
+  void release(bool join) {
+    this->holds.fetch_sub(1, std::memory_order_acq_rel);
+    this->notify_all();
+    if (join) {
+      this->join_when_finished();
+    }
+  }
+  /**
+   * @brief Spawn the workers. The lifecycle lock must be held.
+   */
+  void spawn() {
+    this->spawned = true;
+    for (std::size_t i{0}; i < this->workers.size(); ++i) {
+      this->workers[i]->thread = std::thread{[this, i] { this->work(i); }};
+    }
+  }
+  void join() {
+    for (auto &worker : this->workers) {
+      worker->thread.join();
+    }
+  }
+  /**
+   * @brief Join the workers once they leave. Since they may leave right before
+   * a KeepAlive, or a task, arrives, they are spawned again if the pool has
+   * not actually run out of work by then.
+   */
+  void join_when_finished() {
+    while (true) {
+      this->join();
+      std::lock_guard lk{this->lifecycle_mtx};
+      if (this->finished()) {
+        this->spawned = false;
+        return;
+      }
+      this->spawn();
+    }
+  }
+  /**
+   * @brief Whether a worker without work should leave: nothing is pending,
+   * nor will be posted back to a worker's loop held by a WorkGuard.
+   */
+  bool finished() const noexcept {
+    return this->pending.load(std::memory_order_acquire) == 0 &&
+           this->holds.load(std::memory_order_acquire) == 0 &&
+           std::ranges::none_of(this->workers, [](auto &w) {
+             return w->loop.work_guards.load(std::memory_order_acquire) != 0;
+           });
+  }
+  void work(std::size_t index) {
+    auto &self{*this->workers[index]};
+    EventLoop::current = &self.loop;
+    self.loop.drive(true);
+    this->take_detached(self);
+    while (true) {
+      if (auto coro{this->next(self)}) {
+        this->execute(self, coro);
+      } else if (this->finished()) {
+        break;
+      } else {
+        this->park(self);
+      }
+    }
+    // Nothing is pending any more, so nothing is left to detach.
+    self.loop.drive(false);
+    EventLoop::current = nullptr;
+  }
+  /**
+   * @brief Resume a coroutine, then publish what it scheduled on the worker's
+   * loop. The last woken coroutine takes the LIFO slot.
+   */
+  void execute(Worker &self, Coro coro) {
+    auto waiting_before{self.loop.delays.size() + self.loop.io_waiting()};
+    self.loop.resume(coro);
+    // Timers may also have been cancelled, so this can be negative. That
+    // counts the nodes detached meanwhile too.
+    auto spawned{static_cast<std::int64_t>(
+        self.loop.ready_count + self.loop.delays.size() +
+        self.loop.io_waiting() - waiting_before)};
+    self.loop.detached = 0;
+    if (self.loop.ready_count != 0) {
+      // In the order of the loop's ready queue, the last one taking the LIFO
+      // slot. Priorities are not kept across the deques.
+      while (auto task{self.loop.pop_ready()}) {
+        if (self.lifo_slot) {
+          self.deque.push(self.lifo_slot);
+        }
+        self.lifo_slot = task;
+      }
+      if (!self.deque.empty()) {
+        this->notify_one();
+      }
+    }
+    if (this->pending.fetch_add(spawned - 1, std::memory_order_acq_rel) +
+            spawned - 1 ==
+        0) {
+      this->notify_all();
+    }
+  }
+  /**
+   * @brief Move every expired timer, every ready I/O waiter, every wait
+   * cancelled remotely and every post of the worker into its deque, without
+   * blocking.
+   */
+  void fire_timers(Worker &self) {
+    auto push{[&](Coro coro) { self.deque.push(coro); }};
+    std::size_t fired{self.loop.take_posted([&](Coro coro) {
+      // Posts were not counted as pending work yet.
+      this->pending.fetch_add(1, std::memory_order_relaxed);
+      push(coro);
+    })};
+    if (!self.loop.delays.empty()) {
+      auto now{std::chrono::steady_clock::now()};
+      fired += self.loop.expire_timers(now, push);
+    }
+    if (self.loop.io_waiting() != 0) {
+      fired += self.loop.reactor->poll(std::chrono::steady_clock::now(), push);
+    }
+    fired += self.loop.apply_remote(push);
+    this->take_detached(self);
+    if (fired != 0) {
+      this->notify_one();
+    }
+  }
+  /**
+   * @brief Take the timers and waits unlinked without being resumed, by
+   * `EventLoop::detach()`, off the pending work.
+   */
+  void take_detached(Worker &self) {
+    auto n{static_cast<std::int64_t>(std::exchange(self.loop.detached, 0))};
+    if (n != 0 && this->pending.fetch_sub(n, std::memory_order_acq_rel) == n) {
+      this->notify_all();
+    }
+  }
+  Coro next(Worker &self) {
+    if (++self.ticks % timer_check_interval == 0) {
+      this->fire_timers(self);
+    }
+    if (self.lifo_slot && self.lifo_streak < max_lifo_streak) {
+      ++self.lifo_streak;
+      return std::exchange(self.lifo_slot, {});
+    }
+    self.lifo_streak = 0;
+    if (auto coro{self.deque.pop()}) {
+      return *coro;
+    }
+    if (self.lifo_slot) {
+      return std::exchange(self.lifo_slot, {});
+    }
+    this->fire_timers(self);
+    if (auto coro{self.deque.pop()}) {
+      return *coro;
+    }
+    if (auto coro{this->pop_injected()}) {
+      return coro;
+    }
+    return this->steal(self);
+  }
+  Coro pop_injected() {
+    if (this->injected_count.load(std::memory_order_relaxed) == 0) {
+      return {};
+    }
+    std::lock_guard lk{this->inject_mtx};
+    if (this->injected.empty()) {
+      return {};
+    }
+    auto coro{this->injected.front()};
+    this->injected.pop_front();
+    this->injected_count.fetch_sub(1, std::memory_order_relaxed);
+    return coro;
+  }
+  /**
+   * @brief Try every other worker once, starting from a random victim.
+   */
+  Coro steal(Worker &self) {
+    auto n{this->workers.size()};
+    auto start{static_cast<std::size_t>(self.rng()) % n};
+    for (std::size_t i{0}; i < n; ++i) {
+      auto &victim{*this->workers[(start + i) % n]};
+      if (&victim == &self) {
+        continue;
+      }
+      if (auto coro{victim.deque.steal()}) {
+        return *coro;
+      }
+    }
+    return {};
+  }
+  bool has_visible_work() const {
+    if (this->injected_count.load(std::memory_order_relaxed) != 0) {
+      return true;
+    }
+    return std::ranges::any_of(this->workers,
+                               [](auto &w) { return !w->deque.empty(); });
+  }
+  /**
+   * @brief Block the worker until work is published, or its next timer is
+   * due. A worker waiting for descriptors blocks in its reactor instead, and
+   * queues what gets ready.
+   */
+  void park(Worker &self) {
+    std::unique_lock lk{this->park_mtx};
+    this->idle.fetch_add(1, std::memory_order_seq_cst);
+    std::size_t ready{0};
+    // Sequentially consistent, against the fence in notify().
+    if (!this->has_visible_work() &&
+        !self.loop.has_remote.load(std::memory_order_seq_cst) &&
+        self.loop.posted.load(std::memory_order_seq_cst) == nullptr &&
+        !this->finished()) {
+      auto awake_time{self.loop.delays.next_expiration()};
+      if (self.loop.io_waiting() != 0) {
+        self.parked = Parked::reactor;
+        lk.unlock();
+        ready = self.loop.reactor->poll(
+            awake_time, [&](Coro coro) { self.deque.push(coro); });
+        lk.lock();
+      } else {
+        self.parked = Parked::cv;
+        auto woken{[&] { return self.woken || this->finished(); }};
+        if (awake_time) {
+          self.cv.wait_until(lk, *awake_time, woken);
+        } else {
+          self.cv.wait(lk, woken);
+        }
+      }
+      self.parked = Parked::no;
+      self.woken = false;
+    }
+    this->idle.fetch_sub(1, std::memory_order_relaxed);
+    lk.unlock();
+    if (ready != 0) {
+      // Let another worker share what got ready.
+      this->notify_one();
+    }
+    this->fire_timers(self);
+  }
+  /**
+   * @brief Wake a parked worker, if any, to take the work just published.
+   */
+  void notify_one() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (this->idle.load(std::memory_order_seq_cst) == 0) {
+      return;
+    }
+    std::lock_guard lk{this->park_mtx};
+    for (auto &worker : this->workers) {
+      if (worker->parked != Parked::no && !worker->woken) {
+        this->unpark(*worker);
+        return;
+      }
+    }
+  }
+  void notify_all() {
+    std::lock_guard lk{this->park_mtx};
+    for (auto &worker : this->workers) {
+      if (worker->parked != Parked::no && !worker->woken) {
+        this->unpark(*worker);
+      }
+    }
+  }
+  /**
+   * @brief Wake the owner of a loop, for what was posted to it or cancelled
+   * on it. It checks for that before parking, under the lock.
+   */
+  void notify(Worker &worker) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (this->idle.load(std::memory_order_seq_cst) == 0) {
+      return;
+    }
+    std::lock_guard lk{this->park_mtx};
+    if (worker.parked != Parked::no && !worker.woken) {
+      this->unpark(worker);
+    }
+  }
+  /**
+   * @brief `park_mtx` must be held.
+   */
+  void unpark(Worker &worker) {
+    worker.woken = true;
+    if (worker.parked == Parked::reactor) {
+      worker.loop.reactor->notify();
+    } else {
+      worker.cv.notify_one();
+    }
+  }
+};
+} // namespace cocos
+#endif // COCOS_THREADPOOL
@@ -0,0 +1,312 @@
+#ifndef COCOS_TIMER_WHEEL
+#define COCOS_TIMER_WHEEL
+#include <array>
+#include <bit>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+namespace cocos {
+class EventLoop;
+class TimerWheel;
+/**
+ * @brief An intrusive timer entry. It usually lives in the awaiter on the
+ * sleeping coroutine's frame, so registering a timer never allocates.
+ *
+ * A linked node unlinks itself when destroyed, which must happen on the
+ * thread driving its wheel; a node which may be destroyed elsewhere is
+ * detached through `EventLoop::detach()` first. A copy of a node is never
+ * linked.
+ */
+struct TimerNode {
+  std::coroutine_handle<> coro{};
+  std::chrono::time_point<std::chrono::steady_clock> awake_time{};
+
+  TimerNode() = default;
+  TimerNode(std::coroutine_handle<> hdl,
+            std::chrono::time_point<std::chrono::steady_clock> time)
+      : coro{hdl}, awake_time{time} {}
+  TimerNode(const TimerNode &other)
+      : coro{other.coro}, awake_time{other.awake_time} {}
+  TimerNode &operator=(const TimerNode &other) {
+    this->coro = other.coro;
+    this->awake_time = other.awake_time;
+    return *this;
+  }
+  inline ~TimerNode();
+  bool linked() const noexcept { return this->wheel != nullptr; }
+
+private:
+  friend class EventLoop;
+  friend class TimerWheel;
+  TimerNode *prev{nullptr};
+  TimerNode *next{nullptr};
+  TimerWheel *wheel{nullptr};
+  std::uint64_t tick{0};
+  std::uint8_t level{0};
+  std::uint8_t slot{0};
+  /**
+   * @brief Whether the node belongs to the EventLoop rather than an awaiter.
+   */
+  bool pooled{false};
+};
+
+/**
+ * @brief A hashed hierarchical timing wheel.
+ *
+ * Time is counted in ticks of a configurable granularity. Level `l` has 64
+ * slots of 64^l ticks each, and a timer is hashed into the lowest level where
+ * its expiry tick shares the higher digits with the current tick. Inserting
+ * and cancelling are O(1); expiring takes every timer of a slot in one pass,
+ * cascading the ones of higher levels down. A per-level occupancy bitmap finds
+ * the next non-empty slot without walking empty ticks.
+ *
+ * Timers never fire early: an awake time is rounded up to the next tick.
+ */
+class TimerWheel {
+public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr std::size_t slot_bits{6};
+  static constexpr std::size_t slots_per_level{1 << slot_bits};
+  static constexpr std::size_t levels{6};
+
+private:
+  static constexpr std::uint8_t expired_level{levels};
+  static constexpr std::uint64_t slot_mask{slots_per_level - 1};
+  static constexpr std::uint64_t max_ticks{
+      (std::uint64_t{1} << (slot_bits * levels)) - 1};
+
+  Clock::time_point origin;
+  Clock::duration tick;
+  /**
+   * @brief The current tick. Every timer in the wheel expires after it.
+   */
+  std::uint64_t elapsed{0};
+  std::array<std::uint64_t, levels> occupied{};
+  std::array<std::array<TimerNode *, slots_per_level>, levels> slots{};
+  /**
+   * @brief Timers inserted with an awake time not after the current tick.
+   */
+  TimerNode *expired{nullptr};
+  std::size_t count{0};
+
+  struct Expiration {
+    std::uint8_t level;
+    std::uint8_t slot;
+    std::uint64_t deadline;
+  };
+
+public:
+  /**
+   * @param tick The granularity of the wheel.
+   * @param origin The time of tick zero.
+   */
+  explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds{1},
+                      Clock::time_point origin = Clock::now())
+      : origin{origin}, tick{tick} {}
+  TimerWheel(const TimerWheel &) = delete;
+  auto operator=(const TimerWheel &) = delete;
+  ~TimerWheel() {
+    for (auto &level : this->slots) {
+      for (auto head : level) {
+        TimerWheel::detach_all(head);
+      }
+    }
+    TimerWheel::detach_all(this->expired);
+  }
+
+  std::size_t size() const noexcept { return this->count; }
+  bool empty() const noexcept { return this->count == 0; }
+  Clock::duration granularity() const noexcept { return this->tick; }
+  /**
+   * @brief Register a timer, which expires at `node.awake_time`.
+   */
+  void insert(TimerNode &node) {
+    if (node.linked()) {
+      node.wheel->cancel(node);
+    }
+    node.wheel = this;
+    node.tick = this->tick_ceil(node.awake_time);
+    ++this->count;
+    this->link(node);
+  }
+  /**
+   * @brief Unregister a timer, if it is still pending.
+   */
+  void cancel(TimerNode &node) noexcept {
+    if (node.wheel != this) {
+      return;
+    }
+    this->unlink(node);
+    node.wheel = nullptr;
+    --this->count;
+  }
+  /**
+   * @brief The time at which the earliest non-empty slot is due, which is not
+   * before any awake time in that slot.
+   *
+   * @return std::nullopt if no timer is pending.
+   */
+  std::optional<Clock::time_point> next_expiration() const noexcept {
+    if (this->expired) {
+      return this->time_of(this->elapsed);
+    }
+    if (auto e{this->next_slot()}) {
+      return this->time_of(e->deadline);
+    }
+    return std::nullopt;
+  }
+  /**
+   * @brief Advance the wheel to `now`, and hand every timer due by then to
+   * `on_fire`. Each node is unlinked before it is handed over.
+   *
+   * @param now The current time.
+   * @param on_fire Called with the `TimerNode &` of each expired timer.
+   * @return std::size_t The count of expired timers.
+   */
+  template <typename F> std::size_t expire(Clock::time_point now, F &&on_fire) {
+    std::size_t fired{0};
+    fired += this->fire_list(std::exchange(this->expired, nullptr), on_fire);
+    auto now_tick{this->tick_floor(now)};
+    while (auto e{this->next_slot()}) {
+      if (e->deadline > now_tick) {
+        break;
+      }
+      auto head{std::exchange(this->slots[e->level][e->slot], nullptr)};
+      this->occupied[e->level] &= ~(std::uint64_t{1} << e->slot);
+      this->elapsed = e->deadline;
+      while (head) {
+        auto node{std::exchange(head, head->next)};
+        if (node->tick <= this->elapsed) {
+          node->next = nullptr;
+          fired += this->fire_list(node, on_fire);
+        } else {
+          this->link(*node);
+        }
+      }
+    }
+    if (now_tick > this->elapsed) {
+      this->elapsed = now_tick;
+    }
+    return fired;
+  }
+
+private:
+  Clock::time_point time_of(std::uint64_t t) const noexcept {
+    return this->origin + this->tick * static_cast<Clock::rep>(t);
+  }
+  std::uint64_t tick_floor(Clock::time_point time) const noexcept {
+    if (time <= this->origin) {
+      return 0;
+    }
+    return static_cast<std::uint64_t>((time - this->origin) / this->tick);
+  }
+  std::uint64_t tick_ceil(Clock::time_point time) const noexcept {
+    auto t{this->tick_floor(time)};
+    return this->time_of(t) < time ? t + 1 : t;
+  }
+  /**
+   * @brief The lowest level where `when` and the current tick share every
+   * higher digit.
+   */
+  std::uint8_t level_for(std::uint64_t when) const noexcept {
+    auto masked{((this->elapsed ^ when) | slot_mask)};
+    if (masked > max_ticks) {
+      masked = max_ticks;
+    }
+    auto significant{63 - std::countl_zero(masked)};
+    return static_cast<std::uint8_t>(significant / slot_bits);
+  }
+  void link(TimerNode &node) noexcept {
+    TimerNode **head{&this->expired};
+    if (node.tick <= this->elapsed) {
+      node.level = expired_level;
+    } else {
+      node.level = this->level_for(node.tick);
+      node.slot = static_cast<std::uint8_t>(
+          (node.tick >> (node.level * slot_bits)) & slot_mask);
+      head = &this->slots[node.level][node.slot];
+      this->occupied[node.level] |= std::uint64_t{1} << node.slot;
+    }
+    node.prev = nullptr;
+    node.next = *head;
+    if (node.next) {
+      node.next->prev = &node;
+    }
+    *head = &node;
+  }
+  void unlink(TimerNode &node) noexcept {
+    if (node.next) {
+      node.next->prev = node.prev;
+    }
+    if (node.prev) {
+      node.prev->next = node.next;
+    } else if (node.level == expired_level) {
+      this->expired = node.next;
+    } else {
+      auto &head{this->slots[node.level][node.slot]};
+      head = node.next;
+      if (!head) {
+        this->occupied[node.level] &= ~(std::uint64_t{1} << node.slot);
+      }
+    }
+    node.prev = node.next = nullptr;
+  }
+  std::optional<Expiration> next_slot() const noexcept {
+    for (std::uint8_t level{0}; level < levels; ++level) {
+      auto bits{this->occupied[level]};
+      if (bits == 0) {
+        continue;
+      }
+      auto shift{level * slot_bits};
+      auto slot_range{std::uint64_t{1} << shift};
+      auto level_range{slot_range << slot_bits};
+      auto now_slot{static_cast<int>((this->elapsed >> shift) & slot_mask)};
+      auto rotated{std::rotr(bits, now_slot)};
+      if (rotated != 1) {
+        // Only the top level can hold timers in the current slot, which are
+        // the ones beyond its range and so are visited last.
+        rotated &= ~std::uint64_t{1};
+      }
+      auto slot{(now_slot + std::countr_zero(rotated)) %
+                static_cast<int>(slots_per_level)};
+      auto deadline{(this->elapsed & ~(level_range - 1)) +
+                    static_cast<std::uint64_t>(slot) * slot_range};
+      if (deadline <= this->elapsed) {
+        deadline += level_range;
+      }
+      return Expiration{level, static_cast<std::uint8_t>(slot), deadline};
+    }
+    return std::nullopt;
+  }
+  template <typename F> std::size_t fire_list(TimerNode *head, F &on_fire) {
+    std::size_t fired{0};
+    while (head) {
+      auto node{std::exchange(head, head->next)};
+      node->prev = node->next = nullptr;
+      node->wheel = nullptr;
+      --this->count;
+      ++fired;
+      on_fire(*node);
+    }
+    return fired;
+  }
+  static void detach_all(TimerNode *head) noexcept {
+    while (head) {
+      auto node{std::exchange(head, head->next)};
+      node->prev = node->next = nullptr;
+      node->wheel = nullptr;
+    }
+  }
+};
+
+inline TimerNode::~TimerNode() {
+  if (this->wheel) {
+    this->wheel->cancel(*this);
+  }
+}
+} // namespace cocos
+#endif // COCOS_TIMER_WHEEL
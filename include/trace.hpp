@@ -0,0 +1,250 @@
+#ifndef COCOS_TRACE
+#define COCOS_TRACE
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/**
+ * Define COCOS_TRACING to 1, for every translation unit of a program alike,
+ * to count what the loops do and record trace events. Otherwise the hooks are
+ * empty inline functions, and loops carry no counters.
+ */
+#ifndef COCOS_TRACING
+#define COCOS_TRACING 0
+#endif
+
+namespace cocos {
+/**
+ * @brief A histogram of durations with buckets of logarithmic width, each
+ * power of two split in 16 linear sub-buckets, as HdrHistogram does: values
+ * are kept within 1/16 of their magnitude, from 1ns to centuries, in a fixed
+ * array.
+ */
+class LatencyHistogram {
+  static constexpr unsigned sub_bits{4};
+  static constexpr std::size_t sub_buckets{std::size_t{1} << sub_bits};
+  static constexpr std::size_t buckets{(64 - sub_bits + 1) * sub_buckets};
+
+  std::array<std::uint64_t, buckets> counts{};
+  std::uint64_t total{0};
+  std::uint64_t sum{0};
+  std::uint64_t largest{0};
+
+  static std::size_t index_of(std::uint64_t ns) noexcept {
+    if (ns < sub_buckets) {
+      return ns;
+    }
+    auto shift{static_cast<unsigned>(std::bit_width(ns)) - 1 - sub_bits};
+    return (shift + 1) * sub_buckets + ((ns >> shift) - sub_buckets);
+  }
+  static std::uint64_t lower_bound(std::size_t index) noexcept {
+    if (index < sub_buckets) {
+      return index;
+    }
+    auto shift{index / sub_buckets - 1};
+    return (index % sub_buckets + sub_buckets) << shift;
+  }
+
+public:
+  void record(std::chrono::nanoseconds duration) noexcept {
+    auto ns{static_cast<std::uint64_t>(
+        std::max<std::chrono::nanoseconds::rep>(duration.count(), 0))};
+    ++this->counts[index_of(ns)];
+    ++this->total;
+    this->sum += ns;
+    this->largest = std::max(this->largest, ns);
+  }
+  std::uint64_t count() const noexcept { return this->total; }
+  std::chrono::nanoseconds max() const noexcept {
+    return std::chrono::nanoseconds{this->largest};
+  }
+  std::chrono::nanoseconds mean() const noexcept {
+    return std::chrono::nanoseconds{this->total ? this->sum / this->total : 0};
+  }
+  /**
+   * @brief The smallest recorded value that `p` of them are at most, as the
+   * lower bound of its bucket.
+   *
+   * @param p In [0, 1], e.g. 0.99.
+   */
+  std::chrono::nanoseconds percentile(double p) const noexcept {
+    auto rank{std::max<std::uint64_t>(
+        static_cast<std::uint64_t>(p * static_cast<double>(this->total)), 1)};
+    std::uint64_t seen{0};
+    for (std::size_t i{0}; i < buckets; ++i) {
+      seen += this->counts[i];
+      if (seen >= rank) {
+        return std::chrono::nanoseconds{lower_bound(i)};
+      }
+    }
+    return this->max();
+  }
+  void reset() noexcept { *this = {}; }
+};
+
+/**
+ * @brief What a loop counts while COCOS_TRACING is on.
+ */
+struct LoopStats {
+  std::uint64_t resumes{0};
+  std::uint64_t timer_fires{0};
+  std::uint64_t posts{0};
+  /**
+   * @brief The most coroutines ever waiting on the ready queue at once.
+   */
+  std::size_t ready_high_water{0};
+  /**
+   * @brief How long each resume ran until the coroutine suspended again.
+   */
+  LatencyHistogram resume_time;
+  /**
+   * @brief How late each timer fired after its awake time.
+   */
+  LatencyHistogram timer_lateness;
+};
+
+/**
+ * @brief Records trace events of coroutines into per-thread buffers, and
+ * writes them in the Chrome trace event format, which Perfetto and
+ * chrome://tracing load. Events are only recorded between start() and
+ * stop(), and only while COCOS_TRACING is on.
+ */
+class TraceRecorder {
+  struct Event {
+    const char *name;
+    const void *coro;
+    std::int64_t ts;
+    char phase;
+  };
+  struct Buffer {
+    std::uint32_t tid;
+    std::vector<Event> events;
+  };
+
+  std::mutex mtx;
+  /**
+   * @brief Shared with the threads, so that the events of a thread which has
+   * left are kept.
+   */
+  std::vector<std::shared_ptr<Buffer>> buffers;
+  std::atomic<bool> recording{false};
+  std::atomic<std::uint32_t> next_tid{1};
+  /**
+   * @brief The time of start(), which event timestamps are relative to.
+   */
+  std::atomic<std::int64_t> origin{0};
+
+  static std::int64_t now_ns() noexcept {
+    auto since_epoch{std::chrono::steady_clock::now().time_since_epoch()};
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch)
+        .count();
+  }
+
+  TraceRecorder() = default;
+
+public:
+  TraceRecorder(const TraceRecorder &) = delete;
+  auto operator=(const TraceRecorder &) = delete;
+
+  static TraceRecorder &get() {
+    static TraceRecorder recorder;
+    return recorder;
+  }
+  void start() noexcept {
+    this->origin.store(now_ns(), std::memory_order_relaxed);
+    this->recording.store(true);
+  }
+  void stop() noexcept { this->recording.store(false); }
+  bool is_recording() const noexcept {
+    return this->recording.load(std::memory_order_relaxed);
+  }
+  /**
+   * @brief Record an event of the calling thread, dropped on allocation
+   * failure.
+   *
+   * @param phase 'B' and 'E' for the begin and end of a resume, 'i' for an
+   * instant, e.g. the creation of a task.
+   * @param name A string literal.
+   */
+  void record(char phase, const char *name, const void *coro) noexcept {
+    if (!this->is_recording()) {
+      return;
+    }
+    try {
+      this->local().events.push_back(
+          {name, coro,
+           now_ns() - this->origin.load(std::memory_order_relaxed), phase});
+    } catch (...) {
+    }
+  }
+  /**
+   * @brief Write every recorded event as a JSON object. Recording must be
+   * stopped, and the threads which recorded done with their last event.
+   */
+  void write_json(std::ostream &out) {
+    std::lock_guard lk{this->mtx};
+    out << "{\"traceEvents\":[";
+    auto first{true};
+    for (auto &buffer : this->buffers) {
+      for (auto &e : buffer->events) {
+        out << (first ? "\n" : ",\n") << "{\"name\":\"" << e.name
+            << "\",\"cat\":\"cocos\",\"ph\":\"" << e.phase
+            << "\",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":";
+        // Microseconds, to the nanosecond.
+        auto ns{e.ts % 1000};
+        out << e.ts / 1000 << (ns < 10 ? ".00" : ns < 100 ? ".0" : ".") << ns;
+        if (e.phase == 'i') {
+          out << ",\"s\":\"t\"";
+        }
+        out << ",\"args\":{\"coro\":\"" << e.coro << "\"}}";
+        first = false;
+      }
+    }
+    out << "\n]}\n";
+  }
+  /**
+   * @brief Drop the recorded events.
+   */
+  void clear() {
+    std::lock_guard lk{this->mtx};
+    for (auto &buffer : this->buffers) {
+      buffer->events.clear();
+    }
+  }
+
+private:
+  Buffer &local() {
+    static thread_local std::shared_ptr<Buffer> buffer;
+    if (!buffer) {
+      auto fresh{std::make_shared<Buffer>(
+          this->next_tid.fetch_add(1, std::memory_order_relaxed))};
+      std::lock_guard lk{this->mtx};
+      this->buffers.push_back(fresh);
+      buffer = std::move(fresh);
+    }
+    return *buffer;
+  }
+};
+
+namespace trace {
+/**
+ * @brief Record a trace event, or nothing at all while COCOS_TRACING is off.
+ */
+inline void event([[maybe_unused]] char phase,
+                  [[maybe_unused]] const char *name,
+                  [[maybe_unused]] const void *coro) noexcept {
+#if COCOS_TRACING
+  TraceRecorder::get().record(phase, name, coro);
+#endif
+}
+} // namespace trace
+} // namespace cocos
+#endif // COCOS_TRACE
@@ -0,0 +1,253 @@
+#ifndef COCOS_WHEN_ALL
+#define COCOS_WHEN_ALL
+#include "frame_allocator.hpp"
+#include "task.hpp"
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <stop_token>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace cocos {
+namespace detail {
+/**
+ * @brief What awaiting a Task<T> produces in a combined result, where a void
+ * result is represented by std::monostate.
+ */
+template <typename T>
+using WhenResult = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+/**
+ * @brief Counts the children still running, plus one for the awaiting
+ * coroutine until it has started them all. Whoever brings it to zero resumes
+ * the awaiting coroutine, or keeps it from suspending.
+ */
+class WhenAllLatch {
+  std::atomic<std::size_t> count;
+  std::coroutine_handle<> awaiting{};
+
+public:
+  explicit WhenAllLatch(std::size_t n) : count{n + 1} {}
+  /**
+   * @brief Only a latch nobody waits on yet may be moved.
+   */
+  WhenAllLatch(WhenAllLatch &&other) noexcept
+      : count{other.count.load(std::memory_order_relaxed)} {}
+  /**
+   * @return true if the awaiting coroutine should suspend.
+   */
+  bool try_await(std::coroutine_handle<> hdl) noexcept {
+    this->awaiting = hdl;
+    return this->count.fetch_sub(1, std::memory_order_acq_rel) > 1;
+  }
+  /**
+   * @return std::coroutine_handle<> The awaiting coroutine if the last child
+   * has finished.
+   */
+  std::coroutine_handle<> notify() noexcept {
+    if (this->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      return this->awaiting;
+    }
+    return std::noop_coroutine();
+  }
+};
+
+template <typename T> class WhenAllTask;
+
+template <typename T> struct WhenAllPromise : PooledPromise {
+  WhenAllLatch *latch{nullptr};
+  std::stop_token stop_token{};
+  std::variant<std::monostate, WhenResult<T>, std::exception_ptr> result;
+
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<WhenAllPromise> hdl) noexcept {
+      return hdl.promise().latch->notify();
+    }
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  /**
+   * @brief The child inherits the stop token of the when_all.
+   */
+  template <typename U> TaskAwaiter<U> await_transform(Task<U> &&t) noexcept {
+    TaskAwaiter<U> awaiter{std::move(t)};
+    awaiter.set_stop_token(this->stop_token);
+    return awaiter;
+  }
+  WhenAllTask<T> get_return_object() {
+    return WhenAllTask<T>{
+        std::coroutine_handle<WhenAllPromise>::from_promise(*this)};
+  }
+  void unhandled_exception() {
+    this->result.template emplace<2>(std::current_exception());
+  }
+  template <typename U> void return_value(U &&value) {
+    this->result.template emplace<1>(std::forward<U>(value));
+  }
+};
+
+/**
+ * @brief Runs one child of a when_all, and reports to the latch when it is
+ * finished.
+ */
+template <typename T> class WhenAllTask {
+public:
+  using promise_type = WhenAllPromise<T>;
+  using THandle = std::coroutine_handle<promise_type>;
+
+  explicit WhenAllTask(THandle hdl) : co_hdl{hdl} {}
+  WhenAllTask(WhenAllTask &&other) noexcept
+      : co_hdl{std::exchange(other.co_hdl, {})} {}
+  WhenAllTask(const WhenAllTask &) = delete;
+  auto operator=(const WhenAllTask &) = delete;
+  ~WhenAllTask() {
+    if (this->co_hdl) {
+      this->co_hdl.destroy();
+    }
+  }
+  void start(WhenAllLatch &latch, const std::stop_token &token) {
+    this->co_hdl.promise().latch = &latch;
+    this->co_hdl.promise().stop_token = token;
+    this->co_hdl.resume();
+  }
+  /**
+   * @brief The result of the finished child, or throw its exception.
+   */
+  WhenResult<T> &&result() {
+    auto &result{this->co_hdl.promise().result};
+    if (result.index() == 2) {
+      std::rethrow_exception(std::get<2>(result));
+    }
+    return std::get<1>(std::move(result));
+  }
+
+private:
+  THandle co_hdl;
+};
+
+template <typename T> WhenAllTask<T> make_when_all_task(Task<T> task) {
+  if constexpr (std::is_void_v<T>) {
+    co_await std::move(task);
+    co_return std::monostate{};
+  } else {
+    co_return co_await std::move(task);
+  }
+}
+} // namespace detail
+
+/**
+ * @brief Awaits a fixed set of tasks of possibly different types.
+ */
+template <typename... T> class WhenAllAwaiter {
+  std::tuple<detail::WhenAllTask<T>...> tasks;
+  detail::WhenAllLatch latch{sizeof...(T)};
+  std::stop_token token{};
+
+public:
+  explicit WhenAllAwaiter(Task<T>... ts)
+      : tasks{detail::make_when_all_task(std::move(ts))...} {}
+  /**
+   * @brief The tasks are cancelled together with the awaiting task.
+   */
+  void set_stop_token(std::stop_token stop_token) noexcept {
+    this->token = std::move(stop_token);
+  }
+  bool await_ready() const noexcept { return sizeof...(T) == 0; }
+  /**
+   * @brief Start every task, and suspend unless they have all finished
+   * already.
+   */
+  bool await_suspend(std::coroutine_handle<> hdl) {
+    std::apply(
+        [this](auto &...t) { (t.start(this->latch, this->token), ...); },
+        this->tasks);
+    return this->latch.try_await(hdl);
+  }
+  /**
+   * @return The results in the order of the tasks. If any task has thrown,
+   * the exception of the first such task is rethrown.
+   */
+  std::tuple<detail::WhenResult<T>...> await_resume() {
+    return std::apply(
+        [](auto &...t) {
+          return std::tuple<detail::WhenResult<T>...>{t.result()...};
+        },
+        this->tasks);
+  }
+};
+
+/**
+ * @brief Awaits a range of tasks of the same type.
+ */
+template <typename T> class WhenAllRangeAwaiter {
+  std::vector<detail::WhenAllTask<T>> tasks;
+  detail::WhenAllLatch latch;
+  std::stop_token token{};
+
+public:
+  explicit WhenAllRangeAwaiter(std::vector<Task<T>> ts) : latch{ts.size()} {
+    this->tasks.reserve(ts.size());
+    for (auto &t : ts) {
+      this->tasks.push_back(detail::make_when_all_task(std::move(t)));
+    }
+  }
+  void set_stop_token(std::stop_token stop_token) noexcept {
+    this->token = std::move(stop_token);
+  }
+  bool await_ready() const noexcept { return this->tasks.empty(); }
+  bool await_suspend(std::coroutine_handle<> hdl) {
+    for (auto &t : this->tasks) {
+      t.start(this->latch, this->token);
+    }
+    return this->latch.try_await(hdl);
+  }
+  /**
+   * @return The results in the order of the tasks, or nothing for Task<void>.
+   * If any task has thrown, the exception of the first such task is rethrown.
+   */
+  auto await_resume() {
+    if constexpr (std::is_void_v<T>) {
+      for (auto &t : this->tasks) {
+        t.result();
+      }
+    } else {
+      std::vector<T> results;
+      results.reserve(this->tasks.size());
+      for (auto &t : this->tasks) {
+        results.push_back(t.result());
+      }
+      return results;
+    }
+  }
+};
+
+/**
+ * @brief Run the tasks concurrently, and resume the awaiting coroutine when
+ * every one of them has finished.
+ *
+ * @return An awaiter producing a `std::tuple` of the results, where a
+ * Task<void> contributes a std::monostate.
+ */
+template <typename... T> WhenAllAwaiter<T...> when_all(Task<T>... tasks) {
+  return WhenAllAwaiter<T...>{std::move(tasks)...};
+}
+/**
+ * @brief The same as above, but for a range of tasks of the same type.
+ *
+ * @return An awaiter producing a `std::vector<T>` of the results.
+ */
+template <typename T>
+WhenAllRangeAwaiter<T> when_all(std::vector<Task<T>> tasks) {
+  return WhenAllRangeAwaiter<T>{std::move(tasks)};
+}
+} // namespace cocos
+#endif // COCOS_WHEN_ALL
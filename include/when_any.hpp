@@ -0,0 +1,277 @@
+#ifndef COCOS_WHEN_ANY
+#define COCOS_WHEN_ANY
+#include "cancellation.hpp"
+#include "frame_allocator.hpp"
+#include "task.hpp"
+#include "when_all.hpp"
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <stop_token>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace cocos {
+namespace detail {
+/**
+ * @brief Shared by a when_any and its children, since the children which lose
+ * the race may still run after the awaiting coroutine has been resumed.
+ */
+template <typename R> struct WhenAnyState {
+  std::atomic<bool> decided{false};
+  /**
+   * @brief Two parties, the winner and the awaiting coroutine once it has
+   * started every child. The second one to arrive resumes the other.
+   */
+  std::atomic<int> gate{2};
+  std::coroutine_handle<> awaiting{};
+  std::size_t index{0};
+  std::variant<std::monostate, R, std::exception_ptr> result;
+  /**
+   * @brief Cancels the losers once the race is decided.
+   */
+  std::stop_source stop{};
+
+  /**
+   * @return true if the caller finished first, and should store its result.
+   */
+  bool try_win(std::size_t i) noexcept {
+    if (this->decided.exchange(true, std::memory_order_acq_rel)) {
+      return false;
+    }
+    this->index = i;
+    return true;
+  }
+  /**
+   * @brief Store the result of the winner, cancel the others, and arrive.
+   */
+  template <std::size_t I, typename... Args>
+  std::coroutine_handle<> win(Args &&...args) noexcept {
+    try {
+      this->result.template emplace<I>(std::forward<Args>(args)...);
+    } catch (...) {
+      this->result.template emplace<2>(std::current_exception());
+    }
+    this->stop.request_stop();
+    return this->arrive();
+  }
+  std::coroutine_handle<> arrive() noexcept {
+    if (this->gate.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      return this->awaiting;
+    }
+    return {};
+  }
+};
+
+/**
+ * @brief A child of a when_any, which destroys itself when it finishes. Its
+ * body returns the coroutine to transfer to, if any.
+ */
+struct WhenAnyTask {
+  struct promise_type : PooledPromise {
+    std::coroutine_handle<> next{};
+
+    struct FinalAwaiter {
+      bool await_ready() const noexcept { return false; }
+      std::coroutine_handle<>
+      await_suspend(std::coroutine_handle<promise_type> hdl) noexcept {
+        auto next{hdl.promise().next};
+        hdl.destroy();
+        return next ? next : std::noop_coroutine();
+      }
+      void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    WhenAnyTask get_return_object() {
+      return WhenAnyTask{
+          std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    void unhandled_exception() noexcept { std::terminate(); }
+    void return_value(std::coroutine_handle<> hdl) noexcept {
+      this->next = hdl;
+    }
+  };
+  std::coroutine_handle<promise_type> co_hdl;
+};
+
+/**
+ * @brief Marks a child of the range form, whose result is stored as is rather
+ * than as an alternative of a variant.
+ */
+inline constexpr std::size_t range_child{static_cast<std::size_t>(-1)};
+
+template <std::size_t I, typename R, typename T>
+WhenAnyTask make_when_any_task(Task<T> task,
+                               std::shared_ptr<WhenAnyState<R>> state,
+                               std::size_t index) {
+  if (!task.get_stop_token().stop_possible()) {
+    task.set_stop_token(state->stop.get_token());
+  }
+  try {
+    if constexpr (std::is_void_v<T>) {
+      co_await std::move(task);
+      if (!state->try_win(index)) {
+        co_return {};
+      }
+      if constexpr (I == range_child) {
+        co_return state->template win<1>();
+      } else {
+        co_return state->template win<1>(std::in_place_index<I>);
+      }
+    } else {
+      auto value{co_await std::move(task)};
+      if (!state->try_win(index)) {
+        co_return {};
+      }
+      if constexpr (I == range_child) {
+        co_return state->template win<1>(std::move(value));
+      } else {
+        co_return state->template win<1>(std::in_place_index<I>,
+                                         std::move(value));
+      }
+    }
+  } catch (...) {
+    if (!state->try_win(index)) {
+      co_return {};
+    }
+    co_return state->template win<2>(std::current_exception());
+  }
+}
+
+template <typename R> class WhenAnyAwaiterBase {
+protected:
+  std::shared_ptr<WhenAnyState<R>> state{
+      std::make_shared<WhenAnyState<R>>()};
+  std::vector<WhenAnyTask> children;
+  std::stop_token token{};
+  StopCallbackSlot<StopForwarder> on_stop{};
+
+  WhenAnyAwaiterBase() = default;
+  WhenAnyAwaiterBase(WhenAnyAwaiterBase &&) noexcept = default;
+  ~WhenAnyAwaiterBase() {
+    // Children which were never started.
+    for (auto child : this->children) {
+      child.co_hdl.destroy();
+    }
+  }
+
+public:
+  /**
+   * @brief A stop request on the awaiting task cancels every child.
+   */
+  void set_stop_token(std::stop_token stop_token) noexcept {
+    this->token = std::move(stop_token);
+  }
+  bool await_ready() const noexcept { return false; }
+  /**
+   * @brief Start every task, and suspend unless one of them has finished
+   * already.
+   */
+  bool await_suspend(std::coroutine_handle<> hdl) {
+    this->state->awaiting = hdl;
+    if (this->token.stop_possible()) {
+      this->on_stop.emplace(this->token, {&this->state->stop});
+    }
+    auto children{std::move(this->children)};
+    this->children.clear();
+    for (auto child : children) {
+      child.co_hdl.resume();
+    }
+    return !this->state->arrive();
+  }
+  /**
+   * @return The index of the first finished task and its result. If it has
+   * thrown, its exception is rethrown.
+   */
+  std::pair<std::size_t, R> await_resume() {
+    this->on_stop.reset();
+    auto &result{this->state->result};
+    if (result.index() == 2) {
+      std::rethrow_exception(std::get<2>(result));
+    }
+    return {this->state->index, std::get<1>(std::move(result))};
+  }
+};
+} // namespace detail
+
+/**
+ * @brief Awaits the first of a fixed set of tasks of possibly different types.
+ */
+template <typename... T>
+class WhenAnyAwaiter
+    : public detail::WhenAnyAwaiterBase<
+          std::variant<detail::WhenResult<T>...>> {
+  using R = std::variant<detail::WhenResult<T>...>;
+
+public:
+  explicit WhenAnyAwaiter(Task<T>... ts) {
+    this->children.reserve(sizeof...(T));
+    this->add(std::index_sequence_for<T...>{}, std::move(ts)...);
+  }
+
+private:
+  template <std::size_t... I>
+  void add(std::index_sequence<I...>, Task<T>... ts) {
+    (this->children.push_back(
+         detail::make_when_any_task<I, R>(std::move(ts), this->state, I)),
+     ...);
+  }
+};
+
+/**
+ * @brief Awaits the first of a range of tasks of the same type.
+ */
+template <typename T>
+class WhenAnyRangeAwaiter
+    : public detail::WhenAnyAwaiterBase<detail::WhenResult<T>> {
+  using R = detail::WhenResult<T>;
+
+public:
+  explicit WhenAnyRangeAwaiter(std::vector<Task<T>> ts) {
+    this->children.reserve(ts.size());
+    for (std::size_t i{0}; i < ts.size(); ++i) {
+      this->children.push_back(
+          detail::make_when_any_task<detail::range_child, R>(
+              std::move(ts[i]), this->state, i));
+    }
+  }
+};
+
+/**
+ * @brief Run the tasks concurrently, and resume the awaiting coroutine as
+ * soon as one of them has finished. The others are cancelled through their
+ * stop token, unless they were given one of their own, and are left to wind
+ * down on the loop.
+ *
+ * @return An awaiter producing the index of the first finished task and its
+ * result, as a `std::variant` with one alternative per task.
+ */
+template <typename... T> WhenAnyAwaiter<T...> when_any(Task<T>... tasks) {
+  static_assert(sizeof...(T) > 0, "when_any of no task would never finish");
+  return WhenAnyAwaiter<T...>{std::move(tasks)...};
+}
+/**
+ * @brief The same as above, but for a non-empty range of tasks of the same
+ * type.
+ *
+ * @return An awaiter producing the index of the first finished task and its
+ * result.
+ * @throw std::invalid_argument If the range is empty, since the awaiter would
+ * never finish.
+ */
+template <typename T>
+WhenAnyRangeAwaiter<T> when_any(std::vector<Task<T>> tasks) {
+  if (tasks.empty()) {
+    throw std::invalid_argument{"when_any of no task would never finish"};
+  }
+  return WhenAnyRangeAwaiter<T>{std::move(tasks)};
+}
+} // namespace cocos
+#endif // COCOS_WHEN_ANY
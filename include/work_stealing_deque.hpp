@@ -0,0 +1,148 @@
+#ifndef COCOS_WORK_STEALING_DEQUE
+#define COCOS_WORK_STEALING_DEQUE
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+namespace cocos {
+/**
+ * @brief A Chase-Lev work-stealing deque.
+ *
+ * The owning thread pushes and pops at the bottom, any other thread may steal
+ * from the top. The memory orderings follow Lê et al., "Correct and Efficient
+ * Work-Stealing for Weak Memory Models" (PPoPP'13).
+ *
+ * @tparam T A trivially copyable element type, e.g. a coroutine handle.
+ */
+template <typename T> class WorkStealingDeque {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "elements are copied racily, so they must be trivial");
+
+  struct Array {
+    std::int64_t capacity;
+    std::int64_t mask;
+    std::unique_ptr<std::atomic<T>[]> slots;
+
+    explicit Array(std::int64_t cap)
+        : capacity{cap}, mask{cap - 1},
+          slots{std::make_unique<std::atomic<T>[]>(cap)} {}
+    T load(std::int64_t i) const noexcept {
+      return this->slots[i & this->mask].load(std::memory_order_relaxed);
+    }
+    void store(std::int64_t i, T value) noexcept {
+      this->slots[i & this->mask].store(value, std::memory_order_relaxed);
+    }
+    /**
+     * @brief Copy the live range [top, bottom) into an array twice as large.
+     */
+    std::unique_ptr<Array> grow(std::int64_t top, std::int64_t bottom) const {
+      auto bigger{std::make_unique<Array>(this->capacity * 2)};
+      for (auto i{top}; i != bottom; ++i) {
+        bigger->store(i, this->load(i));
+      }
+      return bigger;
+    }
+  };
+
+  alignas(64) std::atomic<std::int64_t> top{0};
+  alignas(64) std::atomic<std::int64_t> bottom{0};
+  alignas(64) std::atomic<Array *> array;
+  /**
+   * @brief Arrays replaced by grow() may still be read by a concurrent thief,
+   * so they are kept alive until the deque itself is destroyed.
+   */
+  std::vector<std::unique_ptr<Array>> arrays;
+
+public:
+  /**
+   * @param capacity The initial capacity, rounded up to a power of two.
+   */
+  explicit WorkStealingDeque(std::size_t capacity = 256) {
+    std::int64_t cap{1};
+    while (cap < static_cast<std::int64_t>(capacity)) {
+      cap <<= 1;
+    }
+    this->arrays.push_back(std::make_unique<Array>(cap));
+    this->array.store(this->arrays.back().get(), std::memory_order_relaxed);
+  }
+  WorkStealingDeque(const WorkStealingDeque &) = delete;
+  auto operator=(const WorkStealingDeque &) = delete;
+
+  /**
+   * @brief Push an element at the bottom. Only the owner may call this.
+   */
+  void push(T value) {
+    auto b{this->bottom.load(std::memory_order_relaxed)};
+    auto t{this->top.load(std::memory_order_acquire)};
+    auto a{this->array.load(std::memory_order_relaxed)};
+    if (b - t > a->capacity - 1) {
+      this->arrays.push_back(a->grow(t, b));
+      a = this->arrays.back().get();
+      this->array.store(a, std::memory_order_release);
+    }
+    a->store(b, value);
+    this->bottom.store(b + 1, std::memory_order_release);
+  }
+  /**
+   * @brief Pop the most recently pushed element. Only the owner may call this.
+   *
+   * @return std::nullopt if the deque is empty or the last element was stolen.
+   */
+  std::optional<T> pop() {
+    auto b{this->bottom.load(std::memory_order_relaxed) - 1};
+    auto a{this->array.load(std::memory_order_relaxed)};
+    this->bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t{this->top.load(std::memory_order_relaxed)};
+    if (t > b) {
+      this->bottom.store(b + 1, std::memory_order_relaxed);
+      return std::nullopt;
+    }
+    auto value{a->load(b)};
+    if (t == b) {
+      // The last element, race against thieves for it.
+      auto won{this->top.compare_exchange_strong(t, t + 1,
+                                                 std::memory_order_seq_cst,
+                                                 std::memory_order_relaxed)};
+      this->bottom.store(b + 1, std::memory_order_relaxed);
+      if (!won) {
+        return std::nullopt;
+      }
+    }
+    return value;
+  }
+  /**
+   * @brief Steal the oldest element. Any thread may call this.
+   *
+   * @return std::nullopt if the deque is empty or another thief won the race.
+   */
+  std::optional<T> steal() {
+    auto t{this->top.load(std::memory_order_acquire)};
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b{this->bottom.load(std::memory_order_acquire)};
+    if (t >= b) {
+      return std::nullopt;
+    }
+    auto value{this->array.load(std::memory_order_acquire)->load(t)};
+    if (!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                           std::memory_order_relaxed)) {
+      return std::nullopt;
+    }
+    return value;
+  }
+  /**
+   * @brief A racy estimate of the element count, exact for the owner.
+   */
+  std::size_t size() const noexcept {
+    auto b{this->bottom.load(std::memory_order_relaxed)};
+    auto t{this->top.load(std::memory_order_relaxed)};
+    return b > t ? static_cast<std::size_t>(b - t) : 0;
+  }
+  bool empty() const noexcept { return this->size() == 0; }
+};
+} // namespace cocos
+#endif // COCOS_WORK_STEALING_DEQUE
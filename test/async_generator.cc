@@ -0,0 +1,158 @@
+#include "../include/async_generator.hpp"
+#include "../include/sleep.hpp"
+#include "../include/sync_wait.hpp"
+#include "../include/task.hpp"
+#include "check.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+using namespace std::chrono_literals;
+
+/**
+ * @brief Yields 0, 1, 2, ... up to `n` exclusive, sleeping `delay` before
+ * each, counting the elements produced, and throws at `fail_at` if given.
+ */
+cocos::AsyncGenerator<int> counting(int n, int &produced,
+                                    std::chrono::milliseconds delay = 0ms,
+                                    int fail_at = -1) {
+  for (int i{0}; i < n; ++i) {
+    if (delay != 0ms) {
+      co_await cocos::sleep(delay);
+    }
+    if (i == fail_at) {
+      throw std::runtime_error{"producer"};
+    }
+    ++produced;
+    co_yield i;
+  }
+}
+
+/**
+ * @brief For each element taken, how many more the producer had produced.
+ */
+cocos::Task<std::vector<int>> leads(cocos::AsyncGenerator<int> gen,
+                                    int &produced) {
+  std::vector<int> result;
+  int taken{0};
+  while (auto val{co_await gen.next()}) {
+    COCOS_CHECK(*val == taken);
+    ++taken;
+    result.push_back(produced - taken);
+  }
+  co_return result;
+}
+
+/**
+ * @brief Without prefetch the producer runs only for the element awaited;
+ * with prefetch(k) it runs up to k elements ahead, and no further.
+ */
+void run_ahead() {
+  int produced{0};
+  auto lazy{cocos::sync_wait(leads(counting(10, produced), produced))};
+  COCOS_CHECK(lazy == std::vector<int>(10, 0));
+
+  for (std::size_t k : {1, 3, 16}) {
+    produced = 0;
+    auto ahead{cocos::sync_wait(
+        leads(counting(10, produced).prefetch(k), produced))};
+    COCOS_CHECK(ahead.size() == 10);
+    auto most{std::min(static_cast<int>(k), 10 - 1)};
+    COCOS_CHECK(std::ranges::max(ahead) == most);
+    // Nothing is left to prefetch towards the end.
+    COCOS_CHECK(ahead.back() == 0);
+  }
+}
+
+/**
+ * @brief A prefetching producer sleeps while the consumer works, so that it
+ * has its next element ready when the consumer comes back for it.
+ */
+void overlap() {
+  auto consume{[](cocos::AsyncGenerator<int> gen,
+                  int &produced) -> cocos::Task<int> {
+    int ready{0};
+    int taken{0};
+    while (auto val{co_await gen.next()}) {
+      ++taken;
+      co_await cocos::sleep(10ms);
+      ready += produced > taken;
+    }
+    co_return ready;
+  }};
+  int produced{0};
+  auto start{cocos::now()};
+  auto lazy_ready{cocos::sync_wait(consume(counting(6, produced, 2ms),
+                                           produced))};
+  auto lazy{cocos::now() - start};
+  COCOS_CHECK(lazy_ready == 0);
+
+  produced = 0;
+  start = cocos::now();
+  auto ready{cocos::sync_wait(consume(counting(6, produced, 2ms).prefetch(2),
+                                      produced))};
+  auto prefetched{cocos::now() - start};
+  // All but the last, after which there is nothing more.
+  COCOS_CHECK(ready == 5);
+  COCOS_CHECK(prefetched < lazy);
+}
+
+/**
+ * @brief What the producer throws comes after the elements it yielded
+ * before, however many were prefetched.
+ */
+void errors() {
+  auto collect{[](cocos::AsyncGenerator<int> gen,
+                  std::vector<int> &seen) -> cocos::Task<bool> {
+    try {
+      while (auto val{co_await gen.next()}) {
+        seen.push_back(*val);
+      }
+    } catch (const std::runtime_error &) {
+      co_return true;
+    }
+    co_return false;
+  }};
+  for (std::size_t k : {1, 2, 8}) {
+    for (auto delay : {0ms, 1ms}) {
+      int produced{0};
+      std::vector<int> seen;
+      COCOS_CHECK(cocos::sync_wait(
+          collect(counting(10, produced, delay, 4).prefetch(k), seen)));
+      COCOS_CHECK((seen == std::vector{0, 1, 2, 3}));
+    }
+  }
+}
+
+/**
+ * @brief The adaptors, on a lazy source which take() does not pull past its
+ * last element.
+ */
+void adaptors() {
+  auto collect{[](cocos::AsyncGenerator<int> gen)
+                   -> cocos::Task<std::vector<int>> {
+    std::vector<int> seen;
+    while (auto val{co_await gen.next()}) {
+      seen.push_back(*val);
+    }
+    co_return seen;
+  }};
+  int produced{0};
+  auto seen{cocos::sync_wait(collect(counting(100, produced, 1ms)
+                                         .filter([](int v) { return v % 3; })
+                                         .map([](int &v) { return v * 2; })
+                                         .take(4)))};
+  COCOS_CHECK((seen == std::vector{2, 4, 8, 10}));
+  COCOS_CHECK(produced == 6);
+}
+} // namespace
+
+int main() {
+  run_ahead();
+  overlap();
+  errors();
+  adaptors();
+}
@@ -0,0 +1,290 @@
+#include "../include/cancellation.hpp"
+#include "../include/channel.hpp"
+#include "../include/eventloop.hpp"
+#include "../include/sleep.hpp"
+#include "../include/task.hpp"
+#include "../include/threadpool.hpp"
+#include "../include/when_any.hpp"
+#include "check.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace {
+cocos::Task<> produce(cocos::Channel<int> &ch, int first, int count) {
+  for (int i{first}; i < first + count; ++i) {
+    COCOS_CHECK(co_await ch.send(i));
+  }
+}
+cocos::Task<std::vector<int>> consume(cocos::Channel<int> &ch) {
+  std::vector<int> values;
+  while (auto value{co_await ch.recv()}) {
+    values.push_back(*value);
+  }
+  co_return values;
+}
+
+/**
+ * @brief Values come out in the order they went in, through a channel much
+ * smaller than the stream, so that both sides park.
+ */
+void fifo() {
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::Channel<int> ch{4};
+  auto consumer{consume(ch)};
+  auto producer{[](cocos::Channel<int> &ch) -> cocos::Task<> {
+    co_await produce(ch, 0, 1000);
+    ch.close();
+  }(ch)};
+  loop.add_task(consumer);
+  loop.add_task(producer);
+  loop.run();
+  auto &values{consumer.wait()};
+  COCOS_CHECK(values.size() == 1000);
+  for (int i{0}; i < 1000; ++i) {
+    COCOS_CHECK(values[i] == i);
+  }
+}
+
+/**
+ * @brief Closing refuses new values, but the ones already sent are still
+ * received before the end.
+ */
+void close_drains() {
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::Channel<int> ch{8};
+  for (int i{0}; i < 3; ++i) {
+    COCOS_CHECK(ch.try_send(i));
+  }
+  ch.close();
+  COCOS_CHECK(ch.closed() && !ch.try_send(3));
+  auto consumer{consume(ch)};
+  auto sender{[](cocos::Channel<int> &ch) -> cocos::Task<bool> {
+    co_return co_await ch.send(4);
+  }(ch)};
+  loop.add_task(consumer);
+  loop.add_task(sender);
+  loop.run();
+  COCOS_CHECK((consumer.wait() == std::vector{0, 1, 2}));
+  COCOS_CHECK(!sender.wait());
+}
+
+/**
+ * @brief Closing wakes the coroutines parked on both sides.
+ */
+void close_wakes_parked() {
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::Channel<int> empty{2};
+  cocos::Channel<int> full{2};
+  while (full.try_send(0)) {
+  }
+  auto receiver{consume(empty)};
+  auto sender{[](cocos::Channel<int> &ch) -> cocos::Task<bool> {
+    co_return co_await ch.send(1);
+  }(full)};
+  auto closer{[](cocos::Channel<int> &a,
+                 cocos::Channel<int> &b) -> cocos::Task<> {
+    a.close();
+    b.close();
+    co_return;
+  }(empty, full)};
+  loop.add_task(receiver);
+  loop.add_task(sender);
+  loop.add_task(closer);
+  loop.run();
+  COCOS_CHECK(receiver.wait().empty());
+  COCOS_CHECK(!sender.wait());
+}
+
+/**
+ * @brief A stop request unparks a receiver and a sender, which throw
+ * Cancelled, and leave the channel as it was.
+ */
+void cancel_parked() {
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::Channel<int> empty{2};
+  cocos::Channel<int> full{2};
+  while (full.try_send(0)) {
+  }
+  std::stop_source stop;
+  int cancelled{0};
+  auto receiver{[](cocos::Channel<int> &ch, int &cancelled) -> cocos::Task<> {
+    try {
+      co_await ch.recv();
+    } catch (const cocos::Cancelled &) {
+      ++cancelled;
+    }
+  }(empty, cancelled)};
+  auto sender{[](cocos::Channel<int> &ch, int &cancelled) -> cocos::Task<> {
+    try {
+      co_await ch.send(1);
+    } catch (const cocos::Cancelled &) {
+      ++cancelled;
+    }
+  }(full, cancelled)};
+  receiver.set_stop_token(stop.get_token());
+  sender.set_stop_token(stop.get_token());
+  auto stopper{[](std::stop_source &stop) -> cocos::Task<> {
+    stop.request_stop();
+    co_return;
+  }(stop)};
+  loop.add_task(receiver);
+  loop.add_task(sender);
+  loop.add_task(stopper);
+  loop.run();
+  COCOS_CHECK(cancelled == 2);
+  COCOS_CHECK(full.size() == 2 && empty.size() == 0);
+  // Nobody is parked any more.
+  COCOS_CHECK(empty.try_send(3) && empty.try_recv() == 3);
+  COCOS_CHECK(full.try_recv() == 0 && full.try_send(4));
+}
+
+/**
+ * @brief A when_any over a receive which never completes finishes with the
+ * other task, and the receive is cancelled rather than pinning the loop.
+ */
+void when_any_loser() {
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::Channel<int> ch{2};
+  auto race{[](cocos::Channel<int> &ch) -> cocos::Task<std::size_t> {
+    auto [index, result]{co_await cocos::when_any(
+        consume(ch), []() -> cocos::Task<int> {
+          co_await cocos::sleep(std::chrono::milliseconds{1});
+          co_return 7;
+        }())};
+    COCOS_CHECK(std::get<1>(result) == 7);
+    co_return index;
+  }(ch)};
+  loop.add_task(race);
+  loop.run();
+  COCOS_CHECK(race.wait() == 1);
+  COCOS_CHECK(ch.try_send(1) && ch.try_recv() == 1);
+}
+
+/**
+ * @brief A parked receiver destroyed along with its coroutine leaves the
+ * channel, so that a value sent later is not handed to it.
+ */
+void destroy_parked() {
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::Channel<int> ch{2};
+  std::optional<cocos::Task<std::vector<int>>> receiver{consume(ch)};
+  auto destroyer{[](std::optional<cocos::Task<std::vector<int>>> &receiver)
+                     -> cocos::Task<> {
+    receiver.reset();
+    co_return;
+  }(receiver)};
+  loop.add_task(*receiver);
+  loop.add_task(destroyer);
+  loop.run();
+  COCOS_CHECK(!receiver);
+  COCOS_CHECK(ch.try_send(1) && ch.try_recv() == 1);
+}
+
+/**
+ * @brief Producers and consumers on a pool: every value is received exactly
+ * once, and each consumer sees the values of a producer in order.
+ */
+void mpmc_pool() {
+  constexpr int producers{4};
+  constexpr int consumers{4};
+  constexpr int per_producer{20'000};
+  cocos::ThreadPoolLoop pool{4};
+  cocos::Channel<int> ch{16};
+  std::atomic<int> remaining{producers};
+  std::vector<cocos::Task<>> sending;
+  std::vector<cocos::Task<std::vector<int>>> receiving;
+  for (int p{0}; p < producers; ++p) {
+    sending.push_back([](cocos::Channel<int> &ch, std::atomic<int> &remaining,
+                         int first) -> cocos::Task<> {
+      co_await produce(ch, first, per_producer);
+      if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        ch.close();
+      }
+    }(ch, remaining, p * per_producer));
+  }
+  for (int c{0}; c < consumers; ++c) {
+    receiving.push_back(consume(ch));
+  }
+  for (auto &task : receiving) {
+    pool.add_task(task);
+  }
+  for (auto &task : sending) {
+    pool.add_task(task);
+  }
+  pool.run();
+  std::vector<int> seen(producers * per_producer);
+  for (auto &task : receiving) {
+    std::vector<int> last(producers, -1);
+    for (auto value : task.wait()) {
+      ++seen[value];
+      auto &previous{last[value / per_producer]};
+      COCOS_CHECK(value > previous);
+      previous = value;
+    }
+  }
+  for (auto count : seen) {
+    COCOS_CHECK(count == 1);
+  }
+}
+
+/**
+ * @brief A try_send() racing with close() either succeeds before it, and its
+ * value is received before the end, or fails: once a receiver saw the
+ * channel closed and then empty, nothing more comes.
+ */
+void send_close_race() {
+  constexpr int senders{3};
+  for (int round{0}; round < 50; ++round) {
+    cocos::Channel<int> ch{8};
+    std::atomic<int> sent{0};
+    std::vector<std::thread> threads;
+    for (int t{0}; t < senders; ++t) {
+      threads.emplace_back([&] {
+        for (int v{0}; !ch.closed(); ++v) {
+          if (ch.try_send(v)) {
+            sent.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      });
+    }
+    int received{0};
+    std::thread receiver{[&] {
+      while (true) {
+        auto was_closed{ch.closed()};
+        if (ch.try_recv()) {
+          ++received;
+        } else if (was_closed) {
+          break;
+        }
+      }
+    }};
+    std::this_thread::sleep_for(std::chrono::microseconds{round % 50});
+    ch.close();
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    receiver.join();
+    COCOS_CHECK(received == sent.load());
+    COCOS_CHECK(!ch.try_recv());
+  }
+}
+} // namespace
+
+int main() {
+  fifo();
+  close_drains();
+  close_wakes_parked();
+  cancel_parked();
+  when_any_loser();
+  destroy_parked();
+  for (int round{0}; round < 5; ++round) {
+    mpmc_pool();
+  }
+  send_close_race();
+}
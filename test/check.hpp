@@ -0,0 +1,18 @@
+#ifndef COCOS_TEST_CHECK
+#define COCOS_TEST_CHECK
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * @brief Abort with the failed condition. Unlike assert(), it holds whatever
+ * NDEBUG is, since the tests are built as Release by default.
+ */
+#define COCOS_CHECK(cond)                                                      \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,   \
+                   #cond);                                                     \
+      std::abort();                                                            \
+    }                                                                          \
+  } while (false)
+#endif // COCOS_TEST_CHECK
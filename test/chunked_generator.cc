@@ -0,0 +1,140 @@
+#include "../include/chunked_generator.hpp"
+#include "check.hpp"
+#include <cstddef>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+/**
+ * @brief How the producer yields: a run of single elements, or a span.
+ */
+struct Step {
+  int singles{0};
+  std::span<const int> batch{};
+};
+
+/**
+ * @brief Yield the steps in order, counting the single elements from 1000,
+ * then throw if asked to.
+ */
+template <std::size_t N>
+cocos::ChunkedGenerator<int, N> produce(std::vector<Step> steps,
+                                        bool fail = false) {
+  int next{1000};
+  for (auto step : steps) {
+    for (int i{0}; i < step.singles; ++i) {
+      co_yield next++;
+    }
+    if (!step.batch.empty()) {
+      co_yield step.batch;
+    }
+  }
+  if (fail) {
+    throw std::runtime_error{"producer"};
+  }
+}
+
+/**
+ * @brief The sizes of the chunks, and whether each is a view of `batch`.
+ */
+template <std::size_t N>
+std::vector<std::pair<std::size_t, bool>>
+chunks(cocos::ChunkedGenerator<int, N> gen, std::span<const int> batch) {
+  std::vector<std::pair<std::size_t, bool>> result;
+  while (gen.move_next()) {
+    auto chunk{gen.current_chunk()};
+    result.emplace_back(chunk.size(), chunk.data() == batch.data());
+  }
+  return result;
+}
+
+using Chunks = std::vector<std::pair<std::size_t, bool>>;
+
+/**
+ * @brief A span which fits the rest of the buffer is copied into the chunk,
+ * one which does not is handed over as a chunk of its own after the partial
+ * one, and one of at least N elements is never copied.
+ */
+void spills() {
+  std::vector<int> values(20);
+  std::iota(values.begin(), values.end(), 0);
+  std::span<const int> all{values};
+  // Fits after two singles: 2 + 3 of 8.
+  COCOS_CHECK((chunks(produce<8>({{2, all.first(3)}, {1, {}}}), all) ==
+               Chunks{{6, false}}));
+  // Does not fit after five singles: 5 + 4 > 8.
+  COCOS_CHECK((chunks(produce<8>({{5, all.first(4)}, {2, {}}}), all) ==
+               Chunks{{5, false}, {4, true}, {2, false}}));
+  // Larger than the buffer, after a partial chunk and on an empty buffer.
+  COCOS_CHECK((chunks(produce<8>({{3, all}, {0, all}}), all) ==
+               Chunks{{3, false}, {20, true}, {20, true}}));
+  // Exactly the size of the buffer, which is empty.
+  COCOS_CHECK((chunks(produce<8>({{0, all.first(8)}, {8, {}}}), all) ==
+               Chunks{{8, true}, {8, false}}));
+  // The elements come in order, whatever the chunks.
+  std::vector<int> seen;
+  produce<8>({{5, all.first(4)}, {1, all}}).for_each([&](int val) {
+    seen.push_back(val);
+  });
+  std::vector<int> expected{1000, 1001, 1002, 1003, 1004, 0, 1, 2, 3, 1005};
+  expected.insert(expected.end(), values.begin(), values.end());
+  COCOS_CHECK(seen == expected);
+}
+
+/**
+ * @brief An exception of the producer is rethrown once the elements yielded
+ * before it were handed over, whether in a partial chunk or a spilled span,
+ * and the generator is exhausted afterwards.
+ */
+void error_order() {
+  std::vector<int> values(12, 7);
+  std::span<const int> all{values};
+  for (auto steps : {std::vector<Step>{{3, {}}},
+                     std::vector<Step>{{2, all}},
+                     std::vector<Step>{{0, {}}}}) {
+    auto gen{produce<8>(steps, true)};
+    std::size_t handed{0};
+    bool thrown{false};
+    try {
+      while (gen.move_next()) {
+        handed += gen.current_chunk().size();
+      }
+    } catch (const std::runtime_error &) {
+      thrown = true;
+    }
+    COCOS_CHECK(thrown);
+    auto yielded{static_cast<std::size_t>(steps[0].singles) +
+                 steps[0].batch.size()};
+    COCOS_CHECK(handed == yielded);
+    COCOS_CHECK(!gen.move_next());
+  }
+}
+
+/**
+ * @brief map() splits a spilled chunk larger than the buffer into chunks of
+ * at most N.
+ */
+void map_spilled() {
+  std::vector<int> values(20, 1);
+  auto gen{produce<8>({{1, values}}).map([](int val) { return val * 2; })};
+  std::vector<std::size_t> sizes;
+  int total{0};
+  while (gen.move_next()) {
+    sizes.push_back(gen.current_chunk().size());
+    for (auto val : gen.current_chunk()) {
+      total += val;
+    }
+  }
+  COCOS_CHECK((sizes == std::vector<std::size_t>{1, 8, 8, 4}));
+  COCOS_CHECK(total == 2000 + 40);
+}
+} // namespace
+
+int main() {
+  spills();
+  error_order();
+  map_spilled();
+}
@@ -0,0 +1,109 @@
+#include "../include/eventloop.hpp"
+#include "../include/io.hpp"
+#include "../include/sleep.hpp"
+#include "../include/task.hpp"
+#include "../include/threadpool.hpp"
+#include "check.hpp"
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <optional>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+using namespace std::chrono_literals;
+
+/**
+ * @brief Counts the coroutines suspended by the wrapped awaiter, once they
+ * are, so that another thread may destroy them.
+ */
+template <typename A> struct Counted {
+  A awaiter;
+  std::atomic<int> *suspended;
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> hdl) {
+    this->awaiter.await_suspend(hdl);
+    this->suspended->fetch_add(1, std::memory_order_release);
+  }
+  void await_resume() { this->awaiter.await_resume(); }
+};
+
+cocos::Task<> sleeper(std::atomic<int> &suspended) {
+  co_await Counted{cocos::sleep(1h), &suspended};
+  COCOS_CHECK(false);
+}
+cocos::Task<> reader(int fd, std::atomic<int> &suspended) {
+  co_await Counted{cocos::readable(fd), &suspended};
+  COCOS_CHECK(false);
+}
+
+void wait_suspended(const std::atomic<int> &suspended, int n) {
+  while (suspended.load(std::memory_order_acquire) != n) {
+    std::this_thread::yield();
+  }
+}
+
+/**
+ * @brief Coroutines waiting for timers and descriptors on the workers of a
+ * running pool, destroyed from the main thread: the workers unlink the
+ * waits, and the pool runs out of work once they are gone.
+ */
+void destroy_on_pool() {
+  int fds[2];
+  COCOS_CHECK(::pipe(fds) == 0);
+  cocos::ThreadPoolLoop pool{2};
+  std::atomic<int> suspended{0};
+  std::optional<std::vector<cocos::Task<>>> tasks{std::in_place};
+  for (int i{0}; i < 4; ++i) {
+    tasks->push_back(sleeper(suspended));
+  }
+  tasks->push_back(reader(fds[0], suspended));
+  pool.start();
+  for (auto &task : *tasks) {
+    pool.add_task(task);
+  }
+  wait_suspended(suspended, 5);
+  tasks.reset();
+  // Returns only once the pool has no pending work left.
+  pool.stop();
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+/**
+ * @brief A coroutine sleeping on a loop driven by another thread, destroyed
+ * from the main thread, and one on a loop nobody drives any more.
+ */
+void destroy_on_loop() {
+  cocos::EventLoop loop;
+  std::atomic<int> suspended{0};
+  std::optional<cocos::Task<>> task{sleeper(suspended)};
+  std::optional<cocos::EventLoop::WorkGuard> guard{std::in_place, loop};
+  std::thread driver{[&] {
+    loop.add_task(*task);
+    loop.run();
+  }};
+  wait_suspended(suspended, 1);
+  task.reset();
+  guard.reset();
+  driver.join();
+
+  std::optional<cocos::Task<>> idle{sleeper(suspended)};
+  std::thread{[&] {
+    loop.add_task(*idle);
+    loop.run_until([&] { return suspended.load() == 2; });
+  }}.join();
+  idle.reset();
+  // Nothing is left for the loop to wait for.
+  loop.run();
+}
+} // namespace
+
+int main() {
+  for (int round{0}; round < 5; ++round) {
+    destroy_on_pool();
+  }
+  destroy_on_loop();
+}
@@ -0,0 +1,188 @@
+#include "../include/generator.hpp"
+#include "check.hpp"
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+/**
+ * @brief Counts the frames alive, whose locals it is.
+ */
+struct Alive {
+  int &count;
+  explicit Alive(int &count) : count{count} { ++count; }
+  Alive(const Alive &) = delete;
+  auto operator=(const Alive &) = delete;
+  ~Alive() { --count; }
+};
+
+/**
+ * @brief Yields n, n - 1, ..., 0, each from a generator of its own, delegating
+ * to the next one down.
+ */
+cocos::Generator<int> chain(int n, int &alive) {
+  Alive guard{alive};
+  co_yield n;
+  if (n != 0) {
+    co_yield cocos::elements_of(chain(n - 1, alive));
+  }
+}
+
+/**
+ * @brief Yields lo, ..., hi - 1 by an in-order walk of the halves, with a
+ * generator for each node.
+ */
+cocos::Generator<int> walk(int lo, int hi) {
+  if (hi - lo == 1) {
+    co_yield lo;
+    co_return;
+  }
+  auto mid{lo + (hi - lo) / 2};
+  co_yield cocos::elements_of(walk(lo, mid));
+  co_yield cocos::elements_of(walk(mid, hi));
+}
+
+/**
+ * @brief Yields 0, 1, ... `n` - 1, then throws if asked to.
+ */
+cocos::Generator<int> upto(int n, bool fail) {
+  for (int i{0}; i < n; ++i) {
+    co_yield i;
+  }
+  if (fail) {
+    throw std::runtime_error{"nested"};
+  }
+}
+
+/**
+ * @brief Delegates through `depth` generators to upto(n, fail), yielding
+ * -1 around it at each level.
+ */
+cocos::Generator<int> around(int depth, int n, bool fail) {
+  co_yield -1;
+  if (depth == 0) {
+    co_yield cocos::elements_of(upto(n, fail));
+  } else {
+    co_yield cocos::elements_of(around(depth - 1, n, fail));
+  }
+  co_yield -1;
+}
+
+/**
+ * @brief Nested generators yield in order, however deep, and the stack of
+ * frames unwinds when they finish, or when the consumer stops early.
+ */
+void deep() {
+  int alive{0};
+  constexpr int depth{10'000};
+  int expected{depth};
+  for (auto v : chain(depth, alive)) {
+    COCOS_CHECK(v == expected);
+    --expected;
+  }
+  COCOS_CHECK(expected == -1);
+  COCOS_CHECK(alive == 0);
+
+  {
+    auto gen{chain(depth, alive)};
+    for (auto v : gen) {
+      if (v == depth / 2) {
+        break;
+      }
+    }
+    COCOS_CHECK(alive == depth / 2 + 1);
+  }
+  COCOS_CHECK(alive == 0);
+
+  std::vector<int> walked;
+  for (auto v : walk(0, 1000)) {
+    walked.push_back(v);
+  }
+  COCOS_CHECK(walked.size() == 1000);
+  for (int i{0}; i < 1000; ++i) {
+    COCOS_CHECK(walked[i] == i);
+  }
+}
+
+/**
+ * @brief What a nested generator throws comes out at the consumer after the
+ * elements before it, unless a generator on the way catches it and goes on.
+ */
+void exceptions() {
+  std::vector<int> seen;
+  try {
+    for (auto v : around(3, 2, true)) {
+      seen.push_back(v);
+    }
+    COCOS_CHECK(false);
+  } catch (const std::runtime_error &) {
+  }
+  COCOS_CHECK((seen == std::vector{-1, -1, -1, -1, 0, 1}));
+
+  // move_next() stops there too, and current_value() throws it.
+  auto gen{around(2, 1, true)};
+  int count{0};
+  while (gen.move_next()) {
+    ++count;
+  }
+  COCOS_CHECK(count == 4);
+  try {
+    gen.current_value();
+    COCOS_CHECK(false);
+  } catch (const std::runtime_error &) {
+  }
+
+  auto catching{[]() -> cocos::Generator<int> {
+    auto caught{false};
+    try {
+      co_yield cocos::elements_of(around(2, 3, true));
+    } catch (const std::runtime_error &) {
+      caught = true;
+    }
+    co_yield caught ? 100 : 0;
+    co_yield 200;
+  }};
+  seen.clear();
+  for (auto v : catching()) {
+    seen.push_back(v);
+  }
+  COCOS_CHECK((seen == std::vector{-1, -1, -1, 0, 1, 2, 100, 200}));
+}
+
+/**
+ * @brief A generator delegated to after it was partly consumed goes on where
+ * it was, and an exhausted or empty one yields nothing.
+ */
+void partly_consumed() {
+  auto outer{[](cocos::Generator<int> inner) -> cocos::Generator<int> {
+    co_yield 10;
+    co_yield cocos::elements_of(std::move(inner));
+    co_yield cocos::elements_of(upto(0, false));
+    co_yield 20;
+  }};
+  auto inner{around(1, 3, false)};
+  COCOS_CHECK(inner.move_next() && inner.current_value() == -1);
+  COCOS_CHECK(inner.move_next() && inner.current_value() == -1);
+  COCOS_CHECK(inner.move_next() && inner.current_value() == 0);
+  std::vector<int> seen;
+  for (auto v : outer(std::move(inner))) {
+    seen.push_back(v);
+  }
+  COCOS_CHECK((seen == std::vector{10, 1, 2, -1, -1, 20}));
+
+  auto done{upto(1, false)};
+  while (done.move_next()) {
+  }
+  seen.clear();
+  for (auto v : outer(std::move(done))) {
+    seen.push_back(v);
+  }
+  COCOS_CHECK((seen == std::vector{10, 20}));
+}
+} // namespace
+
+int main() {
+  deep();
+  exceptions();
+  partly_consumed();
+}
@@ -0,0 +1,223 @@
+#include "../include/async_generator.hpp"
+#include "../include/eventloop.hpp"
+#include "../include/file.hpp"
+#include "../include/offload.hpp"
+#include "../include/sleep.hpp"
+#include "../include/task.hpp"
+#include "check.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <latch>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+/**
+ * @brief A temporary file with the given content, removed on destruction.
+ */
+class TempFile {
+  std::string file_path{"/tmp/cocos_test_XXXXXX"};
+
+public:
+  explicit TempFile(std::string_view content) {
+    auto fd{::mkstemp(this->file_path.data())};
+    COCOS_CHECK(fd >= 0);
+    COCOS_CHECK(::write(fd, content.data(), content.size()) ==
+                static_cast<ssize_t>(content.size()));
+    ::close(fd);
+  }
+  TempFile(const TempFile &) = delete;
+  auto operator=(const TempFile &) = delete;
+  ~TempFile() { ::unlink(this->file_path.c_str()); }
+  const std::string &path() const noexcept { return this->file_path; }
+};
+
+/**
+ * @brief Holds the only thread of a pool until released, so that the reads
+ * queued behind it stay in flight.
+ */
+struct Blocker : cocos::detail::OffloadJob {
+  std::latch released{1};
+
+  Blocker() {
+    this->run = [](cocos::detail::OffloadJob &job) noexcept {
+      static_cast<Blocker &>(job).released.wait();
+    };
+  }
+};
+
+/**
+ * @brief Lines of 16 bytes, so that chunks of 16 bytes hold one line each.
+ */
+std::string fixed_lines(int count) {
+  std::string text;
+  for (int i{0}; i < count; ++i) {
+    text += "line " + std::to_string(1'000'000'000 + i) + "\n";
+  }
+  return text;
+}
+
+/**
+ * @brief Copy every value of a generator of chunks() or lines(), each valid
+ * only until the next one.
+ */
+cocos::Task<std::vector<std::string>>
+collect(cocos::AsyncGenerator<std::string_view> source) {
+  std::vector<std::string> values;
+  while (auto value{co_await source.next()}) {
+    values.emplace_back(*value);
+  }
+  co_return values;
+}
+std::vector<std::string>
+run_collect(cocos::AsyncGenerator<std::string_view> source) {
+  auto &loop{cocos::EventLoop::get_loop()};
+  auto task{collect(std::move(source))};
+  loop.add_task(task);
+  loop.run();
+  return task.wait();
+}
+
+/**
+ * @brief The last chunk holds what is left of a file which is not a
+ * multiple of the size, and no empty chunk follows a file which is.
+ */
+void chunk_tails() {
+  TempFile file{fixed_lines(2) + "tail"};
+  COCOS_CHECK((run_collect(cocos::chunks(file.path(), 16, 2)) ==
+               std::vector<std::string>{"line 1000000000\n",
+                                        "line 1000000001\n", "tail"}));
+  TempFile exact{fixed_lines(3)};
+  COCOS_CHECK(run_collect(cocos::chunks(exact.path(), 16, 4)).size() == 3);
+  TempFile empty{""};
+  COCOS_CHECK(run_collect(cocos::chunks(empty.path(), 16, 2)).empty());
+  COCOS_CHECK(run_collect(cocos::lines(empty.path(), 16, 2)).empty());
+}
+
+/**
+ * @brief Lines spanning two chunks or more come whole, empty lines are kept,
+ * and the last one comes without a final '\n'.
+ */
+void line_edges() {
+  TempFile file{"a\n\nspanning several chunks\nlast"};
+  for (std::size_t size : {1, 3, 4, 64}) {
+    COCOS_CHECK(
+        (run_collect(cocos::lines(file.path(), size, 2)) ==
+         std::vector<std::string>{"a", "", "spanning several chunks", "last"}));
+  }
+  TempFile ended{"x\n"};
+  COCOS_CHECK((run_collect(cocos::lines(ended.path(), 4, 2)) ==
+               std::vector<std::string>{"x"}));
+}
+
+/**
+ * @brief A file which cannot be opened throws from the first next().
+ */
+void open_failure() {
+  for (auto lines : {false, true}) {
+    auto path{std::string{"/nonexistent/cocos_test"}};
+    auto source{lines ? cocos::lines(path) : cocos::chunks(path)};
+    try {
+      run_collect(std::move(source));
+      COCOS_CHECK(false);
+    } catch (const std::system_error &e) {
+      COCOS_CHECK(e.code() == std::errc::no_such_file_or_directory);
+    }
+  }
+}
+
+/**
+ * @brief chunks() and lines() read through a custom FileBackend, here one
+ * completing each read inline, before start() returns.
+ */
+void custom_backend() {
+  TempFile file{fixed_lines(4) + "end"};
+  int submitted{0};
+  cocos::FileBackend inline_backend{
+      &submitted, [](void *submitted, cocos::detail::FileReadJob &job) {
+        ++*static_cast<int *>(submitted);
+        job.complete(cocos::detail::read_at(job.fd, job.offset, job.buf),
+                     nullptr);
+      }};
+  auto lines{run_collect(cocos::lines(file.path(), 16, 2, inline_backend))};
+  COCOS_CHECK(lines.size() == 5 && lines[3] == "line 1000000003" &&
+              lines[4] == "end");
+  // One read per chunk, and the one past the end.
+  COCOS_CHECK(submitted == 6);
+}
+
+/**
+ * @brief Destroy chunks() after a chunk, while the read of a later one is in
+ * flight and nobody awaits it.
+ */
+void destroy_while_running() {
+  TempFile file{fixed_lines(8)};
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::BlockingPool pool{1};
+  Blocker blocker;
+  auto consumer{[](const std::string &path, cocos::BlockingPool &pool,
+                   Blocker &blocker) -> cocos::Task<> {
+    auto source{cocos::chunks(path, 16, 2, pool)};
+    COCOS_CHECK(co_await source.next());
+    // The reads started from now on queue behind it.
+    pool.submit(blocker);
+    auto chunk{co_await source.next()};
+    COCOS_CHECK(chunk && *chunk == "line 1000000001\n");
+  }(file.path(), pool, blocker)};
+  loop.add_task(consumer);
+  loop.run();
+  consumer.wait();
+  blocker.released.count_down();
+}
+
+/**
+ * @brief Destroy a consumer of lines() suspended while chunks() awaits a read
+ * in flight, along with a read nobody awaits.
+ */
+void destroy_while_awaited() {
+  TempFile file{fixed_lines(8)};
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::BlockingPool pool{1};
+  Blocker blocker;
+  bool suspended{false};
+  std::optional<cocos::Task<>> consumer{
+      [](const std::string &path, cocos::BlockingPool &pool, Blocker &blocker,
+         bool &suspended) -> cocos::Task<> {
+        auto source{cocos::lines(path, 16, 2, pool)};
+        COCOS_CHECK(co_await source.next());
+        pool.submit(blocker);
+        auto line{co_await source.next()};
+        COCOS_CHECK(line && *line == "line 1000000001");
+        suspended = true;
+        co_await source.next();
+        COCOS_CHECK(false);
+      }(file.path(), pool, blocker, suspended)};
+  auto destroyer{[](std::optional<cocos::Task<>> &consumer, Blocker &blocker,
+                    bool &suspended) -> cocos::Task<> {
+    while (!suspended) {
+      co_await cocos::sleep(std::chrono::milliseconds{1});
+    }
+    // The loop is held by the read awaited meanwhile, and released here.
+    consumer.reset();
+    blocker.released.count_down();
+  }(consumer, blocker, suspended)};
+  loop.add_task(*consumer);
+  loop.add_task(destroyer);
+  loop.run();
+  COCOS_CHECK(destroyer.done() && !consumer);
+}
+} // namespace
+
+int main() {
+  chunk_tails();
+  line_edges();
+  open_failure();
+  custom_backend();
+  destroy_while_running();
+  destroy_while_awaited();
+}
@@ -0,0 +1,145 @@
+#include "../include/generator.hpp"
+#include "check.hpp"
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+/**
+ * @brief Counts its copies and moves.
+ */
+struct Counted {
+  int value{0};
+  int *copies{nullptr};
+  int *moves{nullptr};
+  Counted(int value, int &copies, int &moves)
+      : value{value}, copies{&copies}, moves{&moves} {}
+  Counted(const Counted &other)
+      : value{other.value}, copies{other.copies}, moves{other.moves} {
+    ++*this->copies;
+  }
+  Counted(Counted &&other) noexcept
+      : value{other.value}, copies{other.copies}, moves{other.moves} {
+    ++*this->moves;
+  }
+  Counted &operator=(const Counted &) = default;
+  Counted &operator=(Counted &&) = default;
+};
+
+cocos::Generator<int &> refs(std::vector<int> &v) {
+  for (auto &elem : v) {
+    co_yield elem;
+  }
+}
+
+/**
+ * @brief A Generator<T &> hands out the producer's own objects, which the
+ * consumer may modify, through the adaptors as well.
+ */
+void mutable_refs() {
+  std::vector<int> v{1, 2, 3, 4, 5, 6};
+  for (auto &elem : refs(v)) {
+    elem *= 10;
+  }
+  COCOS_CHECK((v == std::vector{10, 20, 30, 40, 50, 60}));
+
+  refs(v).filter([](int &elem) { return elem % 20 == 0; }).for_each([](int &e) {
+    e = -e;
+  });
+  COCOS_CHECK((v == std::vector{10, -20, 30, -40, 50, -60}));
+
+  refs(v).take_while([](int &elem) { return elem != 50; }).take(2).for_each(
+      [](int &elem) { ++elem; });
+  COCOS_CHECK((v == std::vector{11, -19, 30, -40, 50, -60}));
+
+  auto outer{[](std::vector<int> &v) -> cocos::Generator<int &> {
+    co_yield cocos::elements_of(refs(v));
+    co_yield v.front();
+  }};
+  for (auto &elem : outer(v)) {
+    elem = 0;
+  }
+  COCOS_CHECK(v == std::vector<int>(6, 0));
+
+  for (auto &elem : cocos::Generator<int &>::from_range(v)) {
+    ++elem;
+  }
+  COCOS_CHECK(v == std::vector<int>(6, 1));
+}
+
+/**
+ * @brief Nothing yielded is copied or moved by a Generator<T &> or a
+ * Generator<const T &>, nor an rvalue by a Generator<T>, which copies an
+ * lvalue once.
+ */
+void no_copies() {
+  int copies{0};
+  int moves{0};
+  Counted obj{7, copies, moves};
+  auto by_ref{[](Counted &obj) -> cocos::Generator<Counted &> {
+    co_yield obj;
+    co_yield obj;
+  }};
+  int sum{0};
+  for (auto &elem : by_ref(obj)) {
+    COCOS_CHECK(&elem == &obj);
+    sum += elem.value;
+  }
+  COCOS_CHECK(sum == 14 && copies == 0 && moves == 0);
+
+  auto by_const_ref{[](const Counted &obj, int &copies,
+                       int &moves) -> cocos::Generator<const Counted &> {
+    co_yield obj;
+    // A temporary lives until the generator is resumed.
+    co_yield Counted{8, copies, moves};
+  }};
+  sum = 0;
+  by_const_ref(obj, copies, moves).for_each([&](const Counted &elem) {
+    sum += elem.value;
+  });
+  COCOS_CHECK(sum == 15 && copies == 0 && moves == 0);
+
+  auto by_value{[](Counted &obj, int &copies,
+                   int &moves) -> cocos::Generator<Counted> {
+    co_yield obj;
+    co_yield Counted{8, copies, moves};
+    co_yield std::move(obj);
+  }};
+  sum = 0;
+  by_value(obj, copies, moves).for_each([&](Counted &elem) {
+    sum += elem.value;
+  });
+  COCOS_CHECK(sum == 22 && copies == 1 && moves == 0);
+}
+
+/**
+ * @brief map() of a Generator<T &> is given the references, and may return
+ * references in turn.
+ */
+void map_refs() {
+  std::vector<std::string> words{"a", "bb", "ccc"};
+  auto names{[](std::vector<std::string> &w)
+                 -> cocos::Generator<std::string &> {
+    for (auto &word : w) {
+      co_yield word;
+    }
+  }};
+  std::vector<std::size_t> sizes;
+  names(words)
+      .map([](std::string &word) { return word.size(); })
+      .for_each([&](std::size_t size) { sizes.push_back(size); });
+  COCOS_CHECK((sizes == std::vector<std::size_t>{1, 2, 3}));
+
+  names(words)
+      .map([](std::string &word) -> char & { return word.front(); })
+      .for_each([](char &c) { c = 'z'; });
+  COCOS_CHECK((words == std::vector<std::string>{"z", "zb", "zcc"}));
+}
+} // namespace
+
+int main() {
+  mutable_refs();
+  no_copies();
+  map_refs();
+}
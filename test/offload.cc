@@ -0,0 +1,135 @@
+#include "../include/offload.hpp"
+#include "../include/sleep.hpp"
+#include "../include/sync_wait.hpp"
+#include "../include/task.hpp"
+#include "../include/threadpool.hpp"
+#include "../include/when_all.hpp"
+#include "check.hpp"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+using namespace std::chrono_literals;
+
+/**
+ * @brief The call runs on a thread of the blocking pool, and the coroutine is
+ * resumed back on its loop with the result, a reference, or nothing: on the
+ * thread of the loop, or on a worker of a ThreadPoolLoop, any of which may
+ * have stolen it.
+ */
+void threads() {
+  auto body{[](bool pinned) -> cocos::Task<bool> {
+    auto loop_thread{std::this_thread::get_id()};
+    auto call_thread{co_await cocos::offload(
+        [] { return std::this_thread::get_id(); })};
+    auto back{[&] {
+      auto id{std::this_thread::get_id()};
+      return pinned ? id == loop_thread : id != call_thread;
+    }};
+    auto ok{call_thread != loop_thread && back()};
+    static int shared{1};
+    auto &ref{co_await cocos::offload([]() -> int & { return shared; })};
+    ok = ok && &ref == &shared && back();
+    auto ran{false};
+    co_await cocos::offload([&] { ran = true; });
+    co_return ok && ran && back();
+  }};
+  COCOS_CHECK(cocos::sync_wait(body(true)));
+
+  cocos::ThreadPoolLoop pool{2};
+  pool.start();
+  COCOS_CHECK(cocos::sync_wait(pool, body(false)));
+  pool.stop();
+}
+
+/**
+ * @brief What the call throws is thrown by the co_await, on the loop.
+ */
+void exceptions() {
+  auto body{[]() -> cocos::Task<int> {
+    auto loop_thread{std::this_thread::get_id()};
+    try {
+      co_await cocos::offload(
+          []() -> int { throw std::runtime_error{"call"}; });
+    } catch (const std::runtime_error &) {
+      COCOS_CHECK(std::this_thread::get_id() == loop_thread);
+      co_return 1;
+    }
+    co_return 0;
+  }};
+  COCOS_CHECK(cocos::sync_wait(body()) == 1);
+}
+
+/**
+ * @brief The loop goes on while a call blocks: the call here waits for a
+ * coroutine on the same loop.
+ */
+void loop_runs() {
+  std::atomic<bool> flag{false};
+  auto waiter{[](std::atomic<bool> &flag) -> cocos::Task<> {
+    co_await cocos::offload([&] {
+      while (!flag) {
+        std::this_thread::sleep_for(100us);
+      }
+    });
+  }};
+  auto setter{[](std::atomic<bool> &flag) -> cocos::Task<> {
+    co_await cocos::sleep(5ms);
+    flag = true;
+  }};
+  auto both{[&]() -> cocos::Task<> {
+    co_await cocos::when_all(waiter(flag), setter(flag));
+  }};
+  cocos::sync_wait(both());
+  COCOS_CHECK(flag);
+}
+
+/**
+ * @brief A pool runs no more calls at once than its threads, starts threads
+ * only as needed, and lets them go once idle.
+ */
+void elastic() {
+  cocos::BlockingPool blocking{3, 20ms};
+  std::atomic<int> running{0};
+  std::atomic<int> most{0};
+  auto call{[&](cocos::BlockingPool &blocking) -> cocos::Task<> {
+    co_await cocos::offload(blocking, [&] {
+      auto now{++running};
+      auto seen{most.load()};
+      while (seen < now && !most.compare_exchange_weak(seen, now)) {
+      }
+      std::this_thread::sleep_for(10ms);
+      --running;
+    });
+  }};
+  auto calls{[&](int n) -> cocos::Task<> {
+    std::vector<cocos::Task<>> tasks;
+    for (int i{0}; i < n; ++i) {
+      tasks.push_back(call(blocking));
+    }
+    co_await cocos::when_all(std::move(tasks));
+  }};
+  cocos::sync_wait(calls(1));
+  COCOS_CHECK(most == 1 && blocking.thread_count() == 1);
+  cocos::sync_wait(calls(8));
+  COCOS_CHECK(most == 3 && blocking.thread_count() == 3);
+  auto deadline{cocos::now() + 5s};
+  while (blocking.thread_count() != 0 && cocos::now() < deadline) {
+    std::this_thread::sleep_for(5ms);
+  }
+  COCOS_CHECK(blocking.thread_count() == 0);
+  // Threads are started again afterwards.
+  cocos::sync_wait(calls(2));
+  COCOS_CHECK(blocking.thread_count() != 0);
+}
+} // namespace
+
+int main() {
+  threads();
+  exceptions();
+  loop_runs();
+  elastic();
+}
@@ -0,0 +1,177 @@
+#include "../include/generator.hpp"
+#include "../include/par_map.hpp"
+#include "../include/threadpool.hpp"
+#include "check.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+using namespace std::chrono_literals;
+
+/**
+ * @brief Yields 0, 1, 2, ... up to `n` exclusive, counting how many elements
+ * were pulled out of it, and throws at `fail_at` if given.
+ */
+cocos::Generator<int> counting(int n, std::size_t &pulled, int fail_at = -1) {
+  for (int i{0}; i < n; ++i) {
+    if (i == fail_at) {
+      throw std::runtime_error{"source"};
+    }
+    ++pulled;
+    co_yield i;
+  }
+}
+
+/**
+ * @brief Takes longer for the first elements, so that they finish last.
+ */
+int slow_first(int v) {
+  std::this_thread::sleep_for(std::chrono::milliseconds{std::max(0, 8 - v)});
+  return v * 10;
+}
+
+/**
+ * @brief Ordered, the results come in the order of the source, whatever the
+ * order in which they are done; unordered, they are the same results, the
+ * slow first one coming after the others.
+ */
+void order() {
+  cocos::ThreadPoolLoop pool{2};
+  pool.start();
+  std::vector<int> expected;
+  for (int i{0}; i < 32; ++i) {
+    expected.push_back(i * 10);
+  }
+  std::size_t pulled{0};
+  std::vector<int> ordered;
+  cocos::par_map(counting(32, pulled), slow_first, pool, 4)
+      .for_each([&](int v) { ordered.push_back(v); });
+  COCOS_CHECK(ordered == expected);
+
+  auto slow_zero{[](int v) {
+    if (v == 0) {
+      std::this_thread::sleep_for(50ms);
+    }
+    return v * 10;
+  }};
+  std::vector<int> unordered;
+  cocos::par_map(counting(32, pulled), slow_zero, pool, 4,
+                 cocos::ParMapOrder::unordered)
+      .for_each([&](int v) { unordered.push_back(v); });
+  COCOS_CHECK(unordered.front() != 0);
+  std::ranges::sort(unordered);
+  COCOS_CHECK(unordered == expected);
+  pool.stop();
+}
+
+/**
+ * @brief No more than `window` elements are pulled from the source and not
+ * yielded yet, and no more than `window` run at once.
+ */
+void window() {
+  cocos::ThreadPoolLoop pool{4};
+  pool.start();
+  for (auto order : {cocos::ParMapOrder::ordered,
+                     cocos::ParMapOrder::unordered}) {
+    std::size_t pulled{0};
+    std::size_t yielded{0};
+    std::atomic<int> running{0};
+    std::atomic<int> most{0};
+    auto f{[&](int v) {
+      auto now{++running};
+      auto seen{most.load()};
+      while (seen < now && !most.compare_exchange_weak(seen, now)) {
+      }
+      std::this_thread::sleep_for(1ms);
+      --running;
+      return v;
+    }};
+    cocos::par_map(counting(40, pulled), f, pool, 3, order)
+        .for_each([&](int) {
+          ++yielded;
+          COCOS_CHECK(pulled - yielded < 3);
+        });
+    COCOS_CHECK(yielded == 40);
+    COCOS_CHECK(most <= 3);
+  }
+  pool.stop();
+}
+
+/**
+ * @brief What `f` throws comes out in place of its result, and what the
+ * source throws after the results of the elements before it.
+ */
+void errors() {
+  cocos::ThreadPoolLoop pool{2};
+  pool.start();
+  std::size_t pulled{0};
+  std::vector<int> seen;
+  auto fail_five{[](int v) {
+    if (v == 5) {
+      throw std::invalid_argument{"five"};
+    }
+    return v;
+  }};
+  try {
+    for (auto v : cocos::par_map(counting(20, pulled), fail_five, pool, 4)) {
+      seen.push_back(v);
+    }
+    COCOS_CHECK(false);
+  } catch (const std::invalid_argument &) {
+  }
+  COCOS_CHECK((seen == std::vector{0, 1, 2, 3, 4}));
+
+  seen.clear();
+  try {
+    auto gen{cocos::par_map(counting(20, pulled, 6), slow_first, pool, 4)};
+    for (auto v : gen) {
+      seen.push_back(v);
+    }
+    COCOS_CHECK(false);
+  } catch (const std::runtime_error &) {
+  }
+  COCOS_CHECK((seen == std::vector{0, 10, 20, 30, 40, 50}));
+
+  try {
+    cocos::ThreadPoolLoop idle{1};
+    cocos::par_map(counting(1, pulled), slow_first, idle, 4);
+    COCOS_CHECK(false);
+  } catch (const std::logic_error &) {
+  }
+  pool.stop();
+}
+
+/**
+ * @brief Destroying the generator early waits for the elements in flight,
+ * and an owned pool is stopped with it.
+ */
+void early_stop() {
+  std::size_t pulled{0};
+  std::atomic<int> finished{0};
+  {
+    auto gen{cocos::par_map(
+        counting(100, pulled),
+        [&](int v) {
+          std::this_thread::sleep_for(2ms);
+          ++finished;
+          return v;
+        },
+        std::size_t{2}, 8)};
+    COCOS_CHECK(gen.move_next() && gen.current_value() == 0);
+  }
+  COCOS_CHECK(pulled <= 9);
+  COCOS_CHECK(finished == static_cast<int>(pulled));
+}
+} // namespace
+
+int main() {
+  order();
+  window();
+  errors();
+  early_stop();
+}
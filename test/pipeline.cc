@@ -0,0 +1,142 @@
+#include "../include/generator.hpp"
+#include "../include/pipeline.hpp"
+#include "check.hpp"
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+/**
+ * @brief Yields 0, 1, 2, ... up to `n` exclusive, counting how many elements
+ * were pulled out of it, and throws at `fail_at` if given.
+ */
+cocos::Generator<int> counting(int n, int &pulled, int fail_at = -1) {
+  for (int i{0}; i < n; ++i) {
+    if (i == fail_at) {
+      throw std::runtime_error{"source"};
+    }
+    ++pulled;
+    co_yield i;
+  }
+}
+
+bool even(int v) { return v % 2 == 0; }
+int square(int v) { return v * v; }
+
+/**
+ * @brief A fused pipeline produces what the chained Generator adaptors do.
+ */
+void same_as_chained() {
+  namespace pipe = cocos::pipe;
+  int pulled{0};
+  std::vector<int> chained;
+  counting(100, pulled).filter(even).map(square).take(5).for_each(
+      [&](int v) { chained.push_back(v); });
+  COCOS_CHECK((chained == std::vector{0, 4, 16, 36, 64}));
+
+  std::vector<int> fused;
+  (counting(100, pulled) | pipe::filter(even) | pipe::map(square) |
+   pipe::take(5))
+      .for_each([&](int v) { fused.push_back(v); });
+  COCOS_CHECK(fused == chained);
+
+  auto sum{(counting(10, pulled) | pipe::map(square))
+               .fold(0, [](int acc, int v) { return acc + v; })};
+  COCOS_CHECK(sum == 285);
+  auto max{(counting(10, pulled) | pipe::filter(even))
+               .reduce([](int a, int b) { return a < b ? b : a; })};
+  COCOS_CHECK(max == 8);
+  auto none{(counting(10, pulled) | pipe::filter([](int v) { return v < 0; }))
+                .reduce([](int a, int b) { return a + b; })};
+  COCOS_CHECK(!none);
+
+  std::vector<int> scanned;
+  for (auto v : (counting(10, pulled) |
+                 pipe::take_while([](int v) { return v < 5; }) |
+                 pipe::scan(0, [](int acc, int v) { return acc + v; }))
+                    .generator()) {
+    scanned.push_back(v);
+  }
+  COCOS_CHECK((scanned == std::vector{0, 1, 3, 6, 10}));
+}
+
+/**
+ * @brief The source is pulled once per element, and not again once take() has
+ * passed on its last element, nor at all for take(0).
+ */
+void pulls() {
+  namespace pipe = cocos::pipe;
+  int pulled{0};
+  (counting(100, pulled) | pipe::filter(even) | pipe::take(3))
+      .for_each([](int) {});
+  // 0, 2 and 4 pass, out of the first five.
+  COCOS_CHECK(pulled == 5);
+
+  pulled = 0;
+  (counting(100, pulled) | pipe::map(square) | pipe::take(0))
+      .for_each([](int) { COCOS_CHECK(false); });
+  COCOS_CHECK(pulled == 0);
+
+  pulled = 0;
+  auto gen{(counting(100, pulled) | pipe::take(4)).generator()};
+  int count{0};
+  while (gen.move_next()) {
+    ++count;
+  }
+  COCOS_CHECK(count == 4 && pulled == 4);
+}
+
+/**
+ * @brief An exception of the source comes out of the terminal operation, or
+ * out of the generator the pipeline was turned into, once the elements
+ * before it have passed.
+ */
+void errors() {
+  namespace pipe = cocos::pipe;
+  int pulled{0};
+  std::vector<int> seen;
+  try {
+    (counting(10, pulled, 3) | pipe::map(square))
+        .for_each([&](int v) { seen.push_back(v); });
+    COCOS_CHECK(false);
+  } catch (const std::runtime_error &) {
+  }
+  COCOS_CHECK((seen == std::vector{0, 1, 4}));
+
+  seen.clear();
+  try {
+    for (auto v : (counting(10, pulled, 5) | pipe::filter(even)).generator()) {
+      seen.push_back(v);
+    }
+    COCOS_CHECK(false);
+  } catch (const std::runtime_error &) {
+  }
+  COCOS_CHECK((seen == std::vector{0, 2, 4}));
+}
+
+/**
+ * @brief Move-only values pass through the stages, and out of the generator.
+ */
+void move_only() {
+  namespace pipe = cocos::pipe;
+  int pulled{0};
+  auto gen{(counting(4, pulled) |
+            pipe::map([](int v) { return std::make_unique<int>(v); }) |
+            pipe::filter([](const std::unique_ptr<int> &p) { return *p; }))
+               .generator()};
+  std::vector<int> seen;
+  while (gen.move_next()) {
+    std::unique_ptr<int> p{std::move(gen.current_value())};
+    seen.push_back(*p);
+  }
+  COCOS_CHECK((seen == std::vector{1, 2, 3}));
+}
+} // namespace
+
+int main() {
+  same_as_chained();
+  pulls();
+  errors();
+  move_only();
+}
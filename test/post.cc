@@ -0,0 +1,63 @@
+#include "../include/eventloop.hpp"
+#include "../include/task.hpp"
+#include "check.hpp"
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+constexpr int posters{4};
+constexpr int per_poster{10'000};
+
+cocos::Task<> record(std::vector<std::pair<int, int>> &log, int poster,
+                     int i) {
+  log.emplace_back(poster, i);
+  co_return;
+}
+
+/**
+ * @brief Threads post to one loop concurrently, holding it by a WorkGuard
+ * meanwhile. Every post is resumed exactly once on the loop, and the posts of
+ * each thread in the order it made them.
+ */
+void concurrent_posts() {
+  auto &loop{cocos::EventLoop::get_loop()};
+  std::vector<std::pair<int, int>> log;
+  std::vector<std::vector<cocos::Task<>>> tasks(posters);
+  for (int p{0}; p < posters; ++p) {
+    for (int i{0}; i < per_poster; ++i) {
+      tasks[p].push_back(record(log, p, i));
+    }
+  }
+  std::vector<std::thread> threads;
+  for (int p{0}; p < posters; ++p) {
+    threads.emplace_back([&loop, &tasks, p,
+                          guard = cocos::EventLoop::WorkGuard{loop}] {
+      for (auto &task : tasks[p]) {
+        loop.post(task);
+      }
+    });
+  }
+  loop.run();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  COCOS_CHECK(log.size() == std::size_t{posters} * per_poster);
+  std::vector<int> next(posters);
+  for (auto [poster, i] : log) {
+    COCOS_CHECK(i == next[poster]++);
+  }
+  for (auto &per_thread : tasks) {
+    for (auto &task : per_thread) {
+      COCOS_CHECK(task.done());
+    }
+  }
+}
+} // namespace
+
+int main() {
+  for (int round{0}; round < 5; ++round) {
+    concurrent_posts();
+  }
+}
@@ -0,0 +1,125 @@
+#include "../include/eventloop.hpp"
+#include "../include/sleep.hpp"
+#include "../include/task.hpp"
+#include "check.hpp"
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+using namespace std::chrono_literals;
+using cocos::Priority;
+
+/**
+ * @brief Appends `name` to the log `times` times, rescheduling itself at
+ * `again` in between.
+ */
+cocos::Task<> record(std::string &log, char name, int times = 1,
+                     Priority again = Priority::normal) {
+  for (int i{0}; i < times; ++i) {
+    if (i != 0) {
+      co_await cocos::reschedule(again);
+    }
+    log.push_back(name);
+  }
+}
+
+/**
+ * @brief Higher levels run first, and each level in the order of scheduling.
+ */
+void levels() {
+  cocos::EventLoop loop;
+  std::string log;
+  std::vector<cocos::Task<>> tasks;
+  for (auto [name, priority] :
+       {std::pair{'a', Priority::low}, std::pair{'b', Priority::normal},
+        std::pair{'c', Priority::critical}, std::pair{'d', Priority::high},
+        std::pair{'e', Priority::low}, std::pair{'f', Priority::critical},
+        std::pair{'g', Priority::normal}}) {
+    tasks.push_back(record(log, name));
+    loop.add_task(tasks.back(), priority);
+  }
+  loop.run();
+  COCOS_CHECK(log == "cfdbgae");
+}
+
+/**
+ * @brief On a level, the coroutines with a deadline run earliest first, ahead
+ * of those without one, even once their deadline is past.
+ */
+void deadlines() {
+  cocos::EventLoop loop;
+  std::string log;
+  std::vector<cocos::Task<>> tasks;
+  auto base{cocos::now()};
+  auto add{[&](char name, Priority priority, auto... deadline) {
+    tasks.push_back(record(log, name));
+    loop.add_task(tasks.back(), priority, (base + deadline)...);
+  }};
+  add('a', Priority::normal);
+  add('b', Priority::normal, 30ms);
+  add('c', Priority::normal, 10ms);
+  add('d', Priority::high);
+  add('e', Priority::normal, -1s);
+  add('f', Priority::low, -2s);
+  add('g', Priority::normal, 20ms);
+  loop.run();
+  COCOS_CHECK(log == "decgbaf");
+}
+
+/**
+ * @brief reschedule() puts a coroutine behind what is more urgent, or was
+ * scheduled before it on the level it asks for.
+ */
+void rescheduling() {
+  cocos::EventLoop loop;
+  std::string log;
+  auto a{record(log, 'a', 3, Priority::low)};
+  auto b{record(log, 'b', 2, Priority::normal)};
+  auto c{record(log, 'c', 2, Priority::high)};
+  loop.add_task(a);
+  loop.add_task(b);
+  loop.add_task(c);
+  loop.run();
+  // a goes down to low, b behind c, and c up to high.
+  COCOS_CHECK(log == "abccbaa");
+}
+
+/**
+ * @brief Once a level was bypassed `limit` times in a row, the coroutine
+ * scheduled longest ago runs, whatever its level; without a limit it waits
+ * for every higher level to be empty.
+ */
+void starvation() {
+  for (std::size_t limit : {0, 1, 4, 64}) {
+    cocos::EventLoop loop;
+    loop.set_starvation_limit(limit);
+    COCOS_CHECK(loop.get_starvation_limit() == limit);
+    std::string log;
+    auto low{record(log, 'l', 2, Priority::low)};
+    auto high{record(log, 'h', 10, Priority::high)};
+    loop.add_task(low, Priority::low);
+    loop.add_task(high, Priority::high);
+    loop.run();
+    std::string expected;
+    if (limit == 0 || limit > 10) {
+      expected = std::string(10, 'h') + "ll";
+    } else if (limit == 1) {
+      // Every pick bypasses the low level; the oldest runs in turn.
+      expected = "lhl" + std::string(9, 'h');
+    } else {
+      std::string run(limit - 1, 'h');
+      expected = run + "l" + run + "l" + std::string(10 - 2 * run.size(), 'h');
+    }
+    COCOS_CHECK(log == expected);
+  }
+}
+} // namespace
+
+int main() {
+  levels();
+  deadlines();
+  rescheduling();
+  starvation();
+}
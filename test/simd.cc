@@ -0,0 +1,168 @@
+#include "../include/chunked_generator.hpp"
+#include "../include/simd.hpp"
+#include "check.hpp"
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace {
+/**
+ * @brief Sizes around every multiple of the lanes of a kernel up to three,
+ * so that each kernel runs with and without full blocks, and with any tail.
+ */
+template <typename T> std::vector<std::size_t> sizes() {
+  constexpr auto lanes{cocos::simd::detail::lanes<T>};
+  std::vector<std::size_t> result;
+  for (std::size_t n{0}; n <= 3 * lanes + 2; ++n) {
+    result.push_back(n);
+  }
+  result.push_back(4099);
+  return result;
+}
+
+/**
+ * @brief Integers over their whole range, so that sums and products wrap,
+ * and small integral floats, so that they add up exactly in any order.
+ */
+template <typename T> std::vector<T> values(std::size_t n, unsigned seed) {
+  std::minstd_rand rng{seed};
+  std::vector<T> v(n);
+  for (auto &val : v) {
+    if constexpr (std::is_integral_v<T>) {
+      val = static_cast<T>(rng());
+    } else {
+      val = static_cast<T>(static_cast<int>(rng() % 61) - 30);
+    }
+  }
+  return v;
+}
+
+/**
+ * @brief The plain loops to compare with, wrapping integers through their
+ * unsigned type.
+ */
+template <typename T> struct Wrapping {
+  using type = T;
+};
+template <std::integral T> struct Wrapping<T> {
+  using type = std::make_unsigned_t<T>;
+};
+template <typename T> using Acc = typename Wrapping<T>::type;
+template <typename T> T plain_sum(const std::vector<T> &v) {
+  Acc<T> total{};
+  for (auto val : v) {
+    total = static_cast<Acc<T>>(total + static_cast<Acc<T>>(val));
+  }
+  return static_cast<T>(total);
+}
+template <typename T>
+T plain_dot(const std::vector<T> &a, const std::vector<T> &b) {
+  Acc<T> total{};
+  for (std::size_t i{0}; i < std::min(a.size(), b.size()); ++i) {
+    total = static_cast<Acc<T>>(
+        total + static_cast<Acc<T>>(static_cast<Acc<T>>(a[i]) *
+                                    static_cast<Acc<T>>(b[i])));
+  }
+  return static_cast<T>(total);
+}
+template <typename T> bool is_odd(T val) {
+  return static_cast<std::int64_t>(val) % 2 != 0;
+}
+
+/**
+ * @brief Yield `v` one element at a time, and in batches of 1, 2, 3, ...
+ * elements, some larger than the buffer.
+ */
+template <typename T, std::size_t N>
+cocos::ChunkedGenerator<T, N> stream(const std::vector<T> &v) {
+  std::size_t i{0};
+  for (std::size_t batch{1}; i < v.size(); ++batch) {
+    if (batch % 2 == 0) {
+      co_yield v[i];
+      ++i;
+      continue;
+    }
+    auto n{std::min(batch, v.size() - i)};
+    co_yield std::span<const T>{v}.subspan(i, n);
+    i += n;
+  }
+}
+
+/**
+ * @brief The kernels over spans, dispatched and generic, against the plain
+ * loops.
+ */
+template <typename T> void spans() {
+  namespace simd = cocos::simd;
+  for (auto n : sizes<T>()) {
+    auto a{values<T>(n, 1)};
+    auto b{values<T>(n, 2)};
+    std::span<const T> x{a}, y{b};
+    COCOS_CHECK(simd::sum(x) == plain_sum(a));
+    COCOS_CHECK(simd::detail::sum_kernel(x.data(), n) == plain_sum(a));
+    COCOS_CHECK(simd::dot(x, y) == plain_dot(a, b));
+    COCOS_CHECK(simd::detail::dot_kernel(x.data(), y.data(), n) ==
+                plain_dot(a, b));
+    auto odd{static_cast<std::size_t>(std::ranges::count_if(a, is_odd<T>))};
+    COCOS_CHECK(simd::count_if(x, is_odd<T>) == odd);
+    auto pred{is_odd<T>};
+    COCOS_CHECK(simd::detail::count_if_kernel(x.data(), n, pred) == odd);
+    if (n != 0) {
+      COCOS_CHECK(simd::min(x) == std::ranges::min(a));
+      COCOS_CHECK(simd::max(x) == std::ranges::max(a));
+      COCOS_CHECK(simd::detail::extremum_kernel(x.data(), n,
+                                                simd::detail::Less{}) ==
+                  std::ranges::min(a));
+    }
+  }
+}
+
+/**
+ * @brief The kernels over streams of chunks of `N`, against the plain loops.
+ */
+template <typename T, std::size_t N> void streams() {
+  namespace simd = cocos::simd;
+  for (auto n : {std::size_t{0}, std::size_t{1}, N - 1, N, N + 1,
+                 std::size_t{4099}}) {
+    auto a{values<T>(n, 3)};
+    auto b{values<T>(n + 5, 4)};
+    COCOS_CHECK((simd::sum(stream<T, N>(a)) == plain_sum(a)));
+    // The chunks of the two streams do not line up.
+    COCOS_CHECK((simd::dot(stream<T, N>(a), stream<T, 7>(b)) ==
+                 plain_dot(a, b)));
+    auto odd{static_cast<std::size_t>(std::ranges::count_if(a, is_odd<T>))};
+    COCOS_CHECK((simd::count_if(stream<T, N>(a), is_odd<T>) == odd));
+    auto least{simd::min(stream<T, N>(a))};
+    auto greatest{simd::max(stream<T, N>(a))};
+    COCOS_CHECK(least.has_value() == (n != 0));
+    COCOS_CHECK(greatest.has_value() == (n != 0));
+    if (n != 0) {
+      COCOS_CHECK(*least == std::ranges::min(a));
+      COCOS_CHECK(*greatest == std::ranges::max(a));
+    }
+  }
+}
+
+template <typename T> void check_type() {
+  spans<T>();
+  streams<T, 1>();
+  streams<T, 16>();
+  streams<T, 256>();
+}
+} // namespace
+
+int main() {
+  check_type<std::int8_t>();
+  check_type<std::uint8_t>();
+  check_type<std::int16_t>();
+  check_type<std::int32_t>();
+  check_type<std::uint32_t>();
+  check_type<std::int64_t>();
+  check_type<float>();
+  check_type<double>();
+}
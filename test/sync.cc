@@ -0,0 +1,325 @@
+#include "../include/cancellation.hpp"
+#include "../include/eventloop.hpp"
+#include "../include/sleep.hpp"
+#include "../include/sync.hpp"
+#include "../include/task.hpp"
+#include "../include/threadpool.hpp"
+#include "../include/when_any.hpp"
+#include "check.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <stop_token>
+#include <variant>
+#include <vector>
+
+namespace {
+/**
+ * @brief Request a stop from a task, once the tasks added before it have
+ * parked.
+ */
+cocos::Task<> request_stop(std::stop_source &stop) {
+  stop.request_stop();
+  co_return;
+}
+
+/**
+ * @brief Coroutines queued on a held mutex get it one after the other, in
+ * their order of arrival.
+ */
+void mutex_fifo() {
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::AsyncMutex mutex;
+  COCOS_CHECK(mutex.try_lock());
+  std::vector<int> order;
+  std::vector<cocos::Task<>> lockers;
+  for (int i{0}; i < 4; ++i) {
+    lockers.push_back([](cocos::AsyncMutex &mutex, std::vector<int> &order,
+                         int i) -> cocos::Task<> {
+      auto guard{co_await mutex.scoped_lock()};
+      order.push_back(i);
+      co_await cocos::sleep(std::chrono::microseconds{100});
+    }(mutex, order, i));
+    loop.add_task(lockers.back());
+  }
+  auto unlocker{[](cocos::AsyncMutex &mutex) -> cocos::Task<> {
+    mutex.unlock();
+    co_return;
+  }(mutex)};
+  loop.add_task(unlocker);
+  loop.run();
+  COCOS_CHECK((order == std::vector{0, 1, 2, 3}));
+  COCOS_CHECK(mutex.try_lock());
+  mutex.unlock();
+}
+
+/**
+ * @brief async_unlock() resumes a waiter of the same loop at once, ahead of
+ * what was queued on the loop before, and the unlocking coroutine behind it.
+ */
+void mutex_handoff() {
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::AsyncMutex mutex;
+  std::vector<char> order;
+  auto queued{[](std::vector<char> &order) -> cocos::Task<> {
+    order.push_back('q');
+    co_return;
+  }(order)};
+  auto holder{[](cocos::AsyncMutex &mutex, cocos::Task<> &queued,
+                 std::vector<char> &order) -> cocos::Task<> {
+    auto guard{co_await mutex.scoped_lock()};
+    co_await cocos::reschedule();
+    cocos::EventLoop::get_loop().add_task(queued);
+    co_await guard.release().async_unlock();
+    order.push_back('u');
+  }(mutex, queued, order)};
+  auto waiter{[](cocos::AsyncMutex &mutex,
+                 std::vector<char> &order) -> cocos::Task<> {
+    auto guard{co_await mutex.scoped_lock()};
+    order.push_back('w');
+  }(mutex, order)};
+  loop.add_task(holder);
+  loop.add_task(waiter);
+  loop.run();
+  COCOS_CHECK((order == std::vector{'w', 'q', 'u'}));
+  COCOS_CHECK(mutex.try_lock());
+  mutex.unlock();
+}
+
+/**
+ * @brief A stop request unparks a coroutine waiting for each primitive,
+ * which throws Cancelled, and leaves the primitive as it was.
+ */
+void cancel_parked() {
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::AsyncMutex mutex;
+  cocos::AsyncSemaphore semaphore{0};
+  cocos::AsyncEvent event;
+  COCOS_CHECK(mutex.try_lock());
+  std::stop_source stop;
+  int cancelled{0};
+  std::vector<cocos::Task<>> waiters;
+  waiters.push_back([](cocos::AsyncMutex &mutex, int &cancelled)
+                        -> cocos::Task<> {
+    try {
+      co_await mutex.lock();
+    } catch (const cocos::Cancelled &) {
+      ++cancelled;
+    }
+  }(mutex, cancelled));
+  waiters.push_back([](cocos::AsyncSemaphore &semaphore, int &cancelled)
+                        -> cocos::Task<> {
+    try {
+      co_await semaphore.acquire();
+    } catch (const cocos::Cancelled &) {
+      ++cancelled;
+    }
+  }(semaphore, cancelled));
+  waiters.push_back([](cocos::AsyncEvent &event, int &cancelled)
+                        -> cocos::Task<> {
+    try {
+      co_await event.wait();
+    } catch (const cocos::Cancelled &) {
+      ++cancelled;
+    }
+  }(event, cancelled));
+  for (auto &waiter : waiters) {
+    waiter.set_stop_token(stop.get_token());
+    loop.add_task(waiter);
+  }
+  auto stopper{request_stop(stop)};
+  loop.add_task(stopper);
+  loop.run();
+  COCOS_CHECK(cancelled == 3);
+  // The mutex is still held, and nobody waits for it.
+  COCOS_CHECK(!mutex.try_lock());
+  mutex.unlock();
+  COCOS_CHECK(mutex.try_lock());
+  mutex.unlock();
+  // The unit released is not granted to the cancelled waiter.
+  semaphore.release();
+  COCOS_CHECK(semaphore.try_acquire() && !semaphore.try_acquire());
+  event.set();
+  COCOS_CHECK(event.is_set());
+}
+
+/**
+ * @brief A cancelled waiter between two others leaves the queue without
+ * breaking the order of the rest.
+ */
+void cancel_middle() {
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::AsyncSemaphore semaphore{0};
+  std::stop_source stop;
+  std::vector<int> order;
+  std::vector<cocos::Task<>> waiters;
+  for (int i{0}; i < 3; ++i) {
+    waiters.push_back([](cocos::AsyncSemaphore &semaphore,
+                         std::vector<int> &order, int i) -> cocos::Task<> {
+      try {
+        co_await semaphore.acquire();
+        order.push_back(i);
+      } catch (const cocos::Cancelled &) {
+        order.push_back(-i);
+      }
+    }(semaphore, order, i));
+  }
+  waiters[1].set_stop_token(stop.get_token());
+  for (auto &waiter : waiters) {
+    loop.add_task(waiter);
+  }
+  auto releaser{[](cocos::AsyncSemaphore &semaphore,
+                   std::stop_source &stop) -> cocos::Task<> {
+    stop.request_stop();
+    semaphore.release(2);
+    co_return;
+  }(semaphore, stop)};
+  loop.add_task(releaser);
+  loop.run();
+  COCOS_CHECK((order == std::vector{-1, 0, 2}));
+  COCOS_CHECK(!semaphore.try_acquire());
+}
+
+/**
+ * @brief A when_any over waits which never complete finishes with the other
+ * task, and the waits are cancelled rather than pinning the loop.
+ */
+void when_any_loser() {
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::AsyncMutex mutex;
+  cocos::AsyncSemaphore semaphore{0};
+  cocos::AsyncEvent event;
+  COCOS_CHECK(mutex.try_lock());
+  auto race{[](cocos::AsyncMutex &mutex, cocos::AsyncSemaphore &semaphore,
+               cocos::AsyncEvent &event) -> cocos::Task<std::size_t> {
+    auto [index, result]{co_await cocos::when_any(
+        [](cocos::AsyncMutex &mutex) -> cocos::Task<> {
+          co_await mutex.lock();
+        }(mutex),
+        [](cocos::AsyncSemaphore &semaphore) -> cocos::Task<> {
+          co_await semaphore.acquire();
+        }(semaphore),
+        [](cocos::AsyncEvent &event) -> cocos::Task<> {
+          co_await event.wait();
+        }(event),
+        []() -> cocos::Task<int> {
+          co_await cocos::sleep(std::chrono::milliseconds{1});
+          co_return 7;
+        }())};
+    COCOS_CHECK(std::get<3>(result) == 7);
+    co_return index;
+  }(mutex, semaphore, event)};
+  loop.add_task(race);
+  loop.run();
+  COCOS_CHECK(race.wait() == 3);
+  mutex.unlock();
+  COCOS_CHECK(mutex.try_lock());
+  mutex.unlock();
+  semaphore.release();
+  COCOS_CHECK(semaphore.try_acquire());
+}
+
+/**
+ * @brief Parked waiters destroyed along with their coroutines leave the
+ * queues, so that the mutex is not handed to a dead coroutine, nor a unit
+ * granted to one.
+ */
+void destroy_parked() {
+  auto &loop{cocos::EventLoop::get_loop()};
+  cocos::AsyncMutex mutex;
+  cocos::AsyncSemaphore semaphore{0};
+  cocos::AsyncEvent event;
+  COCOS_CHECK(mutex.try_lock());
+  std::optional<std::vector<cocos::Task<>>> waiters{std::in_place};
+  waiters->push_back([](cocos::AsyncMutex &mutex) -> cocos::Task<> {
+    co_await mutex.lock();
+  }(mutex));
+  waiters->push_back([](cocos::AsyncSemaphore &semaphore) -> cocos::Task<> {
+    co_await semaphore.acquire();
+  }(semaphore));
+  waiters->push_back([](cocos::AsyncEvent &event) -> cocos::Task<> {
+    co_await event.wait();
+  }(event));
+  for (auto &waiter : *waiters) {
+    loop.add_task(waiter);
+  }
+  auto destroyer{[](std::optional<std::vector<cocos::Task<>>> &waiters)
+                     -> cocos::Task<> {
+    waiters.reset();
+    co_return;
+  }(waiters)};
+  loop.add_task(destroyer);
+  loop.run();
+  COCOS_CHECK(!waiters);
+  mutex.unlock();
+  COCOS_CHECK(mutex.try_lock());
+  mutex.unlock();
+  semaphore.release();
+  COCOS_CHECK(semaphore.try_acquire());
+  event.set();
+}
+
+/**
+ * @brief Coroutines on a pool increment a counter under the mutex, and at
+ * most `limit` of them hold the semaphore at once; a latch set by the last
+ * one resumes a waiter.
+ */
+void contention_pool() {
+  constexpr int tasks{16};
+  constexpr int rounds{2'000};
+  constexpr std::ptrdiff_t limit{3};
+  cocos::ThreadPoolLoop pool{4};
+  cocos::AsyncMutex mutex;
+  cocos::AsyncSemaphore semaphore{limit};
+  cocos::Latch latch{tasks};
+  long counter{0};
+  std::atomic<std::ptrdiff_t> inside{0};
+  std::atomic<bool> exceeded{false};
+  std::vector<cocos::Task<>> workers;
+  for (int t{0}; t < tasks; ++t) {
+    workers.push_back([](cocos::AsyncMutex &mutex,
+                         cocos::AsyncSemaphore &semaphore, cocos::Latch &latch,
+                         long &counter, std::atomic<std::ptrdiff_t> &inside,
+                         std::atomic<bool> &exceeded) -> cocos::Task<> {
+      for (int i{0}; i < rounds; ++i) {
+        {
+          auto guard{co_await mutex.scoped_lock()};
+          ++counter;
+        }
+        co_await semaphore.acquire();
+        if (inside.fetch_add(1) >= limit) {
+          exceeded = true;
+        }
+        inside.fetch_sub(1);
+        semaphore.release();
+      }
+      latch.count_down();
+    }(mutex, semaphore, latch, counter, inside, exceeded));
+  }
+  auto waiter{[](cocos::Latch &latch) -> cocos::Task<> {
+    co_await latch.wait();
+  }(latch)};
+  pool.add_task(waiter);
+  for (auto &worker : workers) {
+    pool.add_task(worker);
+  }
+  pool.run();
+  waiter.wait();
+  COCOS_CHECK(counter == long{tasks} * rounds);
+  COCOS_CHECK(!exceeded);
+  COCOS_CHECK(latch.try_wait());
+}
+} // namespace
+
+int main() {
+  mutex_fifo();
+  mutex_handoff();
+  cancel_parked();
+  cancel_middle();
+  when_any_loser();
+  destroy_parked();
+  for (int round{0}; round < 3; ++round) {
+    contention_pool();
+  }
+}
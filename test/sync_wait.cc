@@ -0,0 +1,109 @@
+#include "../include/sleep.hpp"
+#include "../include/sync_wait.hpp"
+#include "../include/task.hpp"
+#include "../include/threadpool.hpp"
+#include "check.hpp"
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+using namespace std::chrono_literals;
+
+cocos::Task<int> after(std::chrono::milliseconds delay, int value) {
+  co_await cocos::sleep(delay);
+  co_return value;
+}
+cocos::Task<> fail_after(std::chrono::milliseconds delay) {
+  co_await cocos::sleep(delay);
+  throw std::runtime_error{"failed"};
+}
+void check_fails(cocos::ThreadPoolLoop &pool) {
+  try {
+    cocos::sync_wait(pool, fail_after(1ms));
+    COCOS_CHECK(false);
+  } catch (const std::runtime_error &) {
+  }
+}
+
+/**
+ * @brief sync_wait() on a pool between start() and stop(), whose workers are
+ * up already.
+ */
+void pool_started() {
+  cocos::ThreadPoolLoop pool{2};
+  pool.start();
+  for (int i{0}; i < 3; ++i) {
+    COCOS_CHECK(cocos::sync_wait(pool, after(1ms, i)) == i);
+  }
+  check_fails(pool);
+  pool.stop();
+  COCOS_CHECK(!pool.running());
+}
+
+/**
+ * @brief sync_wait() on a pool in run() on another thread, which keeps its
+ * workers up meanwhile, even once the tasks of the run() are done.
+ */
+void pool_in_run() {
+  cocos::ThreadPoolLoop pool{2};
+  std::atomic<bool> begun{false};
+  auto first{[](std::atomic<bool> &begun) -> cocos::Task<> {
+    begun = true;
+    co_await cocos::sleep(5ms);
+  }(begun)};
+  pool.add_task(first);
+  std::thread runner{[&] { pool.run(); }};
+  while (!begun) {
+    std::this_thread::yield();
+  }
+  COCOS_CHECK(cocos::sync_wait(pool, after(20ms, 7)) == 7);
+  check_fails(pool);
+  runner.join();
+  COCOS_CHECK(first.done());
+}
+
+/**
+ * @brief sync_wait() on a pool nobody runs, whose workers it spawns and joins
+ * again, call after call.
+ */
+void pool_idle() {
+  cocos::ThreadPoolLoop pool{2};
+  for (int i{0}; i < 3; ++i) {
+    COCOS_CHECK(cocos::sync_wait(pool, after(1ms, i)) == i);
+  }
+  check_fails(pool);
+  COCOS_CHECK(!pool.running());
+  // A run() afterwards is not taken for one in progress.
+  pool.run();
+}
+
+/**
+ * @brief sync_wait() on the loop of the thread, which runs it until the task
+ * is done, and throws std::logic_error if it runs out of work before.
+ */
+void loop() {
+  COCOS_CHECK(cocos::sync_wait(after(1ms, 3)) == 3);
+  try {
+    cocos::sync_wait(fail_after(1ms));
+    COCOS_CHECK(false);
+  } catch (const std::runtime_error &) {
+  }
+  // Suspended for good, with nothing scheduled to resume it.
+  auto stuck{[]() -> cocos::Task<> { co_await std::suspend_always{}; }()};
+  try {
+    cocos::sync_wait(std::move(stuck));
+    COCOS_CHECK(false);
+  } catch (const std::logic_error &) {
+  }
+}
+} // namespace
+
+int main() {
+  pool_started();
+  pool_in_run();
+  pool_idle();
+  loop();
+}
@@ -0,0 +1,145 @@
+#include "../include/eventloop.hpp"
+#include "../include/io.hpp"
+#include "../include/sleep.hpp"
+#include "../include/task.hpp"
+#include "../include/threadpool.hpp"
+#include "check.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <fcntl.h>
+#include <span>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+using namespace std::chrono_literals;
+
+/**
+ * @brief A pair of connected non-blocking sockets, closed on destruction.
+ */
+struct SocketPair {
+  std::array<int, 2> fds{-1, -1};
+
+  SocketPair() {
+    COCOS_CHECK(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0,
+                             fds.data()) == 0);
+  }
+  SocketPair(const SocketPair &) = delete;
+  auto operator=(const SocketPair &) = delete;
+  ~SocketPair() {
+    ::close(this->fds[0]);
+    ::close(this->fds[1]);
+  }
+};
+
+cocos::Task<> echo(int fd, int rounds) {
+  std::array<std::byte, 1> byte{};
+  for (int i{0}; i < rounds; ++i) {
+    COCOS_CHECK(co_await cocos::read(fd, byte) == 1);
+    COCOS_CHECK(co_await cocos::write(fd, byte) == 1);
+  }
+}
+
+/**
+ * @brief Send a byte over a blocking descriptor, and wait for it back.
+ */
+void round_trip(int fd, std::byte value) {
+  ::fcntl(fd, F_SETFL, 0);
+  COCOS_CHECK(::write(fd, &value, 1) == 1);
+  std::byte back{};
+  COCOS_CHECK(::read(fd, &back, 1) == 1);
+  COCOS_CHECK(back == value);
+}
+
+/**
+ * @brief A coroutine on a pool answers a thread outside it over a socket,
+ * each time from the reactor of its worker.
+ */
+void io_echo() {
+  constexpr int rounds{2'000};
+  cocos::ThreadPoolLoop pool{2};
+  SocketPair pair;
+  auto task{echo(pair.fds[0], rounds)};
+  pool.start();
+  pool.add_task(task);
+  for (int i{0}; i < rounds; ++i) {
+    round_trip(pair.fds[1], static_cast<std::byte>(i));
+  }
+  task.wait();
+  pool.stop();
+}
+
+/**
+ * @brief The only worker of a pool blocks in its reactor for a socket, and
+ * is woken there by a task added from outside, and by a post to its loop,
+ * which write to the socket in turn.
+ */
+void wake_in_reactor() {
+  cocos::ThreadPoolLoop pool{1};
+  SocketPair pair;
+  std::atomic<cocos::EventLoop *> home{nullptr};
+  auto reader{[](int fd,
+                 std::atomic<cocos::EventLoop *> &home) -> cocos::Task<> {
+    home.store(&cocos::EventLoop::get_loop());
+    std::array<std::byte, 1> byte{};
+    for (int i{0}; i < 2; ++i) {
+      COCOS_CHECK(co_await cocos::read(fd, byte) == 1);
+    }
+  }(pair.fds[0], home)};
+  auto writer{[](int fd) -> cocos::Task<> {
+    std::array<std::byte, 1> byte{};
+    COCOS_CHECK(co_await cocos::write(fd, byte) == 1);
+  }};
+  auto added{writer(pair.fds[1])};
+  auto posted{writer(pair.fds[1])};
+  pool.start();
+  pool.add_task(reader);
+  while (!home.load()) {
+    std::this_thread::yield();
+  }
+  std::this_thread::sleep_for(10ms);
+  pool.add_task(added);
+  added.wait();
+  std::this_thread::sleep_for(10ms);
+  home.load()->post(posted);
+  reader.wait();
+  pool.stop();
+}
+
+/**
+ * @brief A worker blocked in its reactor still wakes up for its timers, on
+ * time, through the deadline of the wait.
+ */
+void timers_with_io() {
+  cocos::ThreadPoolLoop pool{1};
+  SocketPair pair;
+  auto reader{[](int fd) -> cocos::Task<> {
+    std::array<std::byte, 1> byte{};
+    COCOS_CHECK(co_await cocos::read(fd, byte) == 1);
+  }(pair.fds[0])};
+  auto sleeper{[]() -> cocos::Task<> {
+    for (int i{0}; i < 5; ++i) {
+      auto deadline{cocos::now() + 5ms};
+      co_await cocos::sleep(deadline);
+      COCOS_CHECK(cocos::now() >= deadline);
+    }
+  }()};
+  pool.start();
+  pool.add_task(reader);
+  pool.add_task(sleeper);
+  sleeper.wait();
+  std::byte byte{1};
+  COCOS_CHECK(::write(pair.fds[1], &byte, 1) == 1);
+  reader.wait();
+  pool.stop();
+}
+} // namespace
+
+int main() {
+  io_echo();
+  wake_in_reactor();
+  timers_with_io();
+}
@@ -0,0 +1,103 @@
+#include "../include/timer_wheel.hpp"
+#include "check.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+using Clock = cocos::TimerWheel::Clock;
+constexpr auto tick{std::chrono::milliseconds{1}};
+
+/**
+ * @brief Timers around the boundaries of every level, and spread at random
+ * across them, some of them off the tick grid.
+ */
+std::vector<Clock::time_point> make_deadlines(Clock::time_point origin) {
+  std::vector<std::uint64_t> ticks{0, 1, 2};
+  for (std::uint64_t span{64}; span < (std::uint64_t{1} << 30); span *= 64) {
+    for (auto t : {span - 1, span, span + 1, 2 * span + 3}) {
+      ticks.push_back(t);
+    }
+  }
+  std::mt19937_64 rng{42};
+  for (std::uint64_t span{64}; span < (std::uint64_t{1} << 30); span *= 64) {
+    std::uniform_int_distribution<std::uint64_t> dist{0, span};
+    for (int i{0}; i < 500; ++i) {
+      ticks.push_back(dist(rng));
+    }
+  }
+  std::vector<Clock::time_point> deadlines;
+  std::uniform_int_distribution<int> sub_tick{0, 999};
+  for (std::size_t i{0}; i < ticks.size(); ++i) {
+    auto offset{i % 4 == 0 ? std::chrono::microseconds{sub_tick(rng)}
+                           : std::chrono::microseconds{0}};
+    deadlines.push_back(origin + tick * ticks[i] + offset);
+  }
+  return deadlines;
+}
+std::uint64_t tick_of(Clock::time_point origin, Clock::time_point time) {
+  auto ticks{(time - origin + tick - Clock::duration{1}) / tick};
+  return static_cast<std::uint64_t>(ticks);
+}
+
+/**
+ * @brief Advance the wheel to each next expiration, plus a random leap of up
+ * to `max_leap` ticks which spans several slots, and check that timers fire in the order of their ticks
+ * as they cascade down the levels, never early nor later than the first
+ * expire() which reaches them. Every other timer of a third is cancelled.
+ */
+void cascade_order(std::uint64_t max_leap) {
+  auto origin{Clock::now()};
+  cocos::TimerWheel wheel{tick, origin};
+  auto deadlines{make_deadlines(origin)};
+  std::vector<cocos::TimerNode> nodes(deadlines.size());
+  std::vector<int> fired(nodes.size());
+  for (std::size_t i{0}; i < nodes.size(); ++i) {
+    nodes[i].awake_time = deadlines[i];
+    wheel.insert(nodes[i]);
+  }
+  std::size_t cancelled{0};
+  for (std::size_t i{0}; i < nodes.size(); i += 3) {
+    wheel.cancel(nodes[i]);
+    ++cancelled;
+  }
+  COCOS_CHECK(wheel.size() == nodes.size() - cancelled);
+
+  std::mt19937_64 rng{7};
+  std::uniform_int_distribution<std::uint64_t> leap{0, max_leap};
+  std::uint64_t last_tick{0};
+  std::size_t count{0};
+  auto now{origin};
+  while (auto next{wheel.next_expiration()}) {
+    now = std::max(now, *next) + tick * leap(rng);
+    wheel.expire(now, [&](cocos::TimerNode &node) {
+      auto i{static_cast<std::size_t>(&node - nodes.data())};
+      COCOS_CHECK(i % 3 != 0 && !node.linked());
+      COCOS_CHECK(node.awake_time <= now);
+      auto t{tick_of(origin, node.awake_time)};
+      COCOS_CHECK(t >= last_tick);
+      last_tick = t;
+      ++fired[i];
+      ++count;
+    });
+    for (std::size_t i{0}; i < nodes.size(); ++i) {
+      if (nodes[i].linked()) {
+        COCOS_CHECK(nodes[i].awake_time > now);
+      }
+    }
+  }
+  COCOS_CHECK(wheel.empty() && count == nodes.size() - cancelled);
+  for (std::size_t i{0}; i < nodes.size(); ++i) {
+    COCOS_CHECK(fired[i] == (i % 3 == 0 ? 0 : 1));
+  }
+}
+} // namespace
+
+int main() {
+  for (std::uint64_t leap : {0, 7, 4099, 300'000, 20'000'000}) {
+    cascade_order(leap);
+  }
+}
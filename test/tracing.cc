@@ -0,0 +1,136 @@
+#include "../include/eventloop.hpp"
+#include "../include/sleep.hpp"
+#include "../include/task.hpp"
+#include "../include/trace.hpp"
+#include "check.hpp"
+#include <chrono>
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+// Built with COCOS_TRACING=1 by CMakeLists.txt, for the hooks to be in.
+static_assert(COCOS_TRACING);
+
+namespace {
+using namespace std::chrono_literals;
+
+cocos::Task<> sleeper(int sleeps) {
+  for (int i{0}; i < sleeps; ++i) {
+    co_await cocos::sleep(1ms);
+  }
+}
+cocos::Task<> nothing() { co_return; }
+
+std::size_t occurrences(std::string_view text, std::string_view what) {
+  std::size_t count{0};
+  for (auto pos{text.find(what)}; pos != text.npos;
+       pos = text.find(what, pos + what.size())) {
+    ++count;
+  }
+  return count;
+}
+
+/**
+ * @brief Run two sleepers and a task posted from another thread on `loop`,
+ * all three ready at the start. That is 2 + 3 resumes for the sleepers, of
+ * which 3 by a timer, and one for the posted task.
+ */
+void run_some(cocos::EventLoop &loop) {
+  auto a{sleeper(1)};
+  auto b{sleeper(2)};
+  auto posted{nothing()};
+  loop.add_task(a);
+  loop.add_task(b);
+  std::thread{[&] { loop.post(posted); }}.join();
+  loop.run();
+  COCOS_CHECK(a.done() && b.done() && posted.done());
+}
+
+/**
+ * @brief A loop counts its resumes, timers, posts and the most coroutines
+ * ready at once, and times each resume and the lateness of each timer.
+ */
+void stats() {
+  cocos::EventLoop loop;
+  run_some(loop);
+  auto &stats{loop.get_stats()};
+  COCOS_CHECK(stats.resumes == 6);
+  COCOS_CHECK(stats.timer_fires == 3);
+  COCOS_CHECK(stats.posts == 1);
+  COCOS_CHECK(stats.ready_high_water == 3);
+  COCOS_CHECK(stats.resume_time.count() == stats.resumes);
+  COCOS_CHECK(stats.timer_lateness.count() == stats.timer_fires);
+  COCOS_CHECK(stats.timer_lateness.max() < 1s);
+
+  loop.reset_stats();
+  COCOS_CHECK(loop.get_stats().resumes == 0);
+  COCOS_CHECK(loop.get_stats().resume_time.count() == 0);
+}
+
+/**
+ * @brief Between start() and stop(), tasks record their creation and
+ * completion, and the loops a begin and an end for each resume, which
+ * write_json() writes as Chrome trace events.
+ */
+void events() {
+  auto &recorder{cocos::TraceRecorder::get()};
+  recorder.clear();
+  cocos::EventLoop loop;
+  run_some(loop);
+  std::ostringstream out;
+  recorder.write_json(out);
+  COCOS_CHECK(occurrences(out.str(), "\"ph\"") == 0);
+
+  recorder.start();
+  COCOS_CHECK(recorder.is_recording());
+  run_some(loop);
+  recorder.stop();
+  out.str({});
+  recorder.write_json(out);
+  auto json{out.str()};
+  COCOS_CHECK(json.starts_with("{\"traceEvents\":["));
+  COCOS_CHECK(json.ends_with("]}\n"));
+  COCOS_CHECK(occurrences(json, "\"name\":\"create\"") == 3);
+  COCOS_CHECK(occurrences(json, "\"name\":\"complete\"") == 3);
+  COCOS_CHECK(occurrences(json, "\"ph\":\"B\"") == 6);
+  COCOS_CHECK(occurrences(json, "\"ph\":\"E\"") == 6);
+
+  recorder.clear();
+  out.str({});
+  recorder.write_json(out);
+  COCOS_CHECK(occurrences(out.str(), "\"ph\"") == 0);
+}
+
+/**
+ * @brief The histogram keeps values within 1/16 of their magnitude.
+ */
+void histogram() {
+  cocos::LatencyHistogram hist;
+  COCOS_CHECK(hist.count() == 0 && hist.mean() == 0ns);
+  for (int i{1}; i <= 1000; ++i) {
+    hist.record(std::chrono::microseconds{i});
+  }
+  COCOS_CHECK(hist.count() == 1000);
+  COCOS_CHECK(hist.max() == 1000us);
+  COCOS_CHECK(hist.mean() == 500'500ns);
+  for (auto [p, exact] : {std::pair{0.5, 500us}, std::pair{0.99, 990us},
+                          std::pair{0.001, 1us}}) {
+    auto got{hist.percentile(p)};
+    std::chrono::nanoseconds ns{exact};
+    COCOS_CHECK(got <= ns && got > ns - ns / 16);
+  }
+  hist.record(-5ns);
+  COCOS_CHECK(hist.percentile(0) == 0ns);
+  hist.reset();
+  COCOS_CHECK(hist.count() == 0 && hist.max() == 0ns);
+}
+} // namespace
+
+int main() {
+  stats();
+  events();
+  histogram();
+}
@@ -0,0 +1,146 @@
+#include "../include/generator.hpp"
+#include "check.hpp"
+#include <algorithm>
+#include <iterator>
+#include <ranges>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+using Gen = cocos::Generator<int>;
+static_assert(std::ranges::input_range<Gen>);
+static_assert(std::ranges::view<Gen>);
+static_assert(std::input_iterator<std::ranges::iterator_t<Gen>>);
+static_assert(std::same_as<std::ranges::range_reference_t<Gen>, int &>);
+static_assert(
+    std::same_as<std::ranges::range_reference_t<cocos::Generator<const int &>>,
+                 const int &>);
+
+/**
+ * @brief Yields 0, 1, 2, ... up to `n` exclusive, counting how many elements
+ * were pulled out of it, and throws at `fail_at` if given.
+ */
+Gen counting(int n, int &pulled, int fail_at = -1) {
+  for (int i{0}; i < n; ++i) {
+    if (i == fail_at) {
+      throw std::runtime_error{"source"};
+    }
+    ++pulled;
+    co_yield i;
+  }
+}
+
+/**
+ * @brief std::views compose over a generator, pulling it lazily, and the
+ * std::ranges algorithms consume it.
+ */
+void compose() {
+  int pulled{0};
+  std::vector<int> seen;
+  for (auto v : counting(100, pulled) |
+                    std::views::filter([](int v) { return v % 3 == 0; }) |
+                    std::views::transform([](int v) { return v * v; }) |
+                    std::views::take(4)) {
+    seen.push_back(v);
+  }
+  COCOS_CHECK((seen == std::vector{0, 9, 36, 81}));
+  // Up to 12: views::take steps past its last element, unlike take().
+  COCOS_CHECK(pulled == 13);
+
+  seen.clear();
+  for (auto v : counting(10, pulled) | std::views::drop(7)) {
+    seen.push_back(v);
+  }
+  COCOS_CHECK((seen == std::vector{7, 8, 9}));
+
+  seen.clear();
+  std::ranges::copy(counting(10, pulled) |
+                        std::views::take_while([](int v) { return v < 4; }),
+                    std::back_inserter(seen));
+  COCOS_CHECK((seen == std::vector{0, 1, 2, 3}));
+
+  COCOS_CHECK(std::ranges::count_if(counting(10, pulled), [](int v) {
+                return v % 2;
+              }) == 5);
+  pulled = 0;
+  auto gen{counting(10, pulled)};
+  auto found{std::ranges::find(gen, 6)};
+  COCOS_CHECK(found != gen.end() && *found == 6 && pulled == 7);
+  auto none{counting(10, pulled)};
+  COCOS_CHECK(std::ranges::find(none, 42) == none.end());
+}
+
+/**
+ * @brief from_range() refers to an lvalue, and moves an rvalue into the
+ * frame, which outlives the argument.
+ */
+void from_range() {
+  std::vector<int> v{1, 2, 3};
+  auto referred{Gen::from_range(v)};
+  v.push_back(4);
+  std::vector<int> seen;
+  for (auto val : referred) {
+    seen.push_back(val);
+  }
+  COCOS_CHECK((seen == std::vector{1, 2, 3, 4}));
+
+  auto owned{Gen::from_range(std::vector{5, 6, 7})};
+  seen.clear();
+  for (auto val : std::move(owned) | std::views::drop(1)) {
+    seen.push_back(val);
+  }
+  COCOS_CHECK((seen == std::vector{6, 7}));
+}
+
+/**
+ * @brief An exception of the generator comes out of the view iterating it,
+ * after the elements before it.
+ */
+void errors() {
+  int pulled{0};
+  std::vector<int> seen;
+  try {
+    for (auto v : counting(10, pulled, 3) |
+                      std::views::transform([](int v) { return v + 1; })) {
+      seen.push_back(v);
+    }
+    COCOS_CHECK(false);
+  } catch (const std::runtime_error &) {
+  }
+  COCOS_CHECK((seen == std::vector{1, 2, 3}));
+
+  try {
+    std::ranges::for_each(counting(10, pulled, 0), [](int) {});
+    COCOS_CHECK(false);
+  } catch (const std::runtime_error &) {
+  }
+}
+
+/**
+ * @brief A view is move-assignable: the assigned generator takes over the
+ * frame, and its own is destroyed.
+ */
+void assign() {
+  int pulled{0};
+  auto gen{counting(10, pulled)};
+  COCOS_CHECK(*gen.begin() == 0);
+  gen = counting(3, pulled);
+  std::vector<int> seen;
+  for (auto v : gen) {
+    seen.push_back(v);
+  }
+  COCOS_CHECK((seen == std::vector{0, 1, 2}));
+
+  auto view{counting(5, pulled) | std::views::take(2)};
+  view = counting(5, pulled) | std::views::take(2);
+  COCOS_CHECK(std::ranges::distance(view) == 2);
+}
+} // namespace
+
+int main() {
+  compose();
+  from_range();
+  errors();
+  assign();
+}
@@ -0,0 +1,173 @@
+#include "../include/cancellation.hpp"
+#include "../include/eventloop.hpp"
+#include "../include/sleep.hpp"
+#include "../include/task.hpp"
+#include "../include/when_all.hpp"
+#include "../include/when_any.hpp"
+#include "check.hpp"
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace {
+using namespace std::chrono_literals;
+
+cocos::Task<int> after(std::chrono::milliseconds delay, int value) {
+  co_await cocos::sleep(delay);
+  co_return value;
+}
+cocos::Task<int> fail_after(std::chrono::milliseconds delay, int value) {
+  co_await cocos::sleep(delay);
+  throw std::runtime_error{std::to_string(value)};
+}
+
+/**
+ * @brief Run a task on the thread's loop, until the loop has nothing left.
+ */
+template <typename T> decltype(auto) run(cocos::Task<T> &task) {
+  auto &loop{cocos::EventLoop::get_loop()};
+  loop.add_task(task);
+  loop.run();
+  return task.wait();
+}
+
+/**
+ * @brief The results come in the order of the tasks, whatever the order in
+ * which they finish, a Task<void> contributing a std::monostate.
+ */
+void when_all_order() {
+  auto range{[]() -> cocos::Task<std::vector<int>> {
+    std::vector<cocos::Task<int>> tasks;
+    for (int i{0}; i < 4; ++i) {
+      tasks.push_back(after(std::chrono::milliseconds{8 - 2 * i}, i));
+    }
+    co_return co_await cocos::when_all(std::move(tasks));
+  }()};
+  COCOS_CHECK((run(range) == std::vector{0, 1, 2, 3}));
+
+  auto fixed{[]() -> cocos::Task<bool> {
+    auto [a, b, c]{co_await cocos::when_all(
+        after(6ms, 1),
+        []() -> cocos::Task<> { co_await cocos::sleep(3ms); }(),
+        []() -> cocos::Task<std::string> { co_return "now"; }())};
+    co_return a == 1 && b == std::monostate{} && c == "now";
+  }()};
+  COCOS_CHECK(run(fixed));
+
+  auto empty{[]() -> cocos::Task<std::size_t> {
+    co_return (co_await cocos::when_all(std::vector<cocos::Task<int>>{}))
+        .size();
+  }()};
+  COCOS_CHECK(run(empty) == 0);
+}
+
+/**
+ * @brief The exception of the first failed task in the order of the tasks is
+ * rethrown, once every task has finished.
+ */
+void when_all_exception() {
+  auto range{[](int &finished) -> cocos::Task<int> {
+    std::vector<cocos::Task<int>> tasks;
+    tasks.push_back(fail_after(6ms, 0));
+    tasks.push_back(fail_after(1ms, 1));
+    tasks.push_back([](int &finished) -> cocos::Task<int> {
+      co_await cocos::sleep(10ms);
+      co_return ++finished;
+    }(finished));
+    try {
+      co_await cocos::when_all(std::move(tasks));
+    } catch (const std::runtime_error &e) {
+      co_return std::stoi(e.what());
+    }
+    co_return -1;
+  }};
+  int finished{0};
+  auto task{range(finished)};
+  COCOS_CHECK(run(task) == 0);
+  COCOS_CHECK(finished == 1);
+}
+
+/**
+ * @brief The first task to finish wins, and the others are cancelled through
+ * their stop token, a loser in Sleep at once rather than after its hour,
+ * even down in a task it awaits.
+ */
+void when_any_first() {
+  auto race{[](int &cancelled) -> cocos::Task<std::size_t> {
+    auto loser{[](int &cancelled) -> cocos::Task<int> {
+      try {
+        co_await cocos::sleep(1h);
+      } catch (const cocos::Cancelled &) {
+        ++cancelled;
+        throw;
+      }
+      co_return -1;
+    }};
+    // Its stop token is handed down to the task it awaits.
+    auto nested{[](cocos::Task<int> inner) -> cocos::Task<int> {
+      co_return co_await std::move(inner);
+    }};
+    std::vector<cocos::Task<int>> tasks;
+    tasks.push_back(loser(cancelled));
+    tasks.push_back(after(2ms, 7));
+    tasks.push_back(nested(loser(cancelled)));
+    auto [index, value]{co_await cocos::when_any(std::move(tasks))};
+    COCOS_CHECK(value == 7);
+    co_return index;
+  }};
+  int cancelled{0};
+  auto start{cocos::now()};
+  auto task{race(cancelled)};
+  COCOS_CHECK(run(task) == 1);
+  COCOS_CHECK(cancelled == 2);
+  COCOS_CHECK(cocos::now() - start < 1s);
+
+  auto fixed{[]() -> cocos::Task<bool> {
+    auto [index, result]{co_await cocos::when_any(
+        after(5ms, 1),
+        []() -> cocos::Task<std::string> {
+          co_await cocos::sleep(1ms);
+          co_return "first";
+        }())};
+    co_return index == 1 && std::get<1>(result) == "first";
+  }()};
+  COCOS_CHECK(run(fixed));
+}
+
+/**
+ * @brief A winner which throws has its exception rethrown, and an empty range
+ * is refused, since it would never finish.
+ */
+void when_any_errors() {
+  auto race{[]() -> cocos::Task<int> {
+    std::vector<cocos::Task<int>> tasks;
+    tasks.push_back(after(5ms, 0));
+    tasks.push_back(fail_after(1ms, 1));
+    try {
+      co_await cocos::when_any(std::move(tasks));
+    } catch (const std::runtime_error &e) {
+      co_return std::stoi(e.what());
+    }
+    co_return -1;
+  }()};
+  COCOS_CHECK(run(race) == 1);
+
+  try {
+    cocos::when_any(std::vector<cocos::Task<int>>{});
+    COCOS_CHECK(false);
+  } catch (const std::invalid_argument &) {
+  }
+}
+} // namespace
+
+int main() {
+  when_all_order();
+  when_all_exception();
+  when_any_first();
+  when_any_errors();
+}
@@ -0,0 +1,78 @@
+#include "../include/work_stealing_deque.hpp"
+#include "check.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr std::int64_t items{200'000};
+constexpr std::size_t thieves{3};
+
+/**
+ * @brief The owner pushes every item, popping some back as it goes and the
+ * rest at the end, while thieves steal concurrently. Each item must be taken
+ * exactly once.
+ */
+void owner_pop_vs_steal() {
+  // A small initial capacity, so that the deque grows under the thieves.
+  cocos::WorkStealingDeque<std::int64_t> deque{4};
+  std::vector<std::atomic<int>> taken(items);
+  std::atomic<bool> done{false};
+  std::vector<std::thread> threads;
+  for (std::size_t i{0}; i < thieves; ++i) {
+    threads.emplace_back([&] {
+      while (true) {
+        if (auto item{deque.steal()}) {
+          taken[*item].fetch_add(1, std::memory_order_relaxed);
+        } else if (done.load(std::memory_order_acquire)) {
+          return;
+        }
+      }
+    });
+  }
+  for (std::int64_t i{0}; i < items; ++i) {
+    deque.push(i);
+    if (i % 3 == 0) {
+      if (auto item{deque.pop()}) {
+        taken[*item].fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+  while (deque.size() != 0) {
+    if (auto item{deque.pop()}) {
+      taken[*item].fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  done.store(true, std::memory_order_release);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto &count : taken) {
+    COCOS_CHECK(count.load(std::memory_order_relaxed) == 1);
+  }
+}
+
+/**
+ * @brief Without thieves, the owner takes the items back in LIFO order.
+ */
+void owner_lifo() {
+  cocos::WorkStealingDeque<int> deque{2};
+  for (int i{0}; i < 100; ++i) {
+    deque.push(i);
+  }
+  for (int i{99}; i >= 0; --i) {
+    auto item{deque.pop()};
+    COCOS_CHECK(item && *item == i);
+  }
+  COCOS_CHECK(!deque.pop() && !deque.steal());
+}
+} // namespace
+
+int main() {
+  owner_lifo();
+  for (int round{0}; round < 10; ++round) {
+    owner_pop_vs_steal();
+  }
+}